@@ -0,0 +1,215 @@
+/**
+*	File: "bench.c"
+*	Author: Francesco Cavina
+*
+*/
+
+/* includes ----------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "fifo.h"
+
+
+/* defines ------------------------------------------------------------------ */
+#define FIFO_NAME	"bench_fifo"
+#define BENCH_BYTES	(256 * 1024 * 1024)
+#define BENCH_MESSAGES	2000000
+
+
+/* private typedefs --------------------------------------------------------- */
+typedef struct
+{
+	const char *transport;
+	uint32_t size;
+	uint64_t messages;
+	double seconds;
+} benchResult_t;
+
+
+/* private function prototypes ---------------------------------------------- */
+static void benchWriter(bool sharedMemory, uint32_t size, uint64_t messages);
+static uint64_t benchReader(bool sharedMemory);
+static double benchNow(void);
+
+
+/* private data definition -------------------------------------------------- */
+static const uint32_t sizes[] = { 16, 64, 256, 1024 };
+static fifoWriter_t fifoWriter;
+static fifoReader_t fifoReader;
+
+
+/* public function definitions ---------------------------------------------- */
+int main(void)
+{
+	benchResult_t results[2 * sizeof(sizes) / sizeof(sizes[0])];
+	uint32_t count = 0, i, transport;
+	uint64_t messages;
+	double start;
+	pid_t pid;
+	
+	/* same messages through both transports: DATA lines of every size */
+	for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		messages = BENCH_BYTES / sizes[i];
+		if(messages > BENCH_MESSAGES)
+		{
+			messages = BENCH_MESSAGES;
+		}
+	
+		for(transport = 0; transport < 2; transport++)
+		{
+			if(transport == 0)
+			{
+				createNamedFifo(FIFO_NAME);
+			}
+	
+			/* writer in a child process, reader here */
+			if((pid = fork()) == -1)
+			{
+				perror("fork");
+				exit(EXIT_FAILURE);
+			}
+			else if(pid == 0)
+			{
+				benchWriter(transport == 1, sizes[i], messages);
+				_exit(EXIT_SUCCESS);
+			}
+	
+			start = benchNow();
+			results[count].messages = benchReader(transport == 1);
+			results[count].seconds = benchNow() - start;
+			results[count].transport = (transport == 0) ? "named fifo" : "shared ring";
+			results[count].size = sizes[i];
+	
+			waitpid(pid, NULL, 0);
+	
+			if(results[count].messages != messages)
+			{
+				printf("Bench: %s lost messages, %llu of %llu received.\n", results[count].transport,
+				       (unsigned long long) results[count].messages, (unsigned long long) messages);
+			}
+	
+			count++;
+		}
+	}
+	
+	unlink(FIFO_NAME);
+	
+	printf("\n%-12s %8s %10s %10s %12s %10s %8s\n", "transport", "size", "messages", "seconds", "messages/s", "MB/s", "speedup");
+	
+	for(i = 0; i < count; i++)
+	{
+		printf("%-12s %8u %10llu %10.3f %12.0f %10.1f %7.2fx\n", results[i].transport, results[i].size,
+		       (unsigned long long) results[i].messages, results[i].seconds,
+		       results[i].messages / results[i].seconds,
+		       results[i].messages * (results[i].size + 1) / results[i].seconds / 1e6,
+		       results[i - (i % 2)].seconds / results[i].seconds);
+	}
+	
+	return 0;
+}
+
+
+/* private function definitions --------------------------------------------- */
+void benchWriter(bool sharedMemory, uint32_t size, uint64_t messages)
+{
+	char *message;
+	uint64_t i;
+	
+	if(sharedMemory)
+	{
+		fifoWriterInitRing(&fifoWriter, openSharedRing(FIFO_NAME, O_WRONLY));
+	}
+	else
+	{
+		fifoWriterInit(&fifoWriter, openNamedFifo(FIFO_NAME, O_WRONLY));
+	}
+	
+	/* "DATA:" then size bytes of payload, the same buffer queued over and over */
+	if((message = malloc(size + 5)) == NULL)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	
+	memcpy(message, "DATA:", 5);
+	memset(message + 5, 'x', size);
+	
+	for(i = 0; i < messages; i++)
+	{
+		if(fifoWriterPut(&fifoWriter, message, size + 5) == -1)
+		{
+			perror("writer");
+			exit(EXIT_FAILURE);
+		}
+	}
+	
+	if(fifoWriterFlush(&fifoWriter) == -1)
+	{
+		perror("writer");
+		exit(EXIT_FAILURE);
+	}
+	
+	fifoWriterClose(&fifoWriter);
+	free(message);
+}
+
+uint64_t benchReader(bool sharedMemory)
+{
+	fifoRun_t run;
+	uint64_t messages = 0;
+	int32_t bytesRead;
+	char *line, *end;
+	
+	if(sharedMemory)
+	{
+		fifoReaderInitRing(&fifoReader, openSharedRing(FIFO_NAME, O_RDONLY));
+	}
+	else
+	{
+		fifoReaderInit(&fifoReader, openNamedFifo(FIFO_NAME, O_RDONLY));
+	}
+	
+	/* count every message, as the reader would have to find them */
+	do
+	{
+		if((bytesRead = fifoReaderFill(&fifoReader)) == -1)
+		{
+			perror("reader");
+			exit(EXIT_FAILURE);
+		}
+	
+		while(fifoReaderNext(&fifoReader, &run))
+		{
+			for(line = run.body; (end = memchr(line, FIFO_DELIMITER, run.body + run.length - line)) != NULL; line = end + 1)
+			{
+				messages++;
+			}
+		}
+	}
+	while(bytesRead > 0);
+	
+	fifoReaderClose(&fifoReader);
+	
+	return messages;
+}
+
+double benchNow(void)
+{
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
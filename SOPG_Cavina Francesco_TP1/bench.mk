@@ -0,0 +1,10 @@
+CC = gcc
+
+bench: bench.o fifo.o
+	gcc -o bench bench.o fifo.o -lrt
+
+bench.o: bench.c fifo.h
+	gcc -Wall -O2 -c bench.c
+
+fifo.o: fifo.c fifo.h
+	gcc -Wall -c fifo.c
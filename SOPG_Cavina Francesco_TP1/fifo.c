@@ -5,6 +5,7 @@
 */
 
 /* includes ----------------------------------------------------------------- */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
@@ -12,16 +13,78 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <ctype.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <poll.h>
 
 #include "fifo.h"
 
 
 /* defines ------------------------------------------------------------------ */
+#define FIFO_RING_MAGIC		0x52494E47
+#define FIFO_RING_MASK		(FIFO_RING_SIZE - 1)
 
+/* Sleeps are cut in slices this long, to notice peers that died without saying so */
+#define FIFO_RING_POLL_MS	100
 
-/* public function prototypes ----------------------------------------------- */
+/* Writers' lock word: the owner's pid, this bit set once somebody waits for it */
+#define FIFO_RING_LOCK_WAITED	0x80000000u
+
+
+/* private typedefs --------------------------------------------------------- */
+/*
+*	Byte stream in POSIX shared memory, carrying exactly what the named fifo
+*	would. Positions only grow (modulo 2^32) and index data through the mask.
+*	Writers copy a batch under a futex lock, which keeps batches whole like a
+*	PIPE_BUF write does, then publish it by moving tail. The lock holds its
+*	owner's pid, so a writer that died holding it is taken over: what it
+*	copied without moving tail is simply written over. The reader copies out
+*	and moves head. Nobody makes a syscall unless the ring is empty or full:
+*	then the side that has to wait raises its flag and sleeps on the futex of
+*	the position the other side moves, and that side wakes it.
+*/
+struct fifoRing
+{
+	uint32_t magic;				// Set by the reader once the ring is ready
+	char name[NAME_MAX];			// Unlinked by the reader when done
+	_Atomic int32_t readerPid;
+	_Atomic uint32_t writers;		// Writers attached, 0 after the last one left: end of stream
+	_Atomic int32_t writerPids[FIFO_RING_WRITERS];
+	_Atomic uint32_t lock;			// Writers' lock: 0 free, else the owner's pid (| FIFO_RING_LOCK_WAITED)
+	_Alignas(64) _Atomic uint32_t tail;	// Moved by writers
+	_Atomic uint32_t readerWaiting;
+	_Alignas(64) _Atomic uint32_t head;	// Moved by the reader
+	_Atomic uint32_t writerWaiting;
+	_Alignas(64) char data[FIFO_RING_SIZE];
+};
+
+
+/* private data definition -------------------------------------------------- */
+static const char delimiter = FIFO_DELIMITER;
+static uint32_t ringOwner;		// This writer's mark on the ring lock (its pid)
+
+
+/* private function prototypes ---------------------------------------------- */
+static void fifoWriterCloseRun(fifoWriter_t *writer);
+static bool fifoValidType(const char *type);
+static bool fifoParseHeader(const char *header, fifoRun_t *run);
+static int32_t fifoRingWrite(fifoRing_t *ring, const struct iovec *iov, uint32_t iovCount, uint32_t bytes);
+static int32_t fifoRingRead(fifoRing_t *ring, char *buffer, uint32_t size);
+static int32_t fifoRingWait(fifoRing_t *ring, int32_t timeoutMs);
+static void fifoRingLock(fifoRing_t *ring);
+static void fifoRingUnlock(fifoRing_t *ring);
+static void fifoRingReap(fifoRing_t *ring);
+static bool fifoProcessAlive(int32_t pid);
+static int32_t fifoFutexWait(_Atomic uint32_t *word, uint32_t value, int32_t timeoutMs);
+static void fifoFutexWake(_Atomic uint32_t *word);
 
 
 /* public function definitions ---------------------------------------------- */
@@ -69,3 +132,807 @@ int32_t openNamedFifo(const char *fifoName, int8_t openFlag)
 	
 	return fd;
 }
+
+int32_t openWriterFifo(const char *directory)
+{
+	char path[PATH_MAX];
+	
+	/* Register as a writer of a reader serving many: a FIFO of our own, named after our pid */
+	if((mkdir(directory, 0777) < 0) && (errno != EEXIST))
+	{
+		printf("Error creating fifo directory: %s\n", strerror(errno));
+		exit(1);
+	}
+	
+	snprintf(path, sizeof(path), "%s/%d", directory, getpid());
+	createNamedFifo(path);
+	
+	return openNamedFifo(path, O_WRONLY);
+}
+
+fifoRing_t* openSharedRing(const char *ringName, int8_t openFlag)
+{
+	char name[NAME_MAX];
+	fifoRing_t *ring;
+	struct stat status;
+	int32_t fd, pid, i;
+	uint32_t writers;
+	
+	snprintf(name, sizeof(name), "/%s", ringName);
+	
+	if(openFlag == O_RDONLY)
+	{
+		/* Reader: a fresh ring every time, writers of an old one are not ours */
+		shm_unlink(name);
+		
+		if(((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0666)) < 0) || (ftruncate(fd, sizeof(fifoRing_t)) < 0))
+		{
+			printf("Error creating shared ring: %s\n", strerror(errno));
+			exit(1);
+		}
+		
+		if((ring = mmap(NULL, sizeof(fifoRing_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+		{
+			printf("Error mapping shared ring: %s\n", strerror(errno));
+			exit(1);
+		}
+		close(fd);
+		
+		/* ftruncate() zeroed it, the magic tells writers it is ready */
+		memcpy(ring->name, name, sizeof(name));
+		atomic_store(&ring->readerPid, getpid());
+		__atomic_store_n(&ring->magic, FIFO_RING_MAGIC, __ATOMIC_RELEASE);
+		
+		/* Blocks until a writer attaches, like opening the named fifo */
+		printf("Waiting for writers...\n");
+		
+		while((writers = atomic_load(&ring->writers)) == 0)
+		{
+			fifoFutexWait(&ring->writers, 0, FIFO_RING_POLL_MS);
+		}
+		
+		printf("Reader connected.\n\n");
+		
+		return ring;
+	}
+	
+	/* Writer: wait for a reader to set up the ring */
+	printf("Waiting for readers...\n");
+	
+	while(1)
+	{
+		if((fd = shm_open(name, O_RDWR, 0)) >= 0)
+		{
+			if((fstat(fd, &status) == 0) && (status.st_size == sizeof(fifoRing_t)) &&
+			   ((ring = mmap(NULL, sizeof(fifoRing_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) != MAP_FAILED))
+			{
+				close(fd);
+				
+				/* a ring left behind by a reader that is gone does not count */
+				if((__atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) == FIFO_RING_MAGIC) && fifoProcessAlive(atomic_load(&ring->readerPid)))
+				{
+					break;
+				}
+				
+				munmap(ring, sizeof(fifoRing_t));
+			}
+			else
+			{
+				close(fd);
+			}
+		}
+		
+		usleep(FIFO_RING_POLL_MS * 1000);
+	}
+	
+	/* Attach: the reader sees the end of stream once every writer has left or died */
+	for(i = 0, pid = 0; i < FIFO_RING_WRITERS; i++)
+	{
+		if(atomic_compare_exchange_strong(&ring->writerPids[i], &pid, getpid()))
+		{
+			break;
+		}
+		pid = 0;
+	}
+	
+	if(i == FIFO_RING_WRITERS)
+	{
+		printf("Error attaching to shared ring: too many writers\n");
+		exit(1);
+	}
+	
+	atomic_fetch_add(&ring->writers, 1);
+	fifoFutexWake(&ring->writers);
+	ringOwner = (uint32_t) getpid();
+	
+	printf("Writer connected.\n\n");
+	
+	return ring;
+}
+
+void fifoWriterInit(fifoWriter_t *writer, int32_t fd)
+{
+	writer->fd = fd;
+	writer->ring = NULL;
+	writer->iovCount = 0;
+	writer->runs = 0;
+	writer->runLength = 0;
+	writer->messages = 0;
+	writer->bytes = 0;
+}
+
+void fifoWriterInitRing(fifoWriter_t *writer, fifoRing_t *ring)
+{
+	fifoWriterInit(writer, -1);
+	writer->ring = ring;
+}
+
+int32_t fifoWriterPut(fifoWriter_t *writer, const char *message, uint32_t length)
+{
+	const char *payload = message + FIFO_TYPE_SIZE + 1;
+	uint32_t payloadLength, needed;
+	bool newRun;
+	
+	/* the message must start with its type, "TYPE:" */
+	if((length <= FIFO_TYPE_SIZE) || !fifoValidType(message) || (message[FIFO_TYPE_SIZE] != ':') || (memchr(message, FIFO_DELIMITER, length) != NULL))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	
+	/* the message and a run header must fit in one atomic write */
+	if(length > FIFO_MESSAGE_SIZE)
+	{
+		errno = EMSGSIZE;
+		return -1;
+	}
+	
+	payloadLength = length - FIFO_TYPE_SIZE - 1;
+	newRun = (writer->runs == 0) || (memcmp(writer->headers[writer->runs - 1], message, FIFO_TYPE_SIZE) != 0);
+	needed = payloadLength + 1 + (newRun ? FIFO_HEADER_SIZE : 0);
+	
+	/* send what is queued if this message does not fit in the batch */
+	if((writer->bytes + needed > FIFO_BATCH_SIZE) || (writer->iovCount + 3 > FIFO_BATCH_IOVECS) || (newRun && (writer->runs == FIFO_BATCH_RUNS)))
+	{
+		if(fifoWriterFlush(writer) < 0)
+		{
+			return -1;
+		}
+		
+		newRun = true;
+		needed = payloadLength + 1 + FIFO_HEADER_SIZE;
+	}
+	
+	/* a different type ends the run, its header gets the final length */
+	if(newRun)
+	{
+		fifoWriterCloseRun(writer);
+		
+		memcpy(writer->headers[writer->runs], message, FIFO_TYPE_SIZE);
+		writer->iov[writer->iovCount].iov_base = writer->headers[writer->runs];
+		writer->iov[writer->iovCount].iov_len = FIFO_HEADER_SIZE;
+		writer->iovCount++;
+		writer->runs++;
+		writer->runLength = 0;
+	}
+	
+	/* the message is not copied, it must stay untouched until the batch is flushed */
+	writer->iov[writer->iovCount].iov_base = (void *) payload;
+	writer->iov[writer->iovCount].iov_len = payloadLength;
+	writer->iov[writer->iovCount + 1].iov_base = (void *) &delimiter;
+	writer->iov[writer->iovCount + 1].iov_len = 1;
+	
+	writer->iovCount += 2;
+	writer->runLength += payloadLength + 1;
+	writer->messages++;
+	writer->bytes += needed;
+	
+	return 0;
+}
+
+int32_t fifoWriterFlush(fifoWriter_t *writer)
+{
+	ssize_t bytesWritten;
+	
+	if(writer->iovCount == 0)
+	{
+		return 0;
+	}
+	
+	fifoWriterCloseRun(writer);
+	
+	/* the batch is at most PIPE_BUF bytes: the pipe takes all of it or nothing */
+	if(writer->ring != NULL)
+	{
+		bytesWritten = fifoRingWrite(writer->ring, writer->iov, writer->iovCount, writer->bytes);
+	}
+	else
+	{
+		do
+		{
+			bytesWritten = writev(writer->fd, writer->iov, writer->iovCount);
+		}
+		while((bytesWritten == -1) && (errno == EINTR));
+	}
+	
+	if(bytesWritten == -1)
+	{
+		return -1;
+	}
+	
+	writer->iovCount = 0;
+	writer->runs = 0;
+	writer->runLength = 0;
+	writer->messages = 0;
+	writer->bytes = 0;
+	
+	return (int32_t) bytesWritten;
+}
+
+void fifoWriterClose(fifoWriter_t *writer)
+{
+	int32_t pid = getpid();
+	uint32_t i;
+	
+	if(writer->ring == NULL)
+	{
+		close(writer->fd);
+		return;
+	}
+	
+	/* detach, the reader gets the end of stream after the last writer */
+	for(i = 0; i < FIFO_RING_WRITERS; i++)
+	{
+		if(atomic_compare_exchange_strong(&writer->ring->writerPids[i], &pid, 0))
+		{
+			atomic_fetch_sub(&writer->ring->writers, 1);
+			fifoFutexWake(&writer->ring->tail);
+			break;
+		}
+		pid = getpid();
+	}
+	
+	munmap(writer->ring, sizeof(fifoRing_t));
+	writer->ring = NULL;
+}
+
+void fifoReaderInit(fifoReader_t *reader, int32_t fd)
+{
+	reader->fd = fd;
+	reader->ring = NULL;
+	reader->start = 0;
+	reader->length = 0;
+	reader->discarded = 0;
+}
+
+void fifoReaderInitRing(fifoReader_t *reader, fifoRing_t *ring)
+{
+	fifoReaderInit(reader, -1);
+	reader->ring = ring;
+}
+
+void fifoReaderClose(fifoReader_t *reader)
+{
+	if(reader->ring == NULL)
+	{
+		close(reader->fd);
+		return;
+	}
+	
+	/* writers still attached keep their mapping, new ones can't find it anymore */
+	shm_unlink(reader->ring->name);
+	munmap(reader->ring, sizeof(fifoRing_t));
+	reader->ring = NULL;
+}
+
+int32_t fifoReaderWait(fifoReader_t *reader, int32_t timeoutMs)
+{
+	struct pollfd pollFd = { .fd = reader->fd, .events = POLLIN };
+	int32_t returnCode;
+	
+	/* 1: something to read (or end of stream), 0: timed out */
+	if(reader->ring != NULL)
+	{
+		return fifoRingWait(reader->ring, timeoutMs);
+	}
+	
+	if((returnCode = poll(&pollFd, 1, timeoutMs)) == -1)
+	{
+		return (errno == EINTR) ? 0 : -1;
+	}
+	
+	return returnCode;
+}
+
+int32_t fifoReaderFill(fifoReader_t *reader)
+{
+	int32_t bytesRead;
+	
+	/* runs handed out so far are done with: keep only the unfinished one, at the front */
+	if(reader->start > 0)
+	{
+		memmove(reader->buffer, reader->buffer + reader->start, reader->length - reader->start);
+		reader->length -= reader->start;
+		reader->start = 0;
+	}
+	
+	/* read everything available, as many runs as fit. A run is never longer than a batch */
+	if(reader->ring != NULL)
+	{
+		bytesRead = fifoRingRead(reader->ring, reader->buffer + reader->length, FIFO_READ_SIZE - reader->length);
+	}
+	else if((bytesRead = read(reader->fd, reader->buffer + reader->length, FIFO_READ_SIZE - reader->length)) == -1)
+	{
+		return -1;
+	}
+	
+	reader->length += bytesRead;
+	
+	return bytesRead;
+}
+
+bool fifoReaderNext(fifoReader_t *reader, fifoRun_t *run)
+{
+	char *end;
+	
+	while(reader->length - reader->start >= FIFO_HEADER_SIZE)
+	{
+		/* not a header: skip up to the next delimiter and try again there */
+		if(!fifoParseHeader(reader->buffer + reader->start, run))
+		{
+			reader->discarded++;
+			
+			if((end = memchr(reader->buffer + reader->start, FIFO_DELIMITER, reader->length - reader->start)) == NULL)
+			{
+				reader->start = reader->length;
+				return false;
+			}
+			
+			reader->start = end - reader->buffer + 1;
+			continue;
+		}
+		
+		/* the rest of the run comes with the next read */
+		if(reader->length - reader->start < FIFO_HEADER_SIZE + run->length)
+		{
+			return false;
+		}
+		
+		/* hand out the body in place */
+		run->body = reader->buffer + reader->start + FIFO_HEADER_SIZE;
+		reader->start += FIFO_HEADER_SIZE + run->length;
+		
+		return true;
+	}
+	
+	return false;
+}
+
+int32_t fifoReaderHeader(fifoReader_t *reader, fifoRun_t *run)
+{
+	char header[FIFO_HEADER_SIZE];
+	char *end;
+	uint32_t count = 0;
+	int32_t bytesRead;
+	
+	/* read just the header, the body stays in the named fifo */
+	while(1)
+	{
+		if((bytesRead = read(reader->fd, header + count, FIFO_HEADER_SIZE - count)) == -1)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			
+			return -1;
+		}
+		else if(bytesRead == 0)
+		{
+			return 0;
+		}
+		
+		if((count += bytesRead) < FIFO_HEADER_SIZE)
+		{
+			continue;
+		}
+		
+		if(fifoParseHeader(header, run))
+		{
+			return 1;
+		}
+		
+		/* not a header: keep what follows its first delimiter and try again there */
+		reader->discarded++;
+		
+		if((end = memchr(header, FIFO_DELIMITER, FIFO_HEADER_SIZE)) == NULL)
+		{
+			count = 0;
+		}
+		else
+		{
+			count = header + FIFO_HEADER_SIZE - (end + 1);
+			memmove(header, end + 1, count);
+		}
+	}
+}
+
+int32_t fifoReaderBody(fifoReader_t *reader, fifoRun_t *run)
+{
+	uint32_t count = 0;
+	int32_t bytesRead;
+	
+	/* read a body announced by fifoReaderHeader(), it was written along with it */
+	while(count < run->length)
+	{
+		if((bytesRead = read(reader->fd, reader->buffer + count, run->length - count)) == -1)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			
+			return -1;
+		}
+		else if(bytesRead == 0)
+		{
+			break;
+		}
+		
+		count += bytesRead;
+	}
+	
+	run->body = reader->buffer;
+	run->length = count;
+	
+	return count;
+}
+
+int32_t fifoReaderSplice(fifoReader_t *reader, int32_t fd, uint32_t length)
+{
+	uint32_t count = 0;
+	ssize_t bytesMoved;
+	
+	/* move a body announced by fifoReaderHeader() to fd, the pipe pages are handed over without a copy */
+	while(count < length)
+	{
+		if((bytesMoved = splice(reader->fd, NULL, fd, NULL, length - count, SPLICE_F_MOVE | SPLICE_F_MORE)) == -1)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			
+			return -1;
+		}
+		else if(bytesMoved == 0)
+		{
+			break;
+		}
+		
+		count += bytesMoved;
+	}
+	
+	return count;
+}
+
+
+/* private function definitions --------------------------------------------- */
+void fifoWriterCloseRun(fifoWriter_t *writer)
+{
+	char length[5];
+	
+	/* the header was left without a length while the run was growing */
+	if(writer->runs > 0)
+	{
+		snprintf(length, sizeof(length), "%04x", writer->runLength);
+		memcpy(writer->headers[writer->runs - 1] + FIFO_TYPE_SIZE, length, 4);
+		writer->headers[writer->runs - 1][FIFO_HEADER_SIZE - 1] = FIFO_DELIMITER;
+	}
+}
+
+bool fifoValidType(const char *type)
+{
+	uint32_t i;
+	
+	/* types are upper case letters only */
+	for(i = 0; i < FIFO_TYPE_SIZE; i++)
+	{
+		if((type[i] < 'A') || (type[i] > 'Z'))
+		{
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+bool fifoParseHeader(const char *header, fifoRun_t *run)
+{
+	char length[5];
+	uint32_t i;
+	
+	/* type, then 4 hex digits and the delimiter */
+	if(!fifoValidType(header) || (header[FIFO_HEADER_SIZE - 1] != FIFO_DELIMITER))
+	{
+		return false;
+	}
+	
+	for(i = 0; i < 4; i++)
+	{
+		if(!isxdigit((unsigned char) header[FIFO_TYPE_SIZE + i]))
+		{
+			return false;
+		}
+	}
+	
+	memcpy(length, header + FIFO_TYPE_SIZE, 4);
+	length[4] = '\0';
+	run->length = strtoul(length, NULL, 16);
+	
+	if(run->length > FIFO_BATCH_SIZE - FIFO_HEADER_SIZE)
+	{
+		return false;
+	}
+	
+	memcpy(run->type, header, FIFO_TYPE_SIZE);
+	run->type[FIFO_TYPE_SIZE] = '\0';
+	
+	return true;
+}
+
+int32_t fifoRingWrite(fifoRing_t *ring, const struct iovec *iov, uint32_t iovCount, uint32_t bytes)
+{
+	uint32_t tail, head, offset, chunk, i;
+	const char *data;
+	size_t length;
+	
+	fifoRingLock(ring);
+	
+	/* only writers move tail, and they hold the lock */
+	tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	
+	/* full: sleep until the reader moves head. A reader that is gone never will */
+	while(FIFO_RING_SIZE - (tail - (head = atomic_load(&ring->head))) < bytes)
+	{
+		atomic_store(&ring->writerWaiting, 1);
+		
+		if(atomic_load(&ring->head) != head)
+		{
+			continue;
+		}
+		
+		if((fifoFutexWait(&ring->head, head, FIFO_RING_POLL_MS) == -1) && (errno == ETIMEDOUT) && !fifoProcessAlive(atomic_load(&ring->readerPid)))
+		{
+			fifoRingUnlock(ring);
+			errno = EPIPE;
+			return -1;
+		}
+	}
+	
+	/* copy the whole batch, wrapping around the end of the ring */
+	for(i = 0, offset = tail; i < iovCount; i++)
+	{
+		data = iov[i].iov_base;
+		length = iov[i].iov_len;
+		
+		while(length > 0)
+		{
+			chunk = FIFO_RING_SIZE - (offset & FIFO_RING_MASK);
+			if(chunk > length)
+			{
+				chunk = length;
+			}
+			
+			memcpy(ring->data + (offset & FIFO_RING_MASK), data, chunk);
+			offset += chunk;
+			data += chunk;
+			length -= chunk;
+		}
+	}
+	
+	/* publish it, then wake the reader if it went to sleep on an empty ring */
+	atomic_store(&ring->tail, tail + bytes);
+	fifoRingUnlock(ring);
+	
+	if(atomic_exchange(&ring->readerWaiting, 0))
+	{
+		fifoFutexWake(&ring->tail);
+	}
+	
+	return bytes;
+}
+
+int32_t fifoRingRead(fifoRing_t *ring, char *buffer, uint32_t size)
+{
+	uint32_t head, available, chunk;
+	
+	/* blocks until there is data or every writer is gone */
+	fifoRingWait(ring, -1);
+	
+	head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	
+	if((available = atomic_load(&ring->tail) - head) == 0)
+	{
+		return 0;
+	}
+	
+	if(available > size)
+	{
+		available = size;
+	}
+	
+	/* copy out, wrapping around the end of the ring */
+	chunk = FIFO_RING_SIZE - (head & FIFO_RING_MASK);
+	if(chunk > available)
+	{
+		chunk = available;
+	}
+	
+	memcpy(buffer, ring->data + (head & FIFO_RING_MASK), chunk);
+	memcpy(buffer + chunk, ring->data, available - chunk);
+	
+	/* hand the space back, then wake writers that found the ring full */
+	atomic_store(&ring->head, head + available);
+	
+	if(atomic_exchange(&ring->writerWaiting, 0))
+	{
+		fifoFutexWake(&ring->head);
+	}
+	
+	return available;
+}
+
+int32_t fifoRingWait(fifoRing_t *ring, int32_t timeoutMs)
+{
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	uint32_t tail;
+	int32_t slice;
+	
+	while(1)
+	{
+		/* data, or nobody left to send any */
+		if(((tail = atomic_load(&ring->tail)) != head) || (atomic_load(&ring->writers) == 0))
+		{
+			return 1;
+		}
+		
+		/* raise the flag before looking again, so a writer publishing now sees it */
+		atomic_store(&ring->readerWaiting, 1);
+		
+		if(((tail = atomic_load(&ring->tail)) != head) || (atomic_load(&ring->writers) == 0))
+		{
+			return 1;
+		}
+		
+		if(timeoutMs == 0)
+		{
+			return 0;
+		}
+		
+		slice = ((timeoutMs > 0) && (timeoutMs < FIFO_RING_POLL_MS)) ? timeoutMs : FIFO_RING_POLL_MS;
+		
+		/* a whole slice without news: maybe a writer died without detaching */
+		if((fifoFutexWait(&ring->tail, tail, slice) == -1) && (errno == ETIMEDOUT))
+		{
+			fifoRingReap(ring);
+			
+			if(timeoutMs > 0)
+			{
+				timeoutMs -= slice;
+				
+				if(timeoutMs == 0)
+				{
+					return 0;
+				}
+			}
+		}
+	}
+}
+
+void fifoRingLock(fifoRing_t *ring)
+{
+	uint32_t state = 0;
+	
+	/* uncontended: one compare and swap, no syscall */
+	if(atomic_compare_exchange_strong(&ring->lock, &state, ringOwner))
+	{
+		return;
+	}
+	
+	while(1)
+	{
+		/* free: take it, still marked waited for since others may be sleeping on it */
+		if(state == 0)
+		{
+			if(atomic_compare_exchange_strong(&ring->lock, &state, ringOwner | FIFO_RING_LOCK_WAITED))
+			{
+				return;
+			}
+			continue;
+		}
+		
+		/* mark it waited for, so the owner wakes us when it lets go */
+		if(!(state & FIFO_RING_LOCK_WAITED))
+		{
+			if(!atomic_compare_exchange_strong(&ring->lock, &state, state | FIFO_RING_LOCK_WAITED))
+			{
+				continue;
+			}
+			state |= FIFO_RING_LOCK_WAITED;
+		}
+		
+		/* a whole slice without it: an owner that died holding it never lets go, take it over */
+		if((fifoFutexWait(&ring->lock, state, FIFO_RING_POLL_MS) == -1) && (errno == ETIMEDOUT) &&
+		   !fifoProcessAlive((int32_t) (state & ~FIFO_RING_LOCK_WAITED)) &&
+		   atomic_compare_exchange_strong(&ring->lock, &state, ringOwner | FIFO_RING_LOCK_WAITED))
+		{
+			return;
+		}
+		
+		state = atomic_load(&ring->lock);
+	}
+}
+
+void fifoRingUnlock(fifoRing_t *ring)
+{
+	/* somebody waits for the lock: wake it */
+	if(atomic_exchange(&ring->lock, 0) & FIFO_RING_LOCK_WAITED)
+	{
+		fifoFutexWake(&ring->lock);
+	}
+}
+
+void fifoRingReap(fifoRing_t *ring)
+{
+	int32_t pid;
+	uint32_t i;
+	
+	/* writers that exited without detaching */
+	for(i = 0; i < FIFO_RING_WRITERS; i++)
+	{
+		if(((pid = atomic_load(&ring->writerPids[i])) != 0) && !fifoProcessAlive(pid) &&
+		   atomic_compare_exchange_strong(&ring->writerPids[i], &pid, 0))
+		{
+			atomic_fetch_sub(&ring->writers, 1);
+		}
+	}
+}
+
+bool fifoProcessAlive(int32_t pid)
+{
+	char path[32], state = 0;
+	FILE *stat;
+	
+	if((kill(pid, 0) == -1) && (errno == ESRCH))
+	{
+		return false;
+	}
+	
+	/* a process that exited but was not waited for yet still answers kill() */
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	
+	if((stat = fopen(path, "r")) != NULL)
+	{
+		if(fscanf(stat, "%*d (%*[^)]) %c", &state) != 1)
+		{
+			state = 0;
+		}
+		fclose(stat);
+	}
+	
+	return (state != 'Z') && (state != 'X');
+}
+
+int32_t fifoFutexWait(_Atomic uint32_t *word, uint32_t value, int32_t timeoutMs)
+{
+	struct timespec timeout = { timeoutMs / 1000, (timeoutMs % 1000) * 1000000 };
+	
+	/* shared futex: the word lives in memory mapped by several processes */
+	return syscall(SYS_futex, word, FUTEX_WAIT, value, (timeoutMs < 0) ? NULL : &timeout, NULL, 0);
+}
+
+void fifoFutexWake(_Atomic uint32_t *word)
+{
+	syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
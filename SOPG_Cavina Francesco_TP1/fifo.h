@@ -4,10 +4,103 @@
 *
 */
 
+#ifndef FIFO_H
+#define FIFO_H
+
 /* includes ----------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <sys/uio.h>
 
 /* defines ------------------------------------------------------------------ */
+/* Every message on the named fifo ends with this byte, it never appears inside one */
+#define FIFO_DELIMITER		'\n'
+
+/*
+*	Consecutive messages of the same type travel as a run: a fixed size header
+*	("DATA", "SIGN", ... then the body length in 4 hex digits and a delimiter)
+*	followed by the messages without their "TYPE:" prefix, each one delimited.
+*	A reader knows where a run ends from its header alone, so a body can be
+*	moved to a file without looking at it.
+*/
+#define FIFO_TYPE_SIZE		4
+#define FIFO_HEADER_SIZE	(FIFO_TYPE_SIZE + 4 + 1)
+
+/* Writes of up to PIPE_BUF bytes are atomic, so a batch never gets split or interleaved */
+#define FIFO_BATCH_SIZE		PIPE_BUF
+#define FIFO_BATCH_IOVECS	1024
+#define FIFO_BATCH_RUNS		(FIFO_BATCH_SIZE / (FIFO_HEADER_SIZE + 1))
+
+/* Longest message, "TYPE:" prefix included, that fits in one batch */
+#define FIFO_MESSAGE_SIZE	(FIFO_BATCH_SIZE - FIFO_HEADER_SIZE + FIFO_TYPE_SIZE)
+
+/* One read drains up to a whole pipe (default pipe capacity) */
+#define FIFO_READ_SIZE		65536
+
+/* Shared memory ring that can carry the same stream instead of the named fifo */
+#define FIFO_RING_SIZE		(1 << 20)
+#define FIFO_RING_WRITERS	16
+
+/* public typedefs ---------------------------------------------------------- */
+/* Shared memory ring, laid out in fifo.c */
+typedef struct fifoRing fifoRing_t;
+
+/* Messages queued by the writer, sent with a single writev() or ring copy */
+typedef struct
+{
+	int32_t fd;
+	fifoRing_t *ring;	// NULL: named fifo
+	struct iovec iov[FIFO_BATCH_IOVECS];
+	uint32_t iovCount;
+	char headers[FIFO_BATCH_RUNS][FIFO_HEADER_SIZE + 1];
+	uint32_t runs;
+	uint32_t runLength;	// Body bytes of the last run
+	uint32_t messages;
+	uint32_t bytes;
+} fifoWriter_t;
+
+/* Bytes read from a named fifo or ring, split into runs in place */
+typedef struct
+{
+	int32_t fd;
+	fifoRing_t *ring;	// NULL: named fifo
+	char buffer[FIFO_READ_SIZE];
+	uint32_t start;		// First byte not handed out yet
+	uint32_t length;	// Bytes in buffer
+	uint32_t discarded;	// Malformed runs skipped
+} fifoReader_t;
+
+/* Run handed out by the reader. The body is the delimited messages, without "TYPE:" */
+typedef struct
+{
+	char type[FIFO_TYPE_SIZE + 1];
+	char *body;
+	uint32_t length;
+} fifoRun_t;
 
 /* public function prototypes ----------------------------------------------- */
 void createNamedFifo(const char *fifoName);
 int32_t openNamedFifo(const char *fifoName, int8_t openFlag);
+int32_t openWriterFifo(const char *directory);
+fifoRing_t* openSharedRing(const char *ringName, int8_t openFlag);
+
+void fifoWriterInit(fifoWriter_t *writer, int32_t fd);
+void fifoWriterInitRing(fifoWriter_t *writer, fifoRing_t *ring);
+int32_t fifoWriterPut(fifoWriter_t *writer, const char *message, uint32_t length);
+int32_t fifoWriterFlush(fifoWriter_t *writer);
+void fifoWriterClose(fifoWriter_t *writer);
+
+void fifoReaderInit(fifoReader_t *reader, int32_t fd);
+void fifoReaderInitRing(fifoReader_t *reader, fifoRing_t *ring);
+void fifoReaderClose(fifoReader_t *reader);
+int32_t fifoReaderWait(fifoReader_t *reader, int32_t timeoutMs);
+int32_t fifoReaderFill(fifoReader_t *reader);
+bool fifoReaderNext(fifoReader_t *reader, fifoRun_t *run);
+
+/* named fifo only: a run read header first, then its body moved by itself */
+int32_t fifoReaderHeader(fifoReader_t *reader, fifoRun_t *run);
+int32_t fifoReaderBody(fifoReader_t *reader, fifoRun_t *run);
+int32_t fifoReaderSplice(fifoReader_t *reader, int32_t fd, uint32_t length);
+
+#endif /* FIFO_H */
@@ -14,13 +14,23 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
 
 #include "fifo.h"
+#include "sink.h"
 
 
 /* defines ------------------------------------------------------------------ */
 #define FIFO_NAME	"fifo"
-#define BUFFER_SIZE	300
+#define FIFO_DIRECTORY	"fifos"
+#define FAN_IN_WRITERS	1024
+#define FAN_IN_EVENTS	64
 
 
 /* private typedefs --------------------------------------------------------- */
@@ -31,152 +41,623 @@ typedef enum
 	ERROR = -1,
 } messageType_t;
 
+/* One writer of the fan-in, known by the name of its FIFO in FIFO_DIRECTORY */
+typedef struct
+{
+	fifoReader_t reader;
+	char name[NAME_MAX + 1];
+} writerStream_t;
+
 
 /* private function prototypes ---------------------------------------------- */
-static int8_t validateMessage(uint8_t *message);
-static uint8_t* getLog(uint8_t *fullLog);
-static uint8_t* getSign(uint8_t *fullSign);
+static int8_t validateRun(fifoRun_t *run);
+static void writeRuns(fifoReader_t *reader, const char *tag);
+static void writeLog(fifoRun_t *run, const char *tag);
+static void writeSigns(fifoRun_t *run, const char *tag);
+static void writeTagged(int32_t file, fifoRun_t *run, const char *tag);
+static void waitFifo(void);
+static void submitSink(void);
+static void readCopying(void);
+static void readSplicing(void);
+static void readFanIn(void);
+static void addWriter(const char *name);
+static void readWriter(writerStream_t *stream);
+static void removeWriter(writerStream_t *stream);
 
 
 /* private data definition -------------------------------------------------- */
-static FILE *signsFile;
+static int32_t signsFile;
+static int32_t logFile;
+static fifoReader_t fifoReader;
+static sink_t sink;
+static uint64_t bytesLogged;
+static uint32_t signsReceived;
+static uint32_t runsDiscarded;
+static int32_t epollFd;
+static writerStream_t *writers[FAN_IN_WRITERS];
+static uint32_t writerCount;
 
 
 /* public function definitions ---------------------------------------------- */
-int main(void)
+int main(int argc, char *argv[])
 {
-	uint8_t inputBuffer[BUFFER_SIZE];
-	uint8_t inputLog[BUFFER_SIZE];
-	uint8_t inputSignal[BUFFER_SIZE];
-	int32_t bytesRead, fd;
-	int8_t messageType;
+	sinkDurability_t durability = SINK_DURABILITY_NONE;
+	uint32_t syncMs = SINK_DEFAULT_SYNC_MS;
+	uint64_t syncBytes = SINK_DEFAULT_SYNC_BYTES;
+	bool zeroCopy = false, sharedMemory = false, fanIn = false;
+	int32_t option;
 	
-	FILE *logFile;
-
-	/* create named FIFO */
-	createNamedFifo(FIFO_NAME);
+	/* -z: move DATA bodies from the named FIFO to the log file with splice()
+	   -s: receive through a shared memory ring instead of the named FIFO
+	   -f: receive from every writer FIFO in FIFO_DIRECTORY, one per writer
+	   -d: when files are synced to storage, -t and -b: group commit interval and size */
+	while((option = getopt(argc, argv, "zsfd:t:b:")) != -1)
+	{
+		if(option == 'z')
+		{
+			zeroCopy = true;
+		}
+		else if(option == 's')
+		{
+			sharedMemory = true;
+		}
+		else if(option == 'f')
+		{
+			fanIn = true;
+		}
+		else if((option == 'd') && (strcmp(optarg, "none") == 0))
+		{
+			durability = SINK_DURABILITY_NONE;
+		}
+		else if((option == 'd') && (strcmp(optarg, "group") == 0))
+		{
+			durability = SINK_DURABILITY_GROUP;
+		}
+		else if((option == 'd') && (strcmp(optarg, "always") == 0))
+		{
+			durability = SINK_DURABILITY_ALWAYS;
+		}
+		else if((option == 't') && (atoi(optarg) > 0))
+		{
+			syncMs = atoi(optarg);
+		}
+		else if((option == 'b') && (atoll(optarg) > 0))
+		{
+			syncBytes = atoll(optarg);
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [-z | -s | -f] [-d none|group|always] [-t sync ms] [-b sync bytes]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
 	
-	/* open named FIFO */
-	fd = openNamedFifo(FIFO_NAME, O_RDONLY);
+	/* splice() needs the named FIFO, and tagging records needs to look at them */
+	if(zeroCopy + sharedMemory + fanIn > 1)
+	{
+		fprintf(stderr, "-z, -s and -f can't be used together\n");
+		exit(EXIT_FAILURE);
+	}
+	
+	/* files are written asynchronously, the FIFO is never left waiting for storage */
+	if(sinkInit(&sink, durability, syncMs, syncBytes) == -1)
+	{
+		perror("sinkInit");
+		exit(EXIT_FAILURE);
+	}
+
+	if(sharedMemory)
+	{
+		/* create shared ring and wait for a writer */
+		fifoReaderInitRing(&fifoReader, openSharedRing(FIFO_NAME, O_RDONLY));
+	}
+	else if(!fanIn)
+	{
+		/* create named FIFO */
+		createNamedFifo(FIFO_NAME);
+		
+		/* open named FIFO */
+		fifoReaderInit(&fifoReader, openNamedFifo(FIFO_NAME, O_RDONLY));
+	}
 	
 	/* open sign file */
-	signsFile = fopen("Sign.txt", "w");
-	if(NULL == signsFile) 
+	signsFile = sinkOpen(&sink, "Sign.txt");
+	if(-1 == signsFile) 
 	{
 		perror("Sign.txt file couldn't be opened");
 		exit(EXIT_FAILURE);
 	}
 	
 	/* open log file */
-	logFile = fopen("Log.txt", "w");
-	if(NULL == logFile) 
+	logFile = sinkOpen(&sink, "Log.txt");
+	if(-1 == logFile) 
 	{
 		perror("Log.txt file couldn't be opened");
 		exit(EXIT_FAILURE);
 	}
 	
 	
-	/* Loop until read syscall returns a value <= 0 */
+	/* Loop until the named FIFO has no writers left, or until stopped when serving many */
+	if(fanIn)
+	{
+		readFanIn();
+	}
+	else
+	{
+		if(zeroCopy)
+		{
+			readSplicing();
+		}
+		else
+		{
+			readCopying();
+		}
+		
+		runsDiscarded = fifoReader.discarded;
+		fifoReaderClose(&fifoReader);
+	}
+	
+	printf("Reader: %llu bytes logged, %u signals received.\n", (unsigned long long) bytesLogged, signsReceived);
+	
+	if(runsDiscarded > 0)
+	{
+		printf("Reader: %u malformed runs discarded.\n", runsDiscarded);
+	}
+	
+	/* write what is left and close sign and log files */
+	if(sinkClose(&sink) == -1)
+	{
+		perror("Log.txt or Sign.txt couldn't be written");
+		exit(EXIT_FAILURE);
+	}
+	
+	return 0;
+}
+
+
+/* private function definitions --------------------------------------------- */
+void readCopying(void)
+{
+	int32_t bytesRead;
+	
 	do
 	{
-		/* clean input buffer */
-		memset(inputBuffer, 0, sizeof(inputBuffer));
+		waitFifo();
 		
-		/* read data into local buffer */
-		if ((bytesRead = read(fd, inputBuffer, BUFFER_SIZE)) == -1)
+		/* read as many runs as available into local buffer */
+		if ((bytesRead = fifoReaderFill(&fifoReader)) == -1)
 		{
 			perror("read");
 			exit(EXIT_FAILURE);
 		}
-		else
+		
+		/* handle every complete run, an unfinished one is kept for the next read */
+		writeRuns(&fifoReader, NULL);
+		
+		/* everything from this read goes to storage in one submission */
+		submitSink();
+	}
+	while (bytesRead > 0);
+}
+
+void readSplicing(void)
+{
+	fifoRun_t run;
+	int32_t returnCode;
+	int8_t runType;
+	
+	/* only run headers are read, DATA bodies never enter this process */
+	while(1)
+	{
+		waitFifo();
+		
+		if((returnCode = fifoReaderHeader(&fifoReader, &run)) <= 0)
 		{
-			inputBuffer[bytesRead] = '\0';
-			
-			/* validate message to check if the format is valid */
-			messageType = validateMessage(inputBuffer);
-			
-			if(messageType == DATA)
-			{	
-				/* clean input log buffer */
-				memset(inputLog, 0, sizeof(inputLog));
-				
-				/* get useful data */
-				memcpy(inputLog, getLog(inputBuffer), sizeof(inputLog));
-				
-				printf("Reader: read %d bytes: \"%s\".\n\n", (int) strlen((const char *)inputLog), inputLog);
-				
-				/* write on log file */
-				fputs((const char *) inputLog, logFile);
-				fputs("\n", logFile);
-			}
-			else if(messageType == SIGNAL)
+			break;
+		}
+		
+		if((runType = validateRun(&run)) == DATA)
+		{
+			/* log file is only ever written here, the sink just syncs it */
+			if((returnCode = fifoReaderSplice(&fifoReader, sink.files[logFile].fd, run.length)) == -1)
 			{
-				/* clean input signal buffer */
-				memset(inputSignal, 0, sizeof(inputSignal));
-				
-				/* get useful data */
-				memcpy(inputSignal, getSign(inputBuffer), sizeof(inputSignal));
-				
-				printf("Reader: SIGUSR%s received.\n", inputSignal);
-				
-				/* write on signals file */
-				fputs((const char *) inputSignal, signsFile);
-				fputs("\n", signsFile);
+				perror("splice");
+				exit(EXIT_FAILURE);
 			}
+			
+			sinkAdvance(&sink, logFile, returnCode);
+			bytesLogged += returnCode;
+			submitSink();
+			continue;
+		}
+		
+		/* anything else is small: read it, and drop it if the type is wrong */
+		if(fifoReaderBody(&fifoReader, &run) == -1)
+		{
+			perror("read");
+			exit(EXIT_FAILURE);
+		}
+		
+		if(runType == SIGNAL)
+		{
+			writeSigns(&run, NULL);
+			submitSink();
 		}
 	}
-	while (bytesRead > 0);
 	
-	
-	/* close sign file */
-	fclose(signsFile);
-	
-	/* close log file */
-	fclose(logFile);
+	if(returnCode == -1)
+	{
+		perror("read");
+		exit(EXIT_FAILURE);
+	}
 }
 
+void waitFifo(void)
+{
+	int32_t timeout;
+	
+	/* group commit: do not sleep past the time the oldest unsynced data must be synced */
+	while((timeout = sinkTimeout(&sink)) != -1)
+	{
+		if(fifoReaderWait(&fifoReader, timeout) != 0)
+		{
+			break;
+		}
+		
+		submitSink();
+	}
+}
 
-/* private function definitions --------------------------------------------- */
-int8_t validateMessage(uint8_t *message)
+void submitSink(void)
 {
-	printf("Message received: %s.\n", message);
+	if(sinkSubmit(&sink) == -1)
+	{
+		perror("Log.txt or Sign.txt couldn't be written");
+		exit(EXIT_FAILURE);
+	}
+}
 
-	/* if the message format is wrong, then return the message type, else return ERROR */
-	if(strncmp((const char *) message, "DATA:", 5) == 0)
+int8_t validateRun(fifoRun_t *run)
+{
+	/* if the run type is wrong, then return ERROR, else return the message type */
+	if(strcmp(run->type, "DATA") == 0)
 	{
 		return DATA;
 	}
-	else if(strncmp((const char *) message, "SIGN:", 5) == 0)
+	else if(strcmp(run->type, "SIGN") == 0)
 	{
 		return SIGNAL;
 	}
 	else
 	{
-		printf("Message read has wrong format!\n\n");
+		printf("Run read has wrong type: %s.\n\n", run->type);
 		return ERROR;
 	}
 }
 
-uint8_t* getLog(uint8_t *fullLog)
+void writeRuns(fifoReader_t *reader, const char *tag)
+{
+	fifoRun_t run;
+	
+	while(fifoReaderNext(reader, &run))
+	{
+		/* validate run to check if the type is valid */
+		switch(validateRun(&run))
+		{
+			case DATA:
+				writeLog(&run, tag);
+				break;
+			case SIGNAL:
+				writeSigns(&run, tag);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+void writeLog(fifoRun_t *run, const char *tag)
+{
+	/* the body already is one log line per message */
+	writeTagged(logFile, run, tag);
+	
+	bytesLogged += run->length;
+}
+
+void writeSigns(fifoRun_t *run, const char *tag)
+{
+	char *sign = run->body;
+	char *end;
+	
+	/* one signal per message */
+	while((end = memchr(sign, FIFO_DELIMITER, run->body + run->length - sign)) != NULL)
+	{
+		if(tag != NULL)
+		{
+			printf("Reader: SIGUSR%.*s received from writer %s.\n", (int) (end - sign), sign, tag);
+		}
+		else
+		{
+			printf("Reader: SIGUSR%.*s received.\n", (int) (end - sign), sign);
+		}
+		signsReceived++;
+		sign = end + 1;
+	}
+	
+	/* write on signals file */
+	writeTagged(signsFile, run, tag);
+}
+
+void writeTagged(int32_t file, fifoRun_t *run, const char *tag)
 {
-	uint8_t *log;
+	char prefix[NAME_MAX + 4];
+	char *line = run->body;
+	char *end;
+	int32_t returnCode = 0;
+	uint32_t prefixLength;
 	
-	/* get the data after ":" and return the pointer to it */
-	log = (uint8_t *) strtok((char *) fullLog, ":");
-	log = (uint8_t *) strtok(NULL, ":");
+	if(tag == NULL)
+	{
+		returnCode = sinkWrite(&sink, file, run->body, run->length);
+	}
+	else
+	{
+		/* every line gets the writer it came from: "[tag] message" */
+		prefixLength = snprintf(prefix, sizeof(prefix), "[%s] ", tag);
+		
+		while((returnCode == 0) && ((end = memchr(line, FIFO_DELIMITER, run->body + run->length - line)) != NULL))
+		{
+			if((returnCode = sinkWrite(&sink, file, prefix, prefixLength)) == 0)
+			{
+				returnCode = sinkWrite(&sink, file, line, end + 1 - line);
+			}
+			line = end + 1;
+		}
+	}
 	
-	return log;
+	if(returnCode == -1)
+	{
+		perror((file == logFile) ? "Log.txt couldn't be written" : "Sign.txt couldn't be written");
+		exit(EXIT_FAILURE);
+	}
 }
 
-uint8_t* getSign(uint8_t *fullSign)
+void readFanIn(void)
 {
-	uint8_t *sign;
+	struct epoll_event events[FAN_IN_EVENTS], event = { .events = EPOLLIN };
+	struct inotify_event *notification;
+	char notifications[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct signalfd_siginfo signalInfo;
+	struct dirent *entry;
+	sigset_t signals;
+	DIR *directory;
+	int32_t watchFd, signalFd, ready, i, bytesRead;
+	bool running = true;
+	
+	/* writers register by creating their FIFO here */
+	if((mkdir(FIFO_DIRECTORY, 0777) == -1) && (errno != EEXIST))
+	{
+		perror("mkdir");
+		exit(EXIT_FAILURE);
+	}
 	
-	/* get the signal after ":" and return the pointer to it */
-	sign = (uint8_t *) strtok((char *) fullSign, ":");
-	sign = (uint8_t *) strtok(NULL, ":");
+	if((epollFd = epoll_create1(0)) == -1)
+	{
+		perror("epoll_create1");
+		exit(EXIT_FAILURE);
+	}
 	
-	return sign;
+	/* new FIFOs in the directory: watched before the first listing, so none is missed */
+	if(((watchFd = inotify_init1(IN_NONBLOCK)) == -1) || (inotify_add_watch(watchFd, FIFO_DIRECTORY, IN_CREATE | IN_MOVED_TO) == -1))
+	{
+		perror("inotify");
+		exit(EXIT_FAILURE);
+	}
+	
+	event.data.ptr = &watchFd;
+	epoll_ctl(epollFd, EPOLL_CTL_ADD, watchFd, &event);
+	
+	/* SIGINT and SIGTERM end the loop cleanly, the sink still gets flushed */
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	sigprocmask(SIG_BLOCK, &signals, NULL);
+	
+	if((signalFd = signalfd(-1, &signals, SFD_NONBLOCK)) == -1)
+	{
+		perror("signalfd");
+		exit(EXIT_FAILURE);
+	}
+	
+	event.data.ptr = &signalFd;
+	epoll_ctl(epollFd, EPOLL_CTL_ADD, signalFd, &event);
+	
+	/* writers that registered before the reader started */
+	if((directory = opendir(FIFO_DIRECTORY)) != NULL)
+	{
+		while((entry = readdir(directory)) != NULL)
+		{
+			addWriter(entry->d_name);
+		}
+		closedir(directory);
+	}
+	
+	printf("Waiting for writers in %s/...\n", FIFO_DIRECTORY);
+	
+	while(running)
+	{
+		/* group commit: do not sleep past the time the oldest unsynced data must be synced */
+		if((ready = epoll_wait(epollFd, events, FAN_IN_EVENTS, sinkTimeout(&sink))) == -1)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			
+			perror("epoll_wait");
+			exit(EXIT_FAILURE);
+		}
+		
+		/* level triggered: every ready writer gets one read per round, the busiest can't starve the rest */
+		for(i = 0; i < ready; i++)
+		{
+			if(events[i].data.ptr == &watchFd)
+			{
+				while((bytesRead = read(watchFd, notifications, sizeof(notifications))) > 0)
+				{
+					for(notification = (struct inotify_event *) notifications; (char *) notification < notifications + bytesRead;
+					    notification = (struct inotify_event *) ((char *) notification + sizeof(struct inotify_event) + notification->len))
+					{
+						addWriter(notification->name);
+					}
+				}
+			}
+			else if(events[i].data.ptr == &signalFd)
+			{
+				if(read(signalFd, &signalInfo, sizeof(signalInfo)) == sizeof(signalInfo))
+				{
+					printf("Reader: signal %u received, stopping.\n", signalInfo.ssi_signo);
+					running = false;
+				}
+			}
+			else
+			{
+				readWriter(events[i].data.ptr);
+			}
+		}
+		
+		/* everything from this round goes to storage in one submission */
+		submitSink();
+	}
+	
+	/* writers still connected get EPIPE, their FIFOs stay for the next reader */
+	while(writerCount > 0)
+	{
+		runsDiscarded += writers[writerCount - 1]->reader.discarded;
+		close(writers[writerCount - 1]->reader.fd);
+		free(writers[--writerCount]);
+	}
+	
+	close(signalFd);
+	close(watchFd);
+	close(epollFd);
+}
+
+void addWriter(const char *name)
+{
+	struct epoll_event event = { .events = EPOLLIN };
+	char path[PATH_MAX];
+	writerStream_t *stream;
+	struct stat status;
+	int32_t fd;
+	uint32_t i;
+	
+	/* only FIFOs, each one once: the listing and the watch may both report it */
+	snprintf(path, sizeof(path), "%s/%s", FIFO_DIRECTORY, name);
+	
+	if((stat(path, &status) == -1) || !S_ISFIFO(status.st_mode))
+	{
+		return;
+	}
+	
+	for(i = 0; i < writerCount; i++)
+	{
+		if(strcmp(writers[i]->name, name) == 0)
+		{
+			return;
+		}
+	}
+	
+	/* left behind by a writer that died before anyone read it: nobody will ever write to it */
+	if((atoi(name) > 0) && (kill(atoi(name), 0) == -1) && (errno == ESRCH))
+	{
+		unlink(path);
+		return;
+	}
+	
+	if(writerCount == FAN_IN_WRITERS)
+	{
+		printf("Reader: too many writers, %s ignored.\n", name);
+		return;
+	}
+	
+	/* non blocking: opening doesn't wait for the writer, and a read never waits for it either */
+	if((fd = open(path, O_RDONLY | O_NONBLOCK)) == -1)
+	{
+		perror(path);
+		return;
+	}
+	
+	if((stream = malloc(sizeof(writerStream_t))) == NULL)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	
+	fifoReaderInit(&stream->reader, fd);
+	snprintf(stream->name, sizeof(stream->name), "%s", name);
+	
+	event.data.ptr = stream;
+	if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1)
+	{
+		perror("epoll_ctl");
+		exit(EXIT_FAILURE);
+	}
+	
+	writers[writerCount++] = stream;
+	
+	printf("Reader: writer %s connected.\n", name);
 }
 
+void readWriter(writerStream_t *stream)
+{
+	int32_t bytesRead;
+	
+	/* one read, at most a pipe full, then the next writer's turn */
+	if((bytesRead = fifoReaderFill(&stream->reader)) == -1)
+	{
+		if(errno == EAGAIN)
+		{
+			return;
+		}
+		
+		perror(stream->name);
+		exit(EXIT_FAILURE);
+	}
+	
+	writeRuns(&stream->reader, stream->name);
+	
+	/* every writer has closed it: nothing more can come */
+	if(bytesRead == 0)
+	{
+		removeWriter(stream);
+	}
+}
 
+void removeWriter(writerStream_t *stream)
+{
+	char path[PATH_MAX];
+	uint32_t i;
+	
+	epoll_ctl(epollFd, EPOLL_CTL_DEL, stream->reader.fd, NULL);
+	close(stream->reader.fd);
+	
+	/* the writer is gone and its FIFO has been drained: deregister it */
+	snprintf(path, sizeof(path), "%s/%s", FIFO_DIRECTORY, stream->name);
+	unlink(path);
+	
+	printf("Reader: writer %s disconnected.\n", stream->name);
+	
+	runsDiscarded += stream->reader.discarded;
+	
+	for(i = 0; i < writerCount; i++)
+	{
+		if(writers[i] == stream)
+		{
+			writers[i] = writers[--writerCount];
+			break;
+		}
+	}
+	
+	free(stream);
+}
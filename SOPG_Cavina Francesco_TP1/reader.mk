@@ -1,11 +1,13 @@
 CC = gcc
 
-reader: reader.o fifo.o
-	gcc -o reader reader.o fifo.o
+reader: reader.o fifo.o sink.o
+	gcc -o reader reader.o fifo.o sink.o -lrt
 
-reader.o: reader.c
+reader.o: reader.c fifo.h sink.h
 	gcc -Wall -c reader.c
 
-fifo.o: fifo.c
+fifo.o: fifo.c fifo.h
 	gcc -Wall -c fifo.c
 
+sink.o: sink.c sink.h
+	gcc -Wall -c sink.c
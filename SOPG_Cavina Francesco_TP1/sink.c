@@ -0,0 +1,639 @@
+/**
+*	File: "sink.c"
+*	Author: Francesco Cavina
+*
+*/
+
+/* includes ----------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "sink.h"
+
+
+/* defines ------------------------------------------------------------------ */
+/* Completions tell writes (buffer index) from syncs (file index) */
+#define SINK_TAG_WRITE		(1ull << 32)
+#define SINK_TAG_SYNC		(2ull << 32)
+#define SINK_TAG_MASK		(0xFFFFFFFFull)
+
+
+/* private function prototypes ---------------------------------------------- */
+static int32_t sinkSetup(sink_t *sink);
+static struct io_uring_sqe* sinkGetSqe(sink_t *sink);
+static int32_t sinkEnter(sink_t *sink, uint32_t wait);
+static void sinkReap(sink_t *sink);
+static int32_t sinkTakeBuffer(sink_t *sink);
+static int32_t sinkQueueWrite(sink_t *sink, int32_t buffer);
+static int32_t sinkQueueSync(sink_t *sink, int32_t file);
+static uint64_t sinkNow(void);
+
+
+/* public function definitions ---------------------------------------------- */
+int32_t sinkInit(sink_t *sink, sinkDurability_t durability, uint32_t syncMs, uint64_t syncBytes)
+{
+	uint32_t i;
+	
+	memset(sink, 0, sizeof(*sink));
+	sink->ringFd = -1;
+	sink->durability = durability;
+	sink->syncMs = syncMs;
+	sink->syncBytes = syncBytes;
+	
+	/* buffers are page aligned, so they can be registered with the ring */
+	if((sink->memory = mmap(NULL, SINK_BUFFERS * SINK_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+	{
+		sink->memory = NULL;
+		return -1;
+	}
+	
+	for(i = 0; i < SINK_BUFFERS; i++)
+	{
+		sink->freeBuffers[i] = SINK_BUFFERS - 1 - i;
+	}
+	sink->freeCount = SINK_BUFFERS;
+	
+	/* io_uring may be missing or disabled: write synchronously then */
+	if(sinkSetup(sink) == 0)
+	{
+		sink->uring = true;
+	}
+	else
+	{
+		printf("Sink: io_uring not available (%s), writing synchronously.\n", strerror(errno));
+	}
+	
+	return 0;
+}
+
+int32_t sinkOpen(sink_t *sink, const char *path)
+{
+	sinkFile_t *file;
+	
+	if(sink->fileCount == SINK_FILES)
+	{
+		errno = EMFILE;
+		return -1;
+	}
+	
+	file = &sink->files[sink->fileCount];
+	
+	/* same as fopen(path, "w") */
+	if((file->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+	{
+		return -1;
+	}
+	
+	file->offset = 0;
+	file->buffer = -1;
+	file->unsynced = 0;
+	file->dirtySince = 0;
+	
+	return sink->fileCount++;
+}
+
+int32_t sinkWrite(sink_t *sink, int32_t file, const void *data, uint32_t length)
+{
+	sinkFile_t *sinkFile = &sink->files[file];
+	sinkBuffer_t *buffer;
+	uint32_t chunk;
+	
+	while(length > 0)
+	{
+		/* start a buffer where the file ends */
+		if(sinkFile->buffer == -1)
+		{
+			if((sinkFile->buffer = sinkTakeBuffer(sink)) == -1)
+			{
+				return -1;
+			}
+	
+			buffer = &sink->buffers[sinkFile->buffer];
+			buffer->file = file;
+			buffer->offset = sinkFile->offset;
+			buffer->length = 0;
+			buffer->done = 0;
+		}
+	
+		buffer = &sink->buffers[sinkFile->buffer];
+	
+		/* copy what fits, the caller's data is free to be reused on return */
+		chunk = SINK_BUFFER_SIZE - buffer->length;
+		if(chunk > length)
+		{
+			chunk = length;
+		}
+	
+		memcpy(sink->memory + (size_t) sinkFile->buffer * SINK_BUFFER_SIZE + buffer->length, data, chunk);
+		buffer->length += chunk;
+		sinkFile->offset += chunk;
+		data = (const char *) data + chunk;
+		length -= chunk;
+	
+		/* a full buffer is written right away, without waiting for sinkSubmit() */
+		if(buffer->length == SINK_BUFFER_SIZE)
+		{
+			if(sinkQueueWrite(sink, sinkFile->buffer) == -1)
+			{
+				return -1;
+			}
+	
+			sinkFile->buffer = -1;
+		}
+	}
+	
+	return 0;
+}
+
+void sinkAdvance(sink_t *sink, int32_t file, uint32_t length)
+{
+	sinkFile_t *sinkFile = &sink->files[file];
+	
+	/* the caller wrote to the file by itself (splice), only the durability policy applies */
+	if(sinkFile->unsynced == 0)
+	{
+		sinkFile->dirtySince = sinkNow();
+	}
+	
+	sinkFile->offset += length;
+	sinkFile->unsynced += length;
+}
+
+int32_t sinkSubmit(sink_t *sink)
+{
+	sinkFile_t *sinkFile;
+	uint64_t now = sinkNow();
+	uint32_t i;
+	
+	for(i = 0; i < sink->fileCount; i++)
+	{
+		sinkFile = &sink->files[i];
+	
+		/* write partial buffers too: nothing stays in memory until more data comes */
+		if(sinkFile->buffer != -1)
+		{
+			if(sinkQueueWrite(sink, sinkFile->buffer) == -1)
+			{
+				return -1;
+			}
+	
+			sinkFile->buffer = -1;
+		}
+	
+		if(sinkFile->unsynced == 0)
+		{
+			continue;
+		}
+	
+		/* sync whatever the durability mode says is due */
+		if((sink->durability == SINK_DURABILITY_ALWAYS) || ((sink->durability == SINK_DURABILITY_GROUP) &&
+		   ((sinkFile->unsynced >= sink->syncBytes) || (now - sinkFile->dirtySince >= sink->syncMs))))
+		{
+			if(sinkQueueSync(sink, i) == -1)
+			{
+				return -1;
+			}
+		}
+	}
+	
+	/* one syscall submits every request queued since the last one */
+	if(sinkEnter(sink, 0) == -1)
+	{
+		return -1;
+	}
+	
+	/* a request that failed since the last call */
+	if(sink->error != 0)
+	{
+		errno = sink->error;
+		return -1;
+	}
+	
+	return 0;
+}
+
+int32_t sinkTimeout(sink_t *sink)
+{
+	uint64_t now = sinkNow(), due;
+	int32_t timeout = -1;
+	uint32_t i;
+	
+	if(sink->durability != SINK_DURABILITY_GROUP)
+	{
+		return -1;
+	}
+	
+	/* time left until the oldest unsynced data must be synced */
+	for(i = 0; i < sink->fileCount; i++)
+	{
+		if(sink->files[i].unsynced == 0)
+		{
+			continue;
+		}
+	
+		due = sink->files[i].dirtySince + sink->syncMs;
+	
+		if(due <= now)
+		{
+			return 0;
+		}
+	
+		if((timeout == -1) || (due - now < (uint64_t) timeout))
+		{
+			timeout = due - now;
+		}
+	}
+	
+	return timeout;
+}
+
+int32_t sinkClose(sink_t *sink)
+{
+	int32_t returnCode = 0;
+	uint32_t i;
+	
+	/* write what is left, and sync it unless durability is off */
+	if(sinkSubmit(sink) == -1)
+	{
+		returnCode = -1;
+	}
+	
+	for(i = 0; (sink->durability != SINK_DURABILITY_NONE) && (i < sink->fileCount); i++)
+	{
+		if((sink->files[i].unsynced > 0) && (sinkQueueSync(sink, i) == -1))
+		{
+			returnCode = -1;
+		}
+	}
+	
+	/* wait for every request before closing the files */
+	while(sink->uring && ((sink->queued > 0) || (sink->inflight > 0)))
+	{
+		if(sinkEnter(sink, 1) == -1)
+		{
+			returnCode = -1;
+			break;
+		}
+	}
+	
+	if(sink->error != 0)
+	{
+		errno = sink->error;
+		returnCode = -1;
+	}
+	
+	for(i = 0; i < sink->fileCount; i++)
+	{
+		close(sink->files[i].fd);
+	}
+	
+	if(sink->uring)
+	{
+		munmap(sink->sqes, sink->sqEntries * sizeof(struct io_uring_sqe));
+		if(sink->cqRing != sink->sqRing)
+		{
+			munmap(sink->cqRing, sink->cqRingSize);
+		}
+		munmap(sink->sqRing, sink->sqRingSize);
+		close(sink->ringFd);
+	}
+	
+	munmap(sink->memory, SINK_BUFFERS * SINK_BUFFER_SIZE);
+	
+	return returnCode;
+}
+
+
+/* private function definitions --------------------------------------------- */
+int32_t sinkSetup(sink_t *sink)
+{
+	struct io_uring_params params;
+	struct iovec iov[SINK_BUFFERS];
+	uint32_t i;
+	
+	memset(&params, 0, sizeof(params));
+	
+	if((sink->ringFd = syscall(__NR_io_uring_setup, SINK_RING_ENTRIES, &params)) < 0)
+	{
+		return -1;
+	}
+	
+	/* map submission and completion rings, a single mapping on recent kernels */
+	sink->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	sink->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if(sink->cqRingSize > sink->sqRingSize)
+		{
+			sink->sqRingSize = sink->cqRingSize;
+		}
+		sink->cqRingSize = sink->sqRingSize;
+	}
+	
+	if((sink->sqRing = mmap(NULL, sink->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, sink->ringFd, IORING_OFF_SQ_RING)) == MAP_FAILED)
+	{
+		close(sink->ringFd);
+		return -1;
+	}
+	
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		sink->cqRing = sink->sqRing;
+	}
+	else if((sink->cqRing = mmap(NULL, sink->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, sink->ringFd, IORING_OFF_CQ_RING)) == MAP_FAILED)
+	{
+		munmap(sink->sqRing, sink->sqRingSize);
+		close(sink->ringFd);
+		return -1;
+	}
+	
+	if((sink->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, sink->ringFd, IORING_OFF_SQES)) == MAP_FAILED)
+	{
+		if(sink->cqRing != sink->sqRing)
+		{
+			munmap(sink->cqRing, sink->cqRingSize);
+		}
+		munmap(sink->sqRing, sink->sqRingSize);
+		close(sink->ringFd);
+		return -1;
+	}
+	
+	sink->sqEntries = params.sq_entries;
+	sink->sqHead = (uint32_t *) ((char *) sink->sqRing + params.sq_off.head);
+	sink->sqTail = (uint32_t *) ((char *) sink->sqRing + params.sq_off.tail);
+	sink->sqArray = (uint32_t *) ((char *) sink->sqRing + params.sq_off.array);
+	sink->sqMask = *(uint32_t *) ((char *) sink->sqRing + params.sq_off.ring_mask);
+	sink->cqHead = (uint32_t *) ((char *) sink->cqRing + params.cq_off.head);
+	sink->cqTail = (uint32_t *) ((char *) sink->cqRing + params.cq_off.tail);
+	sink->cqMask = *(uint32_t *) ((char *) sink->cqRing + params.cq_off.ring_mask);
+	sink->cqes = (struct io_uring_cqe *) ((char *) sink->cqRing + params.cq_off.cqes);
+	
+	/* registered buffers are pinned once instead of on every write. Optional: memlock limits may refuse it */
+	for(i = 0; i < SINK_BUFFERS; i++)
+	{
+		iov[i].iov_base = sink->memory + (size_t) i * SINK_BUFFER_SIZE;
+		iov[i].iov_len = SINK_BUFFER_SIZE;
+	}
+	
+	sink->registered = (syscall(__NR_io_uring_register, sink->ringFd, IORING_REGISTER_BUFFERS, iov, SINK_BUFFERS) == 0);
+	
+	return 0;
+}
+
+struct io_uring_sqe* sinkGetSqe(sink_t *sink)
+{
+	struct io_uring_sqe *sqe;
+	uint32_t tail = *sink->sqTail;
+	
+	/* submission ring full: hand it to the kernel, which consumes it on the spot */
+	if(tail - __atomic_load_n(sink->sqHead, __ATOMIC_ACQUIRE) == sink->sqEntries)
+	{
+		if(sinkEnter(sink, 0) == -1)
+		{
+			return NULL;
+		}
+	}
+	
+	sqe = &sink->sqes[tail & sink->sqMask];
+	memset(sqe, 0, sizeof(*sqe));
+	sink->sqArray[tail & sink->sqMask] = tail & sink->sqMask;
+	
+	/* the caller fills the entry before the next sinkEnter(), the tail is only read by the kernel there */
+	__atomic_store_n(sink->sqTail, tail + 1, __ATOMIC_RELEASE);
+	sink->queued++;
+	
+	return sqe;
+}
+
+int32_t sinkEnter(sink_t *sink, uint32_t wait)
+{
+	int32_t submitted;
+	
+	if(!sink->uring)
+	{
+		return 0;
+	}
+	
+	/* submit everything queued, optionally waiting for some completions */
+	while((sink->queued > 0) || (wait > 0))
+	{
+		if((submitted = syscall(__NR_io_uring_enter, sink->ringFd, sink->queued, wait, (wait > 0) ? IORING_ENTER_GETEVENTS : 0, NULL, 0)) < 0)
+		{
+			if((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY))
+			{
+				sinkReap(sink);
+				continue;
+			}
+	
+			return -1;
+		}
+	
+		sink->queued -= submitted;
+		sink->inflight += submitted;
+		wait = 0;
+	}
+	
+	sinkReap(sink);
+	
+	return 0;
+}
+
+void sinkReap(sink_t *sink)
+{
+	struct io_uring_cqe *cqe;
+	sinkBuffer_t *buffer;
+	uint32_t head = *sink->cqHead;
+	uint32_t index;
+	
+	while(head != __atomic_load_n(sink->cqTail, __ATOMIC_ACQUIRE))
+	{
+		cqe = &sink->cqes[head & sink->cqMask];
+		index = cqe->user_data & SINK_TAG_MASK;
+		sink->inflight--;
+	
+		if(cqe->res < 0)
+		{
+			/* keep the first error, the data is lost anyway */
+			if(sink->error == 0)
+			{
+				sink->error = -cqe->res;
+			}
+	
+			if((cqe->user_data & ~SINK_TAG_MASK) == SINK_TAG_WRITE)
+			{
+				sink->freeBuffers[sink->freeCount++] = index;
+			}
+		}
+		else if((cqe->user_data & ~SINK_TAG_MASK) == SINK_TAG_WRITE)
+		{
+			buffer = &sink->buffers[index];
+			buffer->done += cqe->res;
+	
+			/* a short write goes again from where it stopped, it is not synced until the next sync */
+			if((buffer->done < buffer->length) && (cqe->res > 0))
+			{
+				sink->files[buffer->file].unsynced += buffer->length - buffer->done;
+	
+				__atomic_store_n(sink->cqHead, ++head, __ATOMIC_RELEASE);
+	
+				/* the rest can't be queued: it is lost, reported like a failed write */
+				if(sinkQueueWrite(sink, index) == -1)
+				{
+					if(sink->error == 0)
+					{
+						sink->error = errno;
+					}
+	
+					sink->freeBuffers[sink->freeCount++] = index;
+				}
+	
+				/* queueing may have reaped completions by itself */
+				head = *sink->cqHead;
+				continue;
+			}
+	
+			/* nothing written: the file takes no more, retrying would never end */
+			if(buffer->done < buffer->length)
+			{
+				if(sink->error == 0)
+				{
+					sink->error = EIO;
+				}
+			}
+	
+			sink->freeBuffers[sink->freeCount++] = index;
+		}
+	
+		__atomic_store_n(sink->cqHead, ++head, __ATOMIC_RELEASE);
+	}
+}
+
+int32_t sinkTakeBuffer(sink_t *sink)
+{
+	/* every buffer is being written: the only place the caller waits for storage */
+	while(sink->freeCount == 0)
+	{
+		if(sinkEnter(sink, 1) == -1)
+		{
+			return -1;
+		}
+	}
+	
+	return sink->freeBuffers[--sink->freeCount];
+}
+
+int32_t sinkQueueWrite(sink_t *sink, int32_t index)
+{
+	sinkBuffer_t *buffer = &sink->buffers[index];
+	sinkFile_t *sinkFile = &sink->files[buffer->file];
+	struct io_uring_sqe *sqe;
+	char *data = sink->memory + (size_t) index * SINK_BUFFER_SIZE + buffer->done;
+	uint32_t length = buffer->length - buffer->done;
+	ssize_t bytesWritten;
+	
+	if(buffer->done == 0)
+	{
+		if(sinkFile->unsynced == 0)
+		{
+			sinkFile->dirtySince = sinkNow();
+		}
+	
+		sinkFile->unsynced += length;
+	}
+	
+	/* no ring: write it now */
+	if(!sink->uring)
+	{
+		while(length > 0)
+		{
+			if((bytesWritten = pwrite(sinkFile->fd, data, length, buffer->offset + buffer->done)) <= 0)
+			{
+				if((bytesWritten == -1) && (errno == EINTR))
+				{
+					continue;
+				}
+	
+				/* nothing written: same as the ring, an error instead of retrying forever */
+				if(bytesWritten == 0)
+				{
+					errno = EIO;
+				}
+	
+				sink->freeBuffers[sink->freeCount++] = index;
+				return -1;
+			}
+	
+			buffer->done += bytesWritten;
+			data += bytesWritten;
+			length -= bytesWritten;
+		}
+	
+		sink->freeBuffers[sink->freeCount++] = index;
+		return 0;
+	}
+	
+	if((sqe = sinkGetSqe(sink)) == NULL)
+	{
+		return -1;
+	}
+	
+	/* every buffer has its own offset, so writes may complete in any order */
+	sqe->opcode = sink->registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+	sqe->fd = sinkFile->fd;
+	sqe->addr = (uint64_t) (uintptr_t) data;
+	sqe->len = length;
+	sqe->off = buffer->offset + buffer->done;
+	sqe->buf_index = sink->registered ? index : 0;
+	sqe->user_data = SINK_TAG_WRITE | index;
+	
+	return 0;
+}
+
+int32_t sinkQueueSync(sink_t *sink, int32_t file)
+{
+	sinkFile_t *sinkFile = &sink->files[file];
+	struct io_uring_sqe *sqe;
+	
+	sinkFile->unsynced = 0;
+	
+	/* no ring: sync now */
+	if(!sink->uring)
+	{
+		return fdatasync(sinkFile->fd);
+	}
+	
+	if((sqe = sinkGetSqe(sink)) == NULL)
+	{
+		return -1;
+	}
+	
+	/* drained: starts once every write submitted before it has completed */
+	sqe->opcode = IORING_OP_FSYNC;
+	sqe->flags = IOSQE_IO_DRAIN;
+	sqe->fd = sinkFile->fd;
+	sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+	sqe->user_data = SINK_TAG_SYNC | file;
+	
+	return 0;
+}
+
+uint64_t sinkNow(void)
+{
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	
+	return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
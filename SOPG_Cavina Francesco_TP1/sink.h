@@ -0,0 +1,101 @@
+/**
+*	File: "sink.h"
+*	Author: Francesco Cavina
+*
+*/
+
+#ifndef SINK_H
+#define SINK_H
+
+/* includes ----------------------------------------------------------------- */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+/* defines ------------------------------------------------------------------ */
+#define SINK_FILES		4
+#define SINK_BUFFERS		64
+#define SINK_BUFFER_SIZE	65536
+#define SINK_RING_ENTRIES	256
+
+#define SINK_DEFAULT_SYNC_MS	100
+#define SINK_DEFAULT_SYNC_BYTES	(1024 * 1024)
+
+/* public typedefs ---------------------------------------------------------- */
+/* When written data is forced to storage with fdatasync() */
+typedef enum
+{
+	SINK_DURABILITY_NONE = 0,	// Never, the kernel writes it back when it wants
+	SINK_DURABILITY_GROUP = 1,	// Once syncMs have passed or syncBytes have piled up since the first unsynced byte
+	SINK_DURABILITY_ALWAYS = 2,	// After every sinkSubmit() that wrote something
+} sinkDurability_t;
+
+/* Registered buffer, filled by sinkWrite() and written to its file in one request */
+typedef struct
+{
+	int32_t file;
+	uint64_t offset;	// Where the buffer goes in the file
+	uint32_t length;	// Bytes filled
+	uint32_t done;		// Bytes already written (short writes are resubmitted)
+} sinkBuffer_t;
+
+typedef struct
+{
+	int32_t fd;
+	uint64_t offset;	// End of the data handed to the sink
+	int32_t buffer;		// Buffer being filled, -1: none
+	uint64_t unsynced;	// Bytes written since the last fdatasync() was requested
+	uint64_t dirtySince;	// When unsynced became non zero (ms)
+} sinkFile_t;
+
+/*
+*	Appends to files through io_uring, so the caller never waits for storage:
+*	data is copied into registered buffers and written asynchronously, and
+*	fdatasync() requests are queued after the writes they must cover. The caller
+*	only waits when every buffer is still being written. Without io_uring the same
+*	calls fall back to pwrite() and fdatasync().
+*/
+typedef struct
+{
+	bool uring;
+	bool registered;	// Buffers registered with the ring, written with WRITE_FIXED
+	int32_t ringFd;
+	void *sqRing;
+	void *cqRing;
+	size_t sqRingSize;
+	size_t cqRingSize;
+	struct io_uring_sqe *sqes;
+	uint32_t sqEntries;
+	uint32_t *sqHead;
+	uint32_t *sqTail;
+	uint32_t *sqArray;
+	uint32_t sqMask;
+	uint32_t *cqHead;
+	uint32_t *cqTail;
+	uint32_t cqMask;
+	struct io_uring_cqe *cqes;
+	uint32_t queued;	// Requests not submitted yet
+	uint32_t inflight;	// Requests submitted and not completed
+	char *memory;
+	sinkBuffer_t buffers[SINK_BUFFERS];
+	uint32_t freeBuffers[SINK_BUFFERS];
+	uint32_t freeCount;
+	sinkFile_t files[SINK_FILES];
+	uint32_t fileCount;
+	sinkDurability_t durability;
+	uint32_t syncMs;
+	uint64_t syncBytes;
+	int32_t error;		// First failed request (errno), reported by the next call
+} sink_t;
+
+/* public function prototypes ----------------------------------------------- */
+int32_t sinkInit(sink_t *sink, sinkDurability_t durability, uint32_t syncMs, uint64_t syncBytes);
+int32_t sinkOpen(sink_t *sink, const char *path);
+int32_t sinkWrite(sink_t *sink, int32_t file, const void *data, uint32_t length);
+void sinkAdvance(sink_t *sink, int32_t file, uint32_t length);
+int32_t sinkSubmit(sink_t *sink);
+int32_t sinkTimeout(sink_t *sink);
+int32_t sinkClose(sink_t *sink);
+
+#endif /* SINK_H */
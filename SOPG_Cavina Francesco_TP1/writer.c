@@ -15,93 +15,244 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <signal.h>
+#include <stdbool.h>
 
 #include "fifo.h"
 
 
 /* defines ------------------------------------------------------------------ */
 #define FIFO_NAME	"fifo"
-#define BUFFER_SIZE	300
+#define FIFO_DIRECTORY	"fifos"
+#define CONSOLE_SIZE	65536
 
 
 /* private function prototypes ---------------------------------------------- */
-static void writeFifo(char *buffer);
-static void signalHandler1(void);
-static void signalHandler2(void);
+static int32_t readConsole(void);
+static bool nextConsoleLine(char **line, uint32_t *length);
+static void writeFifo(const char *message, uint32_t length);
+static void flushFifo(void);
+static void writeSignals(void);
+static void signalHandler1(int signal);
+static void signalHandler2(int signal);
 
 
 /* private data definition -------------------------------------------------- */
-static int32_t fd;
+static fifoWriter_t fifoWriter;
+static char console[CONSOLE_SIZE];
+static uint32_t consoleStart;
+static uint32_t consoleLength;
+static volatile sig_atomic_t signal1Received;
+static volatile sig_atomic_t signal2Received;
 
 
 /* public function definitions ---------------------------------------------- */
-int main(void)
+int main(int argc, char *argv[])
 {
-	char outputBuffer[BUFFER_SIZE];
+	char *message;
+	uint32_t length;
+	int32_t bytesRead, option;
+	bool sharedMemory = false, fanIn = false;
 	
-	/* create named FIFO */
-	createNamedFifo(FIFO_NAME);
+	/* -s: send through a shared memory ring instead of the named FIFO
+	   -f: send through a FIFO of our own, for a reader serving many writers */
+	while((option = getopt(argc, argv, "sf")) != -1)
+	{
+		if(option == 's')
+		{
+			sharedMemory = true;
+		}
+		else if(option == 'f')
+		{
+			fanIn = true;
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [-s | -f]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
 	
-	/* open named FIFO */
-	fd = openNamedFifo(FIFO_NAME, O_WRONLY);
+	if(sharedMemory)
+	{
+		/* open shared ring, set up by the reader */
+		fifoWriterInitRing(&fifoWriter, openSharedRing(FIFO_NAME, O_WRONLY));
+	}
+	else if(fanIn)
+	{
+		/* create and open our own FIFO, the reader finds it in FIFO_DIRECTORY */
+		fifoWriterInit(&fifoWriter, openWriterFifo(FIFO_DIRECTORY));
+	}
+	else
+	{
+		/* create named FIFO */
+		createNamedFifo(FIFO_NAME);
+		
+		/* open named FIFO */
+		fifoWriterInit(&fifoWriter, openNamedFifo(FIFO_NAME, O_WRONLY));
+	}
 	
-	/* set config for replacing the default handler of signal SIGUSR1 */
+	/* set config for replacing the default handler of signal SIGUSR1. No SA_RESTART: a signal
+	   interrupts the console read, so its message is sent right away from the main loop */
 	struct sigaction signal1;
 	signal1.sa_handler = signalHandler1;
-	signal1.sa_flags = SA_RESTART;
+	signal1.sa_flags = 0;
 	sigemptyset(&signal1.sa_mask);
 	sigaction(SIGUSR1, &signal1, NULL);
 	
 	/* set config for replacing the default handler of signal SIGUSR2 */
 	struct sigaction signal2;
 	signal2.sa_handler = signalHandler2;
-	signal2.sa_flags = SA_RESTART;
+	signal2.sa_flags = 0;
 	sigemptyset(&signal2.sa_mask);
 	sigaction(SIGUSR2, &signal2, NULL);
 
-	/* loop forever */
-	while (1)
+	/* Loop until the console is closed */
+	do
 	{
-		/* get some text from console */
-		fgets(outputBuffer, BUFFER_SIZE, stdin);
-		outputBuffer[strcspn(outputBuffer, "\n")] = 0;
-		writeFifo(outputBuffer);
+		/* get as many lines as available from console */
+		if(((bytesRead = readConsole()) == -1) && (errno != EINTR))
+		{
+			perror("read");
+			exit(EXIT_FAILURE);
+		}
+		
+		/* queue signals received meanwhile */
+		writeSignals();
+		
+		/* queue every line read, they stay in the console buffer until flushed */
+		while(nextConsoleLine(&message, &length))
+		{
+			if(length > 0)
+			{
+				writeFifo(message, length);
+			}
+		}
+		
+		/* send the batch before the console buffer is reused */
+		flushFifo();
 	}
+	while(bytesRead != 0);
+	
+	/* the reader sees the end of stream */
+	fifoWriterClose(&fifoWriter);
+	
+	return 0;
 }
 
 
 /* private function definitions --------------------------------------------- */
-void writeFifo(char *buffer)
+int32_t readConsole(void)
 {
-	uint32_t bytesWritten;
+	int32_t bytesRead;
+	
+	/* lines handed out so far have been sent: keep only the unfinished one, at the front */
+	memmove(console, console + consoleStart, consoleLength - consoleStart);
+	consoleLength -= consoleStart;
+	consoleStart = 0;
+	
+	/* a whole buffer without a new line is far too long for a message, drop it */
+	if(consoleLength == CONSOLE_SIZE)
+	{
+		printf("Writer: message too long, dropped.\n\n");
+		consoleLength = 0;
+	}
+	
+	if((bytesRead = read(STDIN_FILENO, console + consoleLength, CONSOLE_SIZE - consoleLength)) > 0)
+	{
+		consoleLength += bytesRead;
+	}
+	else if((bytesRead == 0) && (consoleLength > 0))
+	{
+		/* end of input: the last line may have no new line, terminate it */
+		console[consoleLength++] = '\n';
+	}
+	
+	return bytesRead;
+}
 
-	/* write buffer to named fifo. Strlen - 1 to avoid sending \n char */
-	if ((bytesWritten = write(fd, buffer, strlen(buffer))-1) == -1)
+bool nextConsoleLine(char **line, uint32_t *length)
+{
+	char *end;
+	
+	/* the rest stays for the next read */
+	if((end = memchr(console + consoleStart, '\n', consoleLength - consoleStart)) == NULL)
 	{
-		perror("write");
+		return false;
+	}
+	
+	*line = console + consoleStart;
+	*length = end - *line;
+	consoleStart += *length + 1;
+	
+	return true;
+}
+
+void writeFifo(const char *message, uint32_t length)
+{
+	/* queue message on the batch, a full batch is written to named fifo */
+	if(fifoWriterPut(&fifoWriter, message, length) == -1)
+	{
+		if(errno == EMSGSIZE)
+		{
+			printf("Writer: message of %u bytes is too long, dropped.\n\n", length);
+			return;
+		}
+		else if(errno == EINVAL)
+		{
+			printf("Writer: message has wrong format, dropped: %.*s.\n\n", (int) length, message);
+			return;
+		}
+		
+		perror("writev");
 		exit(EXIT_FAILURE);
 	}
-	else
+}
+
+void flushFifo(void)
+{
+	uint32_t messages = fifoWriter.messages;
+	int32_t bytesWritten;
+
+	/* write the whole batch to named fifo in one syscall */
+	if((bytesWritten = fifoWriterFlush(&fifoWriter)) == -1)
 	{
-		/* log or signal has been sent through the named fifo */
-		printf("Writer: wrote %s, %d bytes.\n\n", buffer, bytesWritten);
+		perror("writev");
+		exit(EXIT_FAILURE);
+	}
+	else if(bytesWritten > 0)
+	{
+		/* logs and signals have been sent through the named fifo */
+		printf("Writer: wrote %u messages, %d bytes.\n\n", messages, bytesWritten);
 	}
 }
 
-void signalHandler1(void)
+void writeSignals(void)
 {
-	/* handler for SIGUSR1 signal */
-	printf("Se recibió SIGUSR1.\n");
+	if(signal1Received)
+	{
+		signal1Received = 0;
+		printf("Se recibió SIGUSR1.\n");
+		writeFifo("SIGN:1", 6);
+	}
 	
-	writeFifo("SIGN:1");
+	if(signal2Received)
+	{
+		signal2Received = 0;
+		printf("Se recibió SIGUSR2.\n");
+		writeFifo("SIGN:2", 6);
+	}
+}
+
+void signalHandler1(int signal)
+{
+	/* handler for SIGUSR1 signal, the message is sent by the main loop */
+	signal1Received = 1;
 }	
 
-void signalHandler2(void)
+void signalHandler2(int signal)
 {
-	/* handler for SIGUSR2 signal */
-	printf("Se recibió SIGUSR2.\n");
-	
-	writeFifo("SIGN:2");
+	/* handler for SIGUSR2 signal, the message is sent by the main loop */
+	signal2Received = 1;
 }
 
 
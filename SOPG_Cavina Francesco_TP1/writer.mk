@@ -1,11 +1,11 @@
 CC = gcc
 
 writer: writer.o fifo.o
-	gcc -o writer writer.o fifo.o
+	gcc -o writer writer.o fifo.o -lrt
 	
-writer.o: writer.c
+writer.o: writer.c fifo.h
 	gcc -Wall -c writer.c
 	
-fifo.o: fifo.c
+fifo.o: fifo.c fifo.h
 	gcc -Wall -c fifo.c
 
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Builds the Serial Service and the benchmark from this tree, runs one
+# benchmark and appends its CSV lines, labeled with the current commit, to
+# results.csv so runs of different versions can be compared.
+# Usage: ./benchmark.sh [benchmark options] (see ./benchmark --help)
+#        TRANSPORT=tty ./benchmark.sh ...   controller link over a pseudo-terminal
+#        CLIENT=unix ./benchmark.sh ...     client on a unix socket instead of TCP
+
+cd "$(dirname "$0")"
+LABEL=$(git rev-parse --short HEAD 2>/dev/null || echo local)
+
+(cd ../SerialService && sh compilar.sh) || exit 1
+sh compilar.sh || exit 1
+
+if [ "$CLIENT" = "unix" ]; then
+	SOCKET=/tmp/benchmark.sock
+	LABEL="$LABEL-unix"
+	set -- --unix=$SOCKET "$@"
+	SERVICE_OPTIONS="--unix-socket=$SOCKET"
+else
+	SERVICE_OPTIONS=""
+fi
+
+if [ "$TRANSPORT" = "tty" ]; then
+	PTY=/tmp/benchmark.tty
+	./benchmark --csv --label="$LABEL-tty" --pty=$PTY "$@" >> results.csv &
+	SERIAL="--serial=tty --device=$PTY"
+else
+	./benchmark --csv --label="$LABEL" "$@" >> results.csv &
+	SERIAL=""
+fi
+BENCHMARK=$!
+sleep 0.5
+
+../SerialService/serialService --quiet $SERIAL $SERVICE_OPTIONS > serialService.log &
+SERVICE=$!
+
+wait $BENCHMARK
+kill -INT $SERVICE
+wait $SERVICE
+tail -n 2 results.csv
@@ -0,0 +1 @@
+gcc -O2 -pthread -I../SerialService main.c ../SerialService/FrameParser.c ../SerialService/LatencyHistogram.c -o benchmark -lutil
@@ -0,0 +1,1001 @@
+/*
+ * @file   : main.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/*
+ * Load generator for the Serial Service. It plays both ends of the bridge:
+ * the Controller Emulator (listening on port 4040, like Emulador.py) and an
+ * Interface Service client (connecting to port 10000). ">SW:channel,seq"
+ * frames are sent as the controller and ">OUT:channel,seq" frames as the
+ * client; the sequence number travels in the value, so the receiving end can
+ * check order and content and measure the time each frame took through the
+ * service.
+ *
+ * Start the benchmark first, then the Serial Service (it connects to 4040
+ * on startup). With --pty=PATH the controller end is a pseudo-terminal
+ * instead, linked at PATH for "serialService --serial=tty --device=PATH".
+ * With --unix=PATH the client end connects to "serialService --unix-socket=PATH"
+ * instead of port 10000.
+ *
+ * With --links=N the benchmark is N Controller Emulators, listening on ports
+ * 4040 to 4040+N-1 for "serialService -D 127.0.0.1:4040 -D 127.0.0.1:4041...".
+ * The client still numbers channels globally: global channel G is sent and
+ * expected on controller G/C as its local channel G%C, C being
+ * --link-channels (the service's --link-channels, 64 by default).
+ *
+ * With --framing=compact every controller offers ">BIN:1,1" (compact
+ * frames, bitmap ones understood) to "serialService --link-framing=compact"
+ * or "=bitmap", sends its switch states as 4-byte binary frames once the
+ * service answers and reads the binary commands it gets back. A binary
+ * value is only 8 bits, so both directions then carry the frame's lap on
+ * its channel modulo 256 instead of the whole sequence number: a channel
+ * may lose up to 255 values in a row and still be matched.
+ */
+
+/********************** Inclusions *******************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <termios.h>
+#include <pty.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "FrameParser.h"
+#include "LatencyHistogram.h"
+
+/********************** Macros and Definitions *******************************/
+#define CONTROLLER_EMULATOR_SOCKET_IP		("127.0.0.1")
+#define CONTROLLER_EMULATOR_SOCKET_PORT		(4040)
+#define INTERFACE_SERVICE_SOCKET_IP		("127.0.0.1")
+#define INTERFACE_SERVICE_SOCKET_PORT		(10000)
+#define CONNECT_RETRIES				(100)
+#define CONNECT_RETRY_DELAY_US			(100000)
+#define SEND_BUFFER_SIZE			(64 * 1024)
+#define DEFAULT_COUNT				(100000)
+#define DEFAULT_CHANNELS			(8)
+#define DEFAULT_DRAIN_TIMEOUT_MS		(2000)
+#define DEFAULT_LINK_CHANNELS			(64)
+#define LINKS_MAX				(64)
+#define NANOSECONDS_PER_SECOND			(1000000000ULL)
+
+/********************** Internal Data Declaration ****************************/
+typedef enum
+{
+	DIRECTION_SW = 0,			// Controller Emulator -> Interface Service
+	DIRECTION_OUT = 1,			// Interface Service -> Controller Emulator
+	DIRECTIONS = 2
+} direction_t;
+
+/* One socket: frames of one direction are written to it, frames of the other come out of it */
+typedef struct
+{
+	int fd;
+	uint32_t channelBase;			// Global number of its channel 0 (controller links after the first)
+	char txBuffer[SEND_BUFFER_SIZE];
+	uint32_t txLength;			// Bytes generated, not written yet
+	uint32_t txOffset;			// Bytes of txBuffer already written
+	bool compact;				// Compact framing agreed: frames are written binary
+	uint32_t offers;			// Compact framing offers written
+	uint64_t offered;			// When the last one was written (ns)
+	frameParser_t parser;
+} endpoint_t;
+
+/* One direction of the bridge: what was sent on some sockets and what came out of the others */
+typedef struct
+{
+	const char* type;			// Frame type ("SW" or "OUT")
+	bool enabled;
+	endpoint_t* tx;				// Sockets frames are sent on, by link
+	uint32_t txCount;
+	endpoint_t* rx;				// Sockets frames come out of, by link
+	uint32_t rxCount;
+	uint64_t nextBurst;			// When the next burst is due (ns)
+	uint64_t* sendTimes;			// Generation time of every sequence number
+	int32_t* lastSeq;			// Last sequence number sent per channel
+	int32_t* lastSeen;			// Last sequence number received per channel
+	latencyHistogram_t latency;
+	uint32_t sent;
+	uint32_t received;
+	uint32_t expected;			// Next sequence number expected in order
+	uint32_t missing;			// Sequence numbers skipped (dropped or coalesced)
+	uint32_t reordered;			// Sequence numbers older than one already received on their channel
+	uint32_t corrupted;			// Frames that don't decode or don't match what was sent
+	uint64_t lastReceived;			// Time the last frame came out (ns)
+} stream_t;
+
+/********************** Internal Functions Declaration ***********************/
+static void argsParse(int argc, char* argv[]);
+static void usagePrint(const char* program);
+static int controllerListen(uint32_t link);
+static int controllerAccept(int base_fd);
+static int controllerPty(const char* link);
+static int interfaceConnect(void);
+static void endpointInit(endpoint_t* endpoint, int fd, uint32_t channelBase);
+static void endpointOffer(endpoint_t* endpoint, uint64_t now);
+static void streamInit(stream_t* stream, const char* type, endpoint_t* tx, uint32_t txCount, endpoint_t* rx, uint32_t rxCount);
+static void streamDeinit(stream_t* stream);
+static void streamGenerate(stream_t* stream, uint64_t now);
+static bool streamPending(stream_t* stream);
+static int streamSend(stream_t* stream);
+static int streamReceive(stream_t* stream);
+static void streamCheck(stream_t* stream, endpoint_t* endpoint, const char* frame, uint32_t length, uint64_t now);
+static bool streamFraming(endpoint_t* endpoint, const char* frame, uint32_t length);
+static bool streamDone(stream_t* stream);
+static void streamReport(stream_t* stream, uint64_t elapsed);
+static void socketNonBlocking(int fd);
+
+/********************** Internal Data Definition *****************************/
+static uint32_t count = DEFAULT_COUNT;				// Frames per direction
+static uint32_t rate = 0;					// Frames per second per direction, 0 = as fast as possible
+static uint32_t burst = 1;					// Frames generated back to back
+static uint32_t channels = DEFAULT_CHANNELS;			// Channels the sequence numbers are spread over
+static uint32_t links = 1;					// Controller Emulators
+static uint32_t linkChannels = DEFAULT_LINK_CHANNELS;		// Global channels per controller
+static uint32_t drainTimeout = DEFAULT_DRAIN_TIMEOUT_MS;	// Wait for stragglers once everything is sent
+static bool directions[DIRECTIONS] = {true, true};
+static bool csv = false;					// One machine readable line per direction
+static const char* label = "serialService";			// Tags CSV lines (e.g. a commit id)
+static const char* ptyLink = NULL;				// Controller end on a pseudo-terminal linked here
+static const char* unixPath = NULL;				// Client end on the service's unix socket
+static bool compact = false;					// Controllers offer compact framing, values are laps modulo 256
+static stream_t streams[DIRECTIONS];
+static endpoint_t* controllers = NULL;				// Controller end, one per link
+static endpoint_t interface;					// Client end
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+static int controllerListen(uint32_t link)
+{
+	struct sockaddr_in addr;
+	int base_fd, enable = 1;
+
+	/* Listen where the Serial Service looks for the Controller Emulator */
+	if((base_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+	{
+		perror("ERROR socket() API");
+		exit(1);
+	}
+
+	setsockopt(base_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(CONTROLLER_EMULATOR_SOCKET_PORT + link);
+	inet_pton(AF_INET, CONTROLLER_EMULATOR_SOCKET_IP, &addr.sin_addr);
+
+	if((bind(base_fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) || (listen(base_fd, 1) == -1))
+	{
+		perror("ERROR bind() API");
+		exit(1);
+	}
+
+	if(!csv)
+	{
+		printf("Waiting for the Serial Service on port %u...\r\n", CONTROLLER_EMULATOR_SOCKET_PORT + link);
+	}
+
+	return base_fd;
+}
+
+static int controllerAccept(int base_fd)
+{
+	int fd;
+
+	if((fd = accept(base_fd, NULL, NULL)) == -1)
+	{
+		perror("ERROR accept() API");
+		exit(1);
+	}
+
+	close(base_fd);
+
+	return fd;
+}
+
+static int controllerPty(const char* link)
+{
+	struct termios tty;
+	int master_fd, slave_fd;
+
+	/* Raw from the start, the service sets the same mode when it opens the slave */
+	memset(&tty, 0, sizeof(tty));
+	cfmakeraw(&tty);
+	cfsetispeed(&tty, B115200);
+	cfsetospeed(&tty, B115200);
+
+	if(openpty(&master_fd, &slave_fd, NULL, &tty, NULL) == -1)
+	{
+		perror("ERROR openpty() API");
+		exit(1);
+	}
+
+	/* Slave stays open here too, so the master never reads EIO between service runs */
+	unlink(link);
+	if(symlink(ttyname(slave_fd), link) == -1)
+	{
+		perror("ERROR symlink() API");
+		exit(1);
+	}
+
+	if(!csv)
+	{
+		printf("Controller Emulator on %s (%s).\r\n", ttyname(slave_fd), link);
+	}
+
+	return master_fd;
+}
+
+static int interfaceConnect(void)
+{
+	struct sockaddr_storage addr;
+	struct sockaddr_in* inet = (struct sockaddr_in *) &addr;
+	struct sockaddr_un* local = (struct sockaddr_un *) &addr;
+	uint32_t retries;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+
+	if(unixPath != NULL)
+	{
+		local->sun_family = AF_UNIX;
+		snprintf(local->sun_path, sizeof(local->sun_path), "%s", unixPath);
+	}
+	else
+	{
+		inet->sin_family = AF_INET;
+		inet->sin_port = htons(INTERFACE_SERVICE_SOCKET_PORT);
+		inet_pton(AF_INET, INTERFACE_SERVICE_SOCKET_IP, &inet->sin_addr);
+	}
+
+	/* The service opens its listener after connecting to the controller */
+	for(retries = 0; retries < CONNECT_RETRIES; retries++)
+	{
+		if((fd = socket(addr.ss_family, SOCK_STREAM, 0)) == -1)
+		{
+			perror("ERROR socket() API");
+			exit(1);
+		}
+
+		if(connect(fd, (struct sockaddr *) &addr, (unixPath != NULL) ? sizeof(struct sockaddr_un) : sizeof(struct sockaddr_in)) == 0)
+		{
+			return fd;
+		}
+
+		close(fd);
+		usleep(CONNECT_RETRY_DELAY_US);
+	}
+
+	perror("ERROR connect() API");
+	exit(1);
+}
+
+static void socketNonBlocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+
+	if(fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+	{
+		perror("ERROR fcntl() API");
+		exit(1);
+	}
+}
+
+static void endpointInit(endpoint_t* endpoint, int fd, uint32_t channelBase)
+{
+	memset(endpoint, 0, sizeof(endpoint_t));
+
+	endpoint->fd = fd;
+	endpoint->channelBase = channelBase;
+	socketNonBlocking(fd);
+	frameParserInit(&endpoint->parser);
+}
+
+static void endpointOffer(endpoint_t* endpoint, uint64_t now)
+{
+	char offer[FRAME_MAX_SIZE];
+	int length;
+
+	/* Until answered, between whole buffers only: a tty drops what came before the service opened it */
+	if(endpoint->compact || (endpoint->offers == CONNECT_RETRIES) || (endpoint->txOffset < endpoint->txLength) || ((now - endpoint->offered) < (CONNECT_RETRY_DELAY_US * 1000ULL)))
+	{
+		return;
+	}
+
+	length = snprintf(offer, sizeof(offer), "%s%d,%d\r\n", FRAME_COMPACT_OFFER, FRAME_COMPACT_VERSION, FRAME_COMPACT_FLAG_BITMAP);
+
+	if(write(endpoint->fd, offer, (size_t) length) == length)
+	{
+		endpoint->offers++;
+		endpoint->offered = now;
+	}
+}
+
+static void streamInit(stream_t* stream, const char* type, endpoint_t* tx, uint32_t txCount, endpoint_t* rx, uint32_t rxCount)
+{
+	memset(stream, 0, sizeof(stream_t));
+
+	stream->type = type;
+	stream->tx = tx;
+	stream->txCount = txCount;
+	stream->rx = rx;
+	stream->rxCount = rxCount;
+	stream->sendTimes = calloc(count, sizeof(uint64_t));
+	stream->lastSeq = malloc(channels * sizeof(int32_t));
+	stream->lastSeen = malloc(channels * sizeof(int32_t));
+
+	if((stream->sendTimes == NULL) || (stream->lastSeq == NULL) || (stream->lastSeen == NULL))
+	{
+		perror("ERROR malloc() API");
+		exit(1);
+	}
+
+	/* -1: nothing sent or received on the channel yet */
+	memset(stream->lastSeq, 0xFF, channels * sizeof(int32_t));
+	memset(stream->lastSeen, 0xFF, channels * sizeof(int32_t));
+
+	latencyHistogramInit(&stream->latency, type);
+}
+
+static void streamDeinit(stream_t* stream)
+{
+	free(stream->sendTimes);
+	free(stream->lastSeq);
+	free(stream->lastSeen);
+}
+
+static void streamGenerate(stream_t* stream, uint64_t now)
+{
+	frameFields_t fields;
+	endpoint_t* endpoint;
+	uint32_t i, channel, value;
+	int length;
+
+	/* Unsent bytes are written first, the buffers are only refilled once all are empty */
+	if(!stream->enabled || streamPending(stream) || (stream->sent == count) || (now < stream->nextBurst))
+	{
+		return;
+	}
+
+	for(i = 0; i < stream->txCount; i++)
+	{
+		stream->tx[i].txLength = 0;
+		stream->tx[i].txOffset = 0;
+	}
+
+	/* At a fixed rate one burst per period, otherwise fill the buffers until one is full */
+	for(i = 0; (stream->sent < count) && ((rate == 0) || (i < burst)); i++)
+	{
+		channel = stream->sent % channels;
+		endpoint = &stream->tx[(stream->txCount == 1) ? 0 : (channel / linkChannels)];
+
+		if((endpoint->txLength + FRAME_MAX_SIZE) > SEND_BUFFER_SIZE)
+		{
+			break;
+		}
+
+		/* The controller a channel lives on numbers it from its own 0 */
+		value = compact ? ((stream->sent / channels) % (FRAME_COMPACT_VALUE_MAX + 1)) : stream->sent;
+		length = 0;
+
+		if(endpoint->compact)
+		{
+			strcpy(fields.type, stream->type);
+			fields.channel = channel - endpoint->channelBase;
+			fields.value = (int32_t) value;
+			fields.sequenced = false;
+			length = (int) frameEncodeCompact(&endpoint->txBuffer[endpoint->txLength], &fields);
+		}
+
+		/* Text, or a channel too high for a binary frame */
+		if(length == 0)
+		{
+			length = snprintf(&endpoint->txBuffer[endpoint->txLength], FRAME_MAX_SIZE, ">%s:%u,%u\r\n", stream->type, channel - endpoint->channelBase, value);
+		}
+
+		stream->sendTimes[stream->sent] = now;
+		stream->lastSeq[channel] = (int32_t) stream->sent;
+		endpoint->txLength += (uint32_t) length;
+		stream->sent++;
+	}
+
+	if(rate > 0)
+	{
+		stream->nextBurst = ((stream->nextBurst == 0) ? now : stream->nextBurst) + ((uint64_t) burst * NANOSECONDS_PER_SECOND) / rate;
+	}
+}
+
+static bool streamPending(stream_t* stream)
+{
+	uint32_t i;
+
+	for(i = 0; i < stream->txCount; i++)
+	{
+		if(stream->tx[i].txOffset < stream->tx[i].txLength)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int streamSend(stream_t* stream)
+{
+	endpoint_t* endpoint;
+	ssize_t bytes;
+	uint32_t i;
+	int result = 0;
+
+	for(i = 0; i < stream->txCount; i++)
+	{
+		endpoint = &stream->tx[i];
+
+		while(endpoint->txOffset < endpoint->txLength)
+		{
+			bytes = write(endpoint->fd, &endpoint->txBuffer[endpoint->txOffset], endpoint->txLength - endpoint->txOffset);
+
+			if(bytes == -1)
+			{
+				if((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				{
+					result = 1;
+					break;
+				}
+
+				perror("ERROR write() API");
+				return -1;
+			}
+
+			endpoint->txOffset += (uint32_t) bytes;
+		}
+	}
+
+	return result;
+}
+
+static int streamReceive(stream_t* stream)
+{
+	endpoint_t* endpoint;
+	const char* frame;
+	uint32_t length, room, i;
+	uint64_t now;
+	char* space;
+	ssize_t bytes;
+
+	for(i = 0; i < stream->rxCount; i++)
+	{
+		endpoint = &stream->rx[i];
+
+		while(1)
+		{
+			space = frameParserSpace(&endpoint->parser, &room);
+			bytes = read(endpoint->fd, space, room);
+
+			if(bytes == -1)
+			{
+				if((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				{
+					break;
+				}
+
+				perror("ERROR read() API");
+				return -1;
+			}
+
+			if(bytes == 0)
+			{
+				printf("Serial Service closed the %s stream.\r\n", stream->type);
+				return -1;
+			}
+
+			now = latencyNow();
+			frameParserCommit(&endpoint->parser, (uint32_t) bytes, now);
+
+			while(frameParserNext(&endpoint->parser, &frame, &length))
+			{
+				streamCheck(stream, endpoint, frame, length, now);
+			}
+		}
+	}
+
+	return 1;
+}
+
+static void streamCheck(stream_t* stream, endpoint_t* endpoint, const char* frame, uint32_t length, uint64_t now)
+{
+	frameFields_t fields;
+	uint32_t seq, channel, lap;
+
+	/* The service's framing answer, or our offer forwarded by a service that keeps text */
+	if(streamFraming(endpoint, frame, length))
+	{
+		return;
+	}
+
+	stream->received++;
+	stream->lastReceived = now;
+
+	if(!frameDecode(frame, length, &fields) || (strcmp(fields.type, stream->type) != 0) || (fields.value < 0))
+	{
+		stream->corrupted++;
+		return;
+	}
+
+	channel = fields.channel + endpoint->channelBase;
+	seq = (uint32_t) fields.value;
+
+	/* Lap modulo 256: the first lap of the channel after the last one received that has this value */
+	if(compact)
+	{
+		if((channel >= channels) || (fields.value > FRAME_COMPACT_VALUE_MAX))
+		{
+			stream->corrupted++;
+			return;
+		}
+
+		lap = (uint32_t) (stream->lastSeen[channel] + 1) / channels;
+		lap += ((uint32_t) fields.value - lap) % (FRAME_COMPACT_VALUE_MAX + 1);
+		seq = (lap * channels) + channel;
+	}
+
+	/* Content: a sequence number we sent and the channel it was sent on (in global numbers) */
+	if((seq >= stream->sent) || (channel != (seq % channels)))
+	{
+		stream->corrupted++;
+		return;
+	}
+
+	/* Order: per channel sequence numbers only grow, gaps are frames dropped or coalesced */
+	if((int32_t) seq <= stream->lastSeen[channel])
+	{
+		stream->reordered++;
+		return;
+	}
+
+	stream->lastSeen[channel] = (int32_t) seq;
+
+	if(seq >= stream->expected)
+	{
+		stream->missing += seq - stream->expected;
+		stream->expected = seq + 1;
+	}
+	else
+	{
+		/* Behind another channel (coalesced commands go out round robin): it was counted as missing */
+		stream->missing--;
+	}
+
+	latencyHistogramRecord(&stream->latency, now - stream->sendTimes[seq]);
+}
+
+static bool streamFraming(endpoint_t* endpoint, const char* frame, uint32_t length)
+{
+	frameFields_t fields;
+
+	if((length < (sizeof(FRAME_COMPACT_OFFER) - 1)) || (strncmp(frame, FRAME_COMPACT_OFFER, sizeof(FRAME_COMPACT_OFFER) - 1) != 0))
+	{
+		return false;
+	}
+
+	/* ">BIN:version,flags" on a controller: the service writes binary from now on, and reads it */
+	if(compact && (endpoint != &interface) && !endpoint->compact && frameDecode(frame, length, &fields) && (fields.channel == FRAME_COMPACT_VERSION))
+	{
+		endpoint->compact = true;
+
+		if(!csv)
+		{
+			printf("Controller of channels %u+: %s framing.\r\n", endpoint->channelBase, (fields.value & FRAME_COMPACT_FLAG_BITMAP) ? "bitmap" : "compact");
+		}
+	}
+
+	return true;
+}
+
+static bool streamDone(stream_t* stream)
+{
+	uint32_t channel;
+
+	if(!stream->enabled)
+	{
+		return true;
+	}
+
+	if((stream->sent < count) || streamPending(stream))
+	{
+		return false;
+	}
+
+	/* The last frame sent isn't enough: coalesced values of other channels may still be on their way */
+	for(channel = 0; channel < channels; channel++)
+	{
+		if(stream->lastSeen[channel] != stream->lastSeq[channel])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void streamReport(stream_t* stream, uint64_t elapsed)
+{
+	uint32_t channel, finalStates = 0;
+	double seconds = (double) elapsed / NANOSECONDS_PER_SECOND;
+
+	if(!stream->enabled)
+	{
+		return;
+	}
+
+	/* The newest value of every channel must always arrive, even if older ones were coalesced */
+	for(channel = 0; channel < channels; channel++)
+	{
+		if(stream->lastSeen[channel] == stream->lastSeq[channel])
+		{
+			finalStates++;
+		}
+	}
+
+	if(csv)
+	{
+		printf("%s,%s,%u,%u,%u,%u,%u,%u,%.0f,%llu,%llu,%llu,%llu\r\n",
+			label, stream->type, stream->sent, stream->received, stream->missing, stream->reordered, stream->corrupted,
+			(finalStates == channels) ? 1 : 0, stream->received / seconds,
+			(unsigned long long) latencyHistogramPercentile(&stream->latency, 50.0),
+			(unsigned long long) latencyHistogramPercentile(&stream->latency, 99.0),
+			(unsigned long long) latencyHistogramPercentile(&stream->latency, 99.9),
+			(unsigned long long) atomic_load(&stream->latency.max));
+		return;
+	}
+
+	printf("%s: sent %u, received %u, missing %u, reordered %u, corrupted %u, final states %u/%u, %.0f frames/s.\r\n",
+		stream->type, stream->sent, stream->received, stream->missing, stream->reordered, stream->corrupted,
+		finalStates, channels, stream->received / seconds);
+	latencyHistogramPrint(&stream->latency);
+}
+
+static void argsParse(int argc, char* argv[])
+{
+	static const struct option longOptions[] =
+	{
+		{"direction",	required_argument,	NULL,	'd'},
+		{"count",	required_argument,	NULL,	'n'},
+		{"rate",	required_argument,	NULL,	'r'},
+		{"burst",	required_argument,	NULL,	'b'},
+		{"channels",	required_argument,	NULL,	'c'},
+		{"timeout",	required_argument,	NULL,	't'},
+		{"label",	required_argument,	NULL,	'l'},
+		{"csv",		no_argument,		NULL,	'C'},
+		{"pty",		required_argument,	NULL,	'P'},
+		{"unix",	required_argument,	NULL,	'u'},
+		{"links",	required_argument,	NULL,	'L'},
+		{"link-channels",	required_argument,	NULL,	'N'},
+		{"framing",	required_argument,	NULL,	'f'},
+		{"help",	no_argument,		NULL,	'h'},
+		{NULL,		0,			NULL,	0}
+	};
+	int option;
+
+	while((option = getopt_long(argc, argv, "d:n:r:b:c:t:l:CP:u:L:N:f:h", longOptions, NULL)) != -1)
+	{
+		switch(option)
+		{
+			case 'd':
+				/* Directions exercised: "sw", "out" or "both" */
+				directions[DIRECTION_SW] = (strcmp(optarg, "sw") == 0) || (strcmp(optarg, "both") == 0);
+				directions[DIRECTION_OUT] = (strcmp(optarg, "out") == 0) || (strcmp(optarg, "both") == 0);
+
+				if(!directions[DIRECTION_SW] && !directions[DIRECTION_OUT])
+				{
+					fprintf(stderr, "ERROR invalid direction: %s.\r\n", optarg);
+					usagePrint(argv[0]);
+					exit(1);
+				}
+				break;
+
+			case 'n':
+				count = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+
+			case 'r':
+				rate = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+
+			case 'b':
+				burst = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+
+			case 'c':
+				channels = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+
+			case 't':
+				drainTimeout = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+
+			case 'l':
+				label = optarg;
+				break;
+
+			case 'C':
+				csv = true;
+				break;
+
+			case 'P':
+				ptyLink = optarg;
+				break;
+
+			case 'u':
+				unixPath = optarg;
+				break;
+
+			case 'L':
+				links = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+
+			case 'N':
+				linkChannels = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+
+			case 'f':
+				/* Controller framing: "text" or "compact" (offered, used once the service answers) */
+				if(strcmp(optarg, "compact") == 0)
+				{
+					compact = true;
+				}
+				else if(strcmp(optarg, "text") != 0)
+				{
+					fprintf(stderr, "ERROR invalid framing: %s.\r\n", optarg);
+					usagePrint(argv[0]);
+					exit(1);
+				}
+				break;
+
+			case 'h':
+				usagePrint(argv[0]);
+				exit(EXIT_SUCCESS);
+
+			default:
+				usagePrint(argv[0]);
+				exit(1);
+		}
+	}
+
+	if((count == 0) || (burst == 0) || (channels == 0))
+	{
+		fprintf(stderr, "ERROR count, burst and channels must be greater than 0.\r\n");
+		exit(1);
+	}
+
+	if((links == 0) || (links > LINKS_MAX) || (linkChannels == 0) || ((links > 1) && (channels > (links * linkChannels))))
+	{
+		fprintf(stderr, "ERROR 1 to %d links, and no more channels than links times link channels.\r\n", LINKS_MAX);
+		exit(1);
+	}
+
+	if((links > 1) && (ptyLink != NULL))
+	{
+		fprintf(stderr, "ERROR --pty plays a single controller.\r\n");
+		exit(1);
+	}
+}
+
+static void usagePrint(const char* program)
+{
+	printf("Usage: %s [options]\r\n", program);
+	printf("  -d, --direction=DIR    sw, out or both (default both)\r\n");
+	printf("  -n, --count=N          frames sent per direction (default %d)\r\n", DEFAULT_COUNT);
+	printf("  -r, --rate=N           frames per second per direction, 0 = as fast as possible (default 0)\r\n");
+	printf("  -b, --burst=N          frames sent back to back at each tick (default 1)\r\n");
+	printf("  -c, --channels=N       channels the frames are spread over (default %d)\r\n", DEFAULT_CHANNELS);
+	printf("  -t, --timeout=MS       wait for late frames once everything is sent (default %d)\r\n", DEFAULT_DRAIN_TIMEOUT_MS);
+	printf("  -l, --label=TEXT       first column of the CSV lines (e.g. a commit id)\r\n");
+	printf("  -C, --csv              print label,type,sent,received,missing,reordered,corrupted,final_ok,fps,p50_ns,p99_ns,p999_ns,max_ns\r\n");
+	printf("  -P, --pty=PATH         be the controller on a pseudo-terminal linked at PATH instead of port %d\r\n", CONTROLLER_EMULATOR_SOCKET_PORT);
+	printf("  -u, --unix=PATH        be the client on the service's unix socket PATH instead of port %d\r\n", INTERFACE_SERVICE_SOCKET_PORT);
+	printf("  -L, --links=N          be N controllers, on ports %d to %d+N-1 (default 1)\r\n", CONTROLLER_EMULATOR_SOCKET_PORT, CONTROLLER_EMULATOR_SOCKET_PORT);
+	printf("  -N, --link-channels=N  global channels per controller, as given to the service (default %d)\r\n", DEFAULT_LINK_CHANNELS);
+	printf("  -f, --framing=F        controller framing: text (default) or compact (offer \">BIN:%d,%d\", binary frames once answered)\r\n", FRAME_COMPACT_VERSION, FRAME_COMPACT_FLAG_BITMAP);
+	printf("  -h, --help             show this help\r\n");
+}
+
+/********************** External Functions Definition ************************/
+int main(int argc, char* argv[])
+{
+	struct pollfd fds[LINKS_MAX + 1];
+	struct timespec timeout;
+	uint64_t start, end, now, idle, wait, due;
+	int listen_fds[LINKS_MAX];
+	bool sending;
+	uint32_t i;
+
+	/* Parse command line options */
+	argsParse(argc, argv);
+
+	/* A closed peer must show up as an error, not kill the benchmark */
+	signal(SIGPIPE, SIG_IGN);
+
+	if((controllers = calloc(links, sizeof(endpoint_t))) == NULL)
+	{
+		perror("ERROR calloc() API");
+		exit(1);
+	}
+
+	/* Both ends of the bridge: every controller listens before the service connects to the first one */
+	if(ptyLink != NULL)
+	{
+		endpointInit(&controllers[0], controllerPty(ptyLink), 0);
+	}
+	else
+	{
+		for(i = 0; i < links; i++)
+		{
+			listen_fds[i] = controllerListen(i);
+		}
+
+		for(i = 0; i < links; i++)
+		{
+			endpointInit(&controllers[i], controllerAccept(listen_fds[i]), i * linkChannels);
+		}
+	}
+
+	/* Compact framing offered from the start of the loop, bitmap frames understood too */
+	for(i = 0; compact && (i < links); i++)
+	{
+		frameParserCompact(&controllers[i].parser, true);
+	}
+
+	endpointInit(&interface, interfaceConnect(), 0);
+
+	streamInit(&streams[DIRECTION_SW], "SW", controllers, links, &interface, 1);
+	streamInit(&streams[DIRECTION_OUT], "OUT", &interface, 1, controllers, links);
+	streams[DIRECTION_SW].enabled = directions[DIRECTION_SW];
+	streams[DIRECTION_OUT].enabled = directions[DIRECTION_OUT];
+
+	/* Let the service register the client before the first frame */
+	usleep(CONNECT_RETRY_DELAY_US);
+
+	if(!csv)
+	{
+		printf("Sending %u frames per direction, %s, burst %u, %u channels.\r\n\n", count, (rate == 0) ? "unlimited rate" : "fixed rate", burst, channels);
+	}
+
+	start = latencyNow();
+	idle = start;
+
+	while(!streamDone(&streams[DIRECTION_SW]) || !streamDone(&streams[DIRECTION_OUT]))
+	{
+		now = latencyNow();
+		wait = NANOSECONDS_PER_SECOND / 100;
+		sending = false;
+
+		for(i = 0; compact && (i < links); i++)
+		{
+			endpointOffer(&controllers[i], now);
+		}
+
+		for(i = 0; i < DIRECTIONS; i++)
+		{
+			if(!streams[i].enabled)
+			{
+				continue;
+			}
+
+			/* Generate and write what is due */
+			streamGenerate(&streams[i], now);
+
+			if(streamSend(&streams[i]) == -1)
+			{
+				exit(1);
+			}
+
+			if((streams[i].sent < count) || streamPending(&streams[i]))
+			{
+				sending = true;
+			}
+
+			/* Sleep until the next burst, or not at all if the buffers can be refilled right away */
+			if((streams[i].sent < count) && !streamPending(&streams[i]))
+			{
+				due = (streams[i].nextBurst > now) ? (streams[i].nextBurst - now) : 0;
+				wait = (due < wait) ? due : wait;
+			}
+		}
+
+		/* Frames come out of the sockets the other direction writes to */
+		fds[0].fd = interface.fd;
+		fds[0].events = POLLIN | ((interface.txOffset < interface.txLength) ? POLLOUT : 0);
+
+		for(i = 0; i < links; i++)
+		{
+			fds[i + 1].fd = controllers[i].fd;
+			fds[i + 1].events = POLLIN | ((controllers[i].txOffset < controllers[i].txLength) ? POLLOUT : 0);
+		}
+
+		timeout.tv_sec = (time_t) (wait / NANOSECONDS_PER_SECOND);
+		timeout.tv_nsec = (long) (wait % NANOSECONDS_PER_SECOND);
+
+		if(ppoll(fds, links + 1, &timeout, NULL) == -1)
+		{
+			perror("ERROR ppoll() API");
+			exit(1);
+		}
+
+		for(i = 0; i < DIRECTIONS; i++)
+		{
+			/* A stream left out still reads its sockets when compact: the framing answer comes on them */
+			if((streams[i].enabled || compact) && (streamReceive(&streams[i]) == -1))
+			{
+				exit(1);
+			}
+
+			if(streams[i].lastReceived > idle)
+			{
+				idle = streams[i].lastReceived;
+			}
+		}
+
+		/* Everything sent: stop once nothing came out for a while (frames dropped or coalesced) */
+		now = latencyNow();
+		if(sending)
+		{
+			idle = now;
+		}
+		else if((now - idle) > ((uint64_t) drainTimeout * 1000000))
+		{
+			break;
+		}
+	}
+
+	/* Throughput counts up to the last frame received */
+	end = streams[DIRECTION_SW].lastReceived;
+	if(streams[DIRECTION_OUT].lastReceived > end)
+	{
+		end = streams[DIRECTION_OUT].lastReceived;
+	}
+	if(end <= start)
+	{
+		end = latencyNow();
+	}
+
+	streamReport(&streams[DIRECTION_SW], end - start);
+	streamReport(&streams[DIRECTION_OUT], end - start);
+
+	streamDeinit(&streams[DIRECTION_SW]);
+	streamDeinit(&streams[DIRECTION_OUT]);
+	close(interface.fd);
+
+	for(i = 0; i < links; i++)
+	{
+		close(controllers[i].fd);
+	}
+
+	free(controllers);
+
+	if(ptyLink != NULL)
+	{
+		unlink(ptyLink);
+	}
+
+	exit(EXIT_SUCCESS);
+	return 0;
+}
+
+/********************** End of File ******************************************/
@@ -0,0 +1 @@
+gcc -O2 -pthread -I../SerialService main.c ../SerialService/Journal.c ../SerialService/FrameParser.c ../SerialService/LatencyHistogram.c -o replay
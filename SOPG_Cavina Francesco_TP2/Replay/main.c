@@ -0,0 +1,676 @@
+/*
+ * @file   : main.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/*
+ * Feeds a journal recorded with "serialService --journal=PATH" back into the
+ * Serial Service. Like the benchmark it plays both ends of the bridge: the
+ * Controller Emulator (listening on port 4040) sends the frames recorded
+ * from the controller and one Interface Service client (port 10000, or
+ * --unix=PATH) sends the frames recorded from every client, in the recorded
+ * order and at the recorded pace scaled by --speed (0 = as fast as
+ * possible). Frames coming out of the other end are matched against what
+ * was sent to report loss, throughput and latency.
+ *
+ * Start the replay first, then the Serial Service. With --dump the journal
+ * is only printed. Records keep the controller link they came from or went
+ * to, but the replay plays a single Controller Emulator: replay a journal of
+ * several links against a service started with one.
+ */
+
+/********************** Inclusions *******************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "Journal.h"
+#include "FrameParser.h"
+#include "LatencyHistogram.h"
+
+/********************** Macros and Definitions *******************************/
+#define CONTROLLER_EMULATOR_SOCKET_IP		("127.0.0.1")
+#define CONTROLLER_EMULATOR_SOCKET_PORT		(4040)
+#define INTERFACE_SERVICE_SOCKET_IP		("127.0.0.1")
+#define INTERFACE_SERVICE_SOCKET_PORT		(10000)
+#define CONNECT_RETRIES				(100)
+#define CONNECT_RETRY_DELAY_US			(100000)
+#define SEND_BUFFER_SIZE			(64 * 1024)
+#define MATCH_WINDOW				(1024)
+#define DEFAULT_DRAIN_TIMEOUT_MS		(2000)
+#define NANOSECONDS_PER_SECOND			(1000000000ULL)
+
+/********************** Internal Data Declaration ****************************/
+/* One direction of the bridge: recorded frames sent on one socket, matched as they come out of the other */
+typedef struct
+{
+	const char* name;
+	int txFd;				// Socket frames are sent on
+	int rxFd;				// Socket frames come out of
+	char txBuffer[SEND_BUFFER_SIZE];
+	uint32_t txLength;			// Bytes queued, not written yet
+	uint32_t txOffset;			// Bytes of txBuffer already written
+	uint32_t* records;			// Indexes (into records[]) of this direction's frames, in order
+	uint64_t* sendTimes;			// When each of them was written (ns)
+	uint32_t count;				// Frames recorded in this direction
+	uint32_t sent;
+	uint32_t matched;			// Next sent frame a received one can match
+	uint32_t received;
+	uint32_t missing;			// Sent frames skipped over by a later match (dropped or coalesced)
+	uint32_t unmatched;			// Received frames that match nothing sent recently
+	uint64_t lastReceived;			// Time the last frame came out (ns)
+	frameParser_t parser;
+	latencyHistogram_t latency;
+} stream_t;
+
+/********************** Internal Functions Declaration ***********************/
+static void argsParse(int argc, char* argv[]);
+static void usagePrint(const char* program);
+static void journalLoad(void);
+static void journalDump(void);
+static int controllerAccept(void);
+static int interfaceConnect(void);
+static void socketNonBlocking(int fd);
+static void streamInit(stream_t* stream, const char* name, journalDirection_t direction, int txFd, int rxFd);
+static bool streamQueue(stream_t* stream, const journalRecord_t* record, uint64_t now);
+static int streamSend(stream_t* stream);
+static int streamReceive(stream_t* stream);
+static void streamMatch(stream_t* stream, const char* frame, uint32_t length, uint64_t now);
+static void streamReport(stream_t* stream, uint64_t elapsed);
+
+/********************** Internal Data Definition *****************************/
+static const char* journalPath = NULL;				// Journal to replay
+static double speed = 1.0;					// Recorded pace multiplier, 0 = as fast as possible
+static bool dump = false;					// Print the journal instead of replaying it
+static const char* unixPath = NULL;				// Client end on the service's unix socket
+static uint32_t drainTimeout = DEFAULT_DRAIN_TIMEOUT_MS;	// Wait for stragglers once everything is sent
+static journal_t* journal = NULL;
+static journalRecord_t* records = NULL;				// Valid records, oldest first
+static uint32_t recordsCount = 0;
+static stream_t streams[2];					// Indexed by journalDirection_t
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+static void journalLoad(void)
+{
+	uint64_t first, end, index;
+	uint32_t torn = 0;
+
+	if((journal = journalOpen(journalPath)) == NULL)
+	{
+		exit(1);
+	}
+
+	/* Copy the ring out, so a service still appending to it can't change what we replay */
+	first = journalFirst(journal);
+	end = journalEnd(journal);
+
+	if((records = calloc((size_t) (end - first) + 1, sizeof(journalRecord_t))) == NULL)
+	{
+		perror("ERROR calloc() API");
+		exit(1);
+	}
+
+	for(index = first; index < end; index++)
+	{
+		if(journalRead(journal, index, &records[recordsCount]))
+		{
+			recordsCount++;
+		}
+		else
+		{
+			torn++;
+		}
+	}
+
+	if(torn > 0)
+	{
+		printf("Journal: %u records skipped (overwritten or being written while reading).\r\n", torn);
+	}
+}
+
+static void journalDump(void)
+{
+	const journalRecord_t* record;
+	time_t wall;
+	char when[32];
+	uint32_t i;
+
+	wall = (time_t) (journal->header->startRealtime / NANOSECONDS_PER_SECOND);
+	strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&wall));
+	printf("# %s: %llu frames written since %s, %u in the ring.\r\n", journalPath, (unsigned long long) journalEnd(journal), when, recordsCount);
+
+	/* Seconds since the journal was created, direction, controller link, frame as received */
+	for(i = 0; i < recordsCount; i++)
+	{
+		record = &records[i];
+		printf("%12.6f %s ", (double) (record->timestamp - journal->header->startMonotonic) / NANOSECONDS_PER_SECOND,
+			(record->direction == JOURNAL_CONTROLLER) ? "C>I" : "I>C");
+		
+		if(record->link == JOURNAL_LINK_NONE)
+		{
+			printf("L- ");
+		}
+		else
+		{
+			printf("L%u ", (unsigned) record->link);
+		}
+		
+		printf("%.*s", (int) record->length, record->data);
+
+		if((record->length == 0) || (record->data[record->length - 1] != '\n'))
+		{
+			printf("\r\n");
+		}
+	}
+}
+
+static int controllerAccept(void)
+{
+	struct sockaddr_in addr;
+	int base_fd, fd, enable = 1;
+
+	/* Listen where the Serial Service looks for the Controller Emulator */
+	if((base_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+	{
+		perror("ERROR socket() API");
+		exit(1);
+	}
+
+	setsockopt(base_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(CONTROLLER_EMULATOR_SOCKET_PORT);
+	inet_pton(AF_INET, CONTROLLER_EMULATOR_SOCKET_IP, &addr.sin_addr);
+
+	if((bind(base_fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) || (listen(base_fd, 1) == -1))
+	{
+		perror("ERROR bind() API");
+		exit(1);
+	}
+
+	printf("Waiting for the Serial Service on port %d...\r\n", CONTROLLER_EMULATOR_SOCKET_PORT);
+
+	if((fd = accept(base_fd, NULL, NULL)) == -1)
+	{
+		perror("ERROR accept() API");
+		exit(1);
+	}
+
+	close(base_fd);
+
+	return fd;
+}
+
+static int interfaceConnect(void)
+{
+	struct sockaddr_storage addr;
+	struct sockaddr_in* inet = (struct sockaddr_in *) &addr;
+	struct sockaddr_un* local = (struct sockaddr_un *) &addr;
+	uint32_t retries;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+
+	if(unixPath != NULL)
+	{
+		local->sun_family = AF_UNIX;
+		snprintf(local->sun_path, sizeof(local->sun_path), "%s", unixPath);
+	}
+	else
+	{
+		inet->sin_family = AF_INET;
+		inet->sin_port = htons(INTERFACE_SERVICE_SOCKET_PORT);
+		inet_pton(AF_INET, INTERFACE_SERVICE_SOCKET_IP, &inet->sin_addr);
+	}
+
+	/* The service opens its listener after connecting to the controller */
+	for(retries = 0; retries < CONNECT_RETRIES; retries++)
+	{
+		if((fd = socket(addr.ss_family, SOCK_STREAM, 0)) == -1)
+		{
+			perror("ERROR socket() API");
+			exit(1);
+		}
+
+		if(connect(fd, (struct sockaddr *) &addr, (unixPath != NULL) ? sizeof(struct sockaddr_un) : sizeof(struct sockaddr_in)) == 0)
+		{
+			return fd;
+		}
+
+		close(fd);
+		usleep(CONNECT_RETRY_DELAY_US);
+	}
+
+	perror("ERROR connect() API");
+	exit(1);
+}
+
+static void socketNonBlocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+
+	if(fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+	{
+		perror("ERROR fcntl() API");
+		exit(1);
+	}
+}
+
+static void streamInit(stream_t* stream, const char* name, journalDirection_t direction, int txFd, int rxFd)
+{
+	uint32_t i;
+
+	memset(stream, 0, sizeof(stream_t));
+
+	stream->name = name;
+	stream->txFd = txFd;
+	stream->rxFd = rxFd;
+	stream->records = calloc(recordsCount + 1, sizeof(uint32_t));
+	stream->sendTimes = calloc(recordsCount + 1, sizeof(uint64_t));
+
+	if((stream->records == NULL) || (stream->sendTimes == NULL))
+	{
+		perror("ERROR calloc() API");
+		exit(1);
+	}
+
+	for(i = 0; i < recordsCount; i++)
+	{
+		if(records[i].direction == direction)
+		{
+			stream->records[stream->count++] = i;
+		}
+	}
+
+	frameParserInit(&stream->parser);
+	latencyHistogramInit(&stream->latency, name);
+}
+
+static bool streamQueue(stream_t* stream, const journalRecord_t* record, uint64_t now)
+{
+	/* No room until the buffer is written: the replay waits, so the recorded order holds */
+	if((stream->txLength + record->length) > SEND_BUFFER_SIZE)
+	{
+		if(stream->txOffset < stream->txLength)
+		{
+			return false;
+		}
+
+		stream->txLength = 0;
+		stream->txOffset = 0;
+	}
+
+	memcpy(&stream->txBuffer[stream->txLength], record->data, record->length);
+	stream->txLength += record->length;
+	stream->sendTimes[stream->sent++] = now;
+
+	return true;
+}
+
+static int streamSend(stream_t* stream)
+{
+	ssize_t bytes;
+
+	while(stream->txOffset < stream->txLength)
+	{
+		bytes = write(stream->txFd, &stream->txBuffer[stream->txOffset], stream->txLength - stream->txOffset);
+
+		if(bytes == -1)
+		{
+			if((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			{
+				return 1;
+			}
+
+			perror("ERROR write() API");
+			return -1;
+		}
+
+		stream->txOffset += (uint32_t) bytes;
+	}
+
+	/* Everything written: start over at the beginning of the buffer */
+	stream->txLength = 0;
+	stream->txOffset = 0;
+
+	return 0;
+}
+
+static int streamReceive(stream_t* stream)
+{
+	const char* frame;
+	uint32_t length, room;
+	uint64_t now;
+	char* space;
+	ssize_t bytes;
+
+	while(1)
+	{
+		space = frameParserSpace(&stream->parser, &room);
+		bytes = read(stream->rxFd, space, room);
+
+		if(bytes == -1)
+		{
+			if((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			{
+				return 1;
+			}
+
+			perror("ERROR read() API");
+			return -1;
+		}
+
+		if(bytes == 0)
+		{
+			printf("Serial Service closed the %s stream.\r\n", stream->name);
+			return -1;
+		}
+
+		now = latencyNow();
+		frameParserCommit(&stream->parser, (uint32_t) bytes, now);
+
+		while(frameParserNext(&stream->parser, &frame, &length))
+		{
+			streamMatch(stream, frame, length, now);
+		}
+	}
+}
+
+static void streamMatch(stream_t* stream, const char* frame, uint32_t length, uint64_t now)
+{
+	const journalRecord_t* record;
+	uint32_t i;
+
+	stream->received++;
+	stream->lastReceived = now;
+
+	/* Frames aren't unique: the first identical one sent after the previous match is this one */
+	for(i = stream->matched; (i < stream->sent) && (i < (stream->matched + MATCH_WINDOW)); i++)
+	{
+		record = &records[stream->records[i]];
+
+		if((record->length == length) && (memcmp(record->data, frame, length) == 0))
+		{
+			stream->missing += i - stream->matched;
+			stream->matched = i + 1;
+			latencyHistogramRecord(&stream->latency, now - stream->sendTimes[i]);
+			return;
+		}
+	}
+
+	stream->unmatched++;
+}
+
+static void streamReport(stream_t* stream, uint64_t elapsed)
+{
+	double seconds = (double) elapsed / NANOSECONDS_PER_SECOND;
+
+	/* Whatever wasn't matched at the end never came out */
+	stream->missing += stream->sent - stream->matched;
+
+	printf("%s: sent %u, received %u, missing %u, unmatched %u, %.0f frames/s.\r\n",
+		stream->name, stream->sent, stream->received, stream->missing, stream->unmatched, (seconds > 0) ? (stream->received / seconds) : 0.0);
+	latencyHistogramPrint(&stream->latency);
+}
+
+static void argsParse(int argc, char* argv[])
+{
+	static const struct option longOptions[] =
+	{
+		{"journal",	required_argument,	NULL,	'j'},
+		{"speed",	required_argument,	NULL,	's'},
+		{"dump",	no_argument,		NULL,	'd'},
+		{"unix",	required_argument,	NULL,	'u'},
+		{"timeout",	required_argument,	NULL,	't'},
+		{"help",	no_argument,		NULL,	'h'},
+		{NULL,		0,			NULL,	0}
+	};
+	int option;
+
+	while((option = getopt_long(argc, argv, "j:s:du:t:h", longOptions, NULL)) != -1)
+	{
+		switch(option)
+		{
+			case 'j':
+				journalPath = optarg;
+				break;
+
+			case 's':
+				/* "max" reads better than 0 on the command line */
+				speed = (strcmp(optarg, "max") == 0) ? 0.0 : strtod(optarg, NULL);
+
+				if(speed < 0.0)
+				{
+					fprintf(stderr, "ERROR invalid speed: %s.\r\n", optarg);
+					exit(1);
+				}
+				break;
+
+			case 'd':
+				dump = true;
+				break;
+
+			case 'u':
+				unixPath = optarg;
+				break;
+
+			case 't':
+				drainTimeout = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+
+			case 'h':
+				usagePrint(argv[0]);
+				exit(EXIT_SUCCESS);
+
+			default:
+				usagePrint(argv[0]);
+				exit(1);
+		}
+	}
+
+	if(journalPath == NULL)
+	{
+		fprintf(stderr, "ERROR no journal given.\r\n");
+		usagePrint(argv[0]);
+		exit(1);
+	}
+}
+
+static void usagePrint(const char* program)
+{
+	printf("Usage: %s --journal=PATH [options]\r\n", program);
+	printf("  -j, --journal=PATH     journal written by serialService --journal\r\n");
+	printf("  -s, --speed=X          1 = recorded pace, N = N times faster, 0 or max = as fast as possible (default 1)\r\n");
+	printf("  -d, --dump             print the journal and exit\r\n");
+	printf("  -u, --unix=PATH        be the client on the service's unix socket PATH instead of port %d\r\n", INTERFACE_SERVICE_SOCKET_PORT);
+	printf("  -t, --timeout=MS       wait for late frames once everything is sent (default %d)\r\n", DEFAULT_DRAIN_TIMEOUT_MS);
+	printf("  -h, --help             show this help\r\n");
+}
+
+/********************** External Functions Definition ************************/
+int main(int argc, char* argv[])
+{
+	struct pollfd fds[2];
+	struct timespec timeout;
+	const journalRecord_t* record;
+	uint64_t start, end, now, idle, wait, due, paced;
+	int controller_fd, interface_fd;
+	stream_t* stream;
+	uint32_t next = 0, i;
+	bool blocked;
+
+	/* Parse command line options */
+	argsParse(argc, argv);
+
+	journalLoad();
+
+	if(dump)
+	{
+		journalDump();
+		journalClose(journal);
+		exit(EXIT_SUCCESS);
+	}
+
+	if(recordsCount == 0)
+	{
+		printf("Journal %s is empty.\r\n", journalPath);
+		exit(EXIT_SUCCESS);
+	}
+
+	/* A closed peer must show up as an error, not kill the replay */
+	signal(SIGPIPE, SIG_IGN);
+
+	/* Both ends of the bridge */
+	controller_fd = controllerAccept();
+	interface_fd = interfaceConnect();
+	socketNonBlocking(controller_fd);
+	socketNonBlocking(interface_fd);
+
+	streamInit(&streams[JOURNAL_CONTROLLER], "Controller Emulator -> Interface Service", JOURNAL_CONTROLLER, controller_fd, interface_fd);
+	streamInit(&streams[JOURNAL_INTERFACE], "Interface Service -> Controller Emulator", JOURNAL_INTERFACE, interface_fd, controller_fd);
+
+	/* Let the service register the client before the first frame */
+	usleep(CONNECT_RETRY_DELAY_US);
+
+	if(speed == 0.0)
+	{
+		printf("Replaying %u frames (%u + %u) at full speed.\r\n\n", recordsCount, streams[JOURNAL_CONTROLLER].count, streams[JOURNAL_INTERFACE].count);
+	}
+	else
+	{
+		printf("Replaying %u frames (%u + %u) at %gx the recorded pace.\r\n\n", recordsCount, streams[JOURNAL_CONTROLLER].count, streams[JOURNAL_INTERFACE].count, speed);
+	}
+
+	start = latencyNow();
+	idle = start;
+	paced = records[0].timestamp;
+
+	while(true)
+	{
+		now = latencyNow();
+		wait = NANOSECONDS_PER_SECOND / 100;
+		blocked = false;
+
+		/* Queue every frame that is due, in recorded order across both directions */
+		while(next < recordsCount)
+		{
+			record = &records[next];
+
+			/* Several rx threads append concurrently, so a record can be stamped before the one ahead of it: never go back in time */
+			if(record->timestamp > paced)
+			{
+				paced = record->timestamp;
+			}
+
+			due = (speed == 0.0) ? 0 : (start + (uint64_t) ((double) (paced - records[0].timestamp) / speed));
+
+			if(due > now)
+			{
+				wait = ((due - now) < wait) ? (due - now) : wait;
+				break;
+			}
+
+			if(!streamQueue(&streams[record->direction], record, now))
+			{
+				blocked = true;
+				break;
+			}
+
+			next++;
+		}
+
+		for(i = 0; i < 2; i++)
+		{
+			if(streamSend(&streams[i]) == -1)
+			{
+				exit(1);
+			}
+		}
+
+		/* Frames come out of the socket the other direction writes to */
+		stream = &streams[JOURNAL_INTERFACE];
+		fds[0].fd = interface_fd;
+		fds[0].events = POLLIN | ((stream->txOffset < stream->txLength) ? POLLOUT : 0);
+		stream = &streams[JOURNAL_CONTROLLER];
+		fds[1].fd = controller_fd;
+		fds[1].events = POLLIN | ((stream->txOffset < stream->txLength) ? POLLOUT : 0);
+
+		/* Full speed: only wait when a socket is full */
+		if((speed == 0.0) && (next < recordsCount) && !blocked)
+		{
+			wait = 0;
+		}
+
+		timeout.tv_sec = (time_t) (wait / NANOSECONDS_PER_SECOND);
+		timeout.tv_nsec = (long) (wait % NANOSECONDS_PER_SECOND);
+
+		if(ppoll(fds, 2, &timeout, NULL) == -1)
+		{
+			perror("ERROR ppoll() API");
+			exit(1);
+		}
+
+		for(i = 0; i < 2; i++)
+		{
+			if(streamReceive(&streams[i]) == -1)
+			{
+				exit(1);
+			}
+
+			if(streams[i].lastReceived > idle)
+			{
+				idle = streams[i].lastReceived;
+			}
+		}
+
+		/* Everything sent: stop once everything matched or nothing came out for a while */
+		now = latencyNow();
+		if((next < recordsCount) || (streams[0].txLength > 0) || (streams[1].txLength > 0))
+		{
+			idle = now;
+		}
+		else if(((streams[0].matched == streams[0].count) && (streams[1].matched == streams[1].count)) || ((now - idle) > ((uint64_t) drainTimeout * 1000000)))
+		{
+			break;
+		}
+	}
+
+	/* Throughput counts up to the last frame received */
+	end = (streams[0].lastReceived > streams[1].lastReceived) ? streams[0].lastReceived : streams[1].lastReceived;
+	if(end <= start)
+	{
+		end = latencyNow();
+	}
+
+	printf("Replayed in %.3f s (recorded: %.3f s).\r\n", (double) (end - start) / NANOSECONDS_PER_SECOND, (double) (paced - records[0].timestamp) / NANOSECONDS_PER_SECOND);
+	streamReport(&streams[JOURNAL_CONTROLLER], end - start);
+	streamReport(&streams[JOURNAL_INTERFACE], end - start);
+
+	close(interface_fd);
+	close(controller_fd);
+	journalClose(journal);
+
+	exit(EXIT_SUCCESS);
+	return 0;
+}
+
+/********************** End of File ******************************************/
@@ -0,0 +1,238 @@
+/*
+ * @file   : Coalescer.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Coalescer.h"
+
+/********************** Macros and Definitions *******************************/
+#define BITMAP_WORD_BITS			(64)
+
+/********************** Internal Data Declaration ****************************/
+
+/********************** Internal Functions Declaration ***********************/
+
+/********************** Internal Data Definition *****************************/
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+
+/********************** External Functions Definition ************************/
+int coalescerInit(coalescer_t* coalescer, const char* type, uint32_t channels)
+{
+	uint32_t words = (channels + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+
+	snprintf(coalescer->type, sizeof(coalescer->type), "%s", type);
+	coalescer->channels = channels;
+	coalescer->values = calloc(channels, sizeof(int32_t));
+	coalescer->timestamps = calloc(channels, sizeof(uint64_t));
+	coalescer->dirty = calloc(words, sizeof(uint64_t));
+	coalescer->written = calloc(channels, sizeof(int32_t));
+	coalescer->known = calloc(words, sizeof(uint64_t));
+	coalescer->pending = 0;
+	coalescer->cursor = 0;
+	coalescer->saved = 0;
+
+	if((coalescer->values == NULL) || (coalescer->timestamps == NULL) || (coalescer->dirty == NULL) || (coalescer->written == NULL) || (coalescer->known == NULL))
+	{
+		perror("ERROR calloc() API");
+		return -1;
+	}
+
+	return 0;
+}
+
+void coalescerDeinit(coalescer_t* coalescer)
+{
+	free(coalescer->values);
+	free(coalescer->timestamps);
+	free(coalescer->dirty);
+	free(coalescer->written);
+	free(coalescer->known);
+	coalescer->values = NULL;
+	coalescer->timestamps = NULL;
+	coalescer->dirty = NULL;
+	coalescer->written = NULL;
+	coalescer->known = NULL;
+}
+
+void coalescerReset(coalescer_t* coalescer)
+{
+	uint32_t words = (coalescer->channels + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+
+	/* Forget pending and written values, the destination starts from scratch */
+	memset(coalescer->dirty, 0, words * sizeof(uint64_t));
+	memset(coalescer->known, 0, words * sizeof(uint64_t));
+	coalescer->pending = 0;
+	coalescer->cursor = 0;
+	coalescer->saved = 0;
+}
+
+bool coalescerPut(coalescer_t* coalescer, const frame_t* frame)
+{
+	frameFields_t fields;
+	uint64_t bit;
+	uint64_t* word;
+
+	/* Only frames of our type with a known channel can be coalesced, a sequenced command waits for its own ACK */
+	if(!frameDecode(frame->data, frame->length, &fields) || fields.sequenced || (strcmp(fields.type, coalescer->type) != 0) || (fields.channel >= coalescer->channels))
+	{
+		return false;
+	}
+
+	word = &coalescer->dirty[fields.channel / BITMAP_WORD_BITS];
+	bit = 1ULL << (fields.channel % BITMAP_WORD_BITS);
+
+	if(*word & bit)
+	{
+		/* Newer value replaces the pending one: one write less */
+		coalescer->saved++;
+	}
+	else
+	{
+		/* Latency counts from the first command the write stands for */
+		*word |= bit;
+		coalescer->pending++;
+		coalescer->timestamps[fields.channel] = frame->timestamp;
+	}
+
+	coalescer->values[fields.channel] = fields.value;
+
+	return true;
+}
+
+bool coalescerTake(coalescer_t* coalescer, frame_t* frame)
+{
+	uint32_t channel, words, w, i;
+	uint64_t bits;
+
+	if(coalescer->pending == 0)
+	{
+		return false;
+	}
+
+	words = (coalescer->channels + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+
+	/* Scan the bitmap from the cursor so every channel gets its turn */
+	for(i = 0; i <= words; i++)
+	{
+		w = ((coalescer->cursor / BITMAP_WORD_BITS) + i) % words;
+		bits = coalescer->dirty[w];
+
+		if((i == 0) && ((coalescer->cursor % BITMAP_WORD_BITS) != 0))
+		{
+			bits &= ~0ULL << (coalescer->cursor % BITMAP_WORD_BITS);
+		}
+
+		if(bits != 0)
+		{
+			channel = (w * BITMAP_WORD_BITS) + (uint32_t) __builtin_ctzll(bits);
+
+			coalescer->dirty[w] &= ~(1ULL << (channel % BITMAP_WORD_BITS));
+			coalescer->pending--;
+			coalescer->cursor = (channel + 1) % coalescer->channels;
+
+			frame->length = frameEncode(frame->data, coalescer->type, channel, coalescer->values[channel]);
+			frame->timestamp = coalescer->timestamps[channel];
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool coalescerTakeChannel(coalescer_t* coalescer, uint32_t channel, frame_t* frame)
+{
+	uint64_t bit = 1ULL << (channel % BITMAP_WORD_BITS);
+
+	/* One given channel, out of turn (e.g. batched with its neighbours) */
+	if((channel >= coalescer->channels) || ((coalescer->dirty[channel / BITMAP_WORD_BITS] & bit) == 0))
+	{
+		return false;
+	}
+
+	coalescer->dirty[channel / BITMAP_WORD_BITS] &= ~bit;
+	coalescer->pending--;
+
+	frame->length = frameEncode(frame->data, coalescer->type, channel, coalescer->values[channel]);
+	frame->timestamp = coalescer->timestamps[channel];
+
+	return true;
+}
+
+void coalescerRemember(coalescer_t* coalescer, const frame_t* frame)
+{
+	frameFields_t fields;
+
+	if(!frameDecode(frame->data, frame->length, &fields) || (strcmp(fields.type, coalescer->type) != 0) || (fields.channel >= coalescer->channels))
+	{
+		return;
+	}
+
+	coalescer->written[fields.channel] = fields.value;
+	coalescer->known[fields.channel / BITMAP_WORD_BITS] |= 1ULL << (fields.channel % BITMAP_WORD_BITS);
+}
+
+uint32_t coalescerReplay(coalescer_t* coalescer, uint64_t timestamp)
+{
+	uint32_t w, words, channel, replayed = 0;
+	uint64_t bits;
+
+	words = (coalescer->channels + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+
+	/* Queue the last written value of every channel that has no newer one pending */
+	for(w = 0; w < words; w++)
+	{
+		bits = coalescer->known[w] & ~coalescer->dirty[w];
+
+		while(bits != 0)
+		{
+			channel = (w * BITMAP_WORD_BITS) + (uint32_t) __builtin_ctzll(bits);
+			bits &= bits - 1;
+
+			coalescer->values[channel] = coalescer->written[channel];
+			coalescer->timestamps[channel] = timestamp;
+			coalescer->dirty[w] |= 1ULL << (channel % BITMAP_WORD_BITS);
+			coalescer->pending++;
+			replayed++;
+		}
+	}
+
+	return replayed;
+}
+
+uint32_t coalescerDump(const coalescer_t* coalescer, bool written, frame_t* frames, uint32_t max)
+{
+	uint32_t w, words, channel, count = 0;
+	uint64_t bits;
+
+	words = (coalescer->channels + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+
+	/* Pending (or last written) values as frames, without touching the table */
+	for(w = 0; (w < words) && (count < max); w++)
+	{
+		bits = written ? coalescer->known[w] : coalescer->dirty[w];
+
+		while((bits != 0) && (count < max))
+		{
+			channel = (w * BITMAP_WORD_BITS) + (uint32_t) __builtin_ctzll(bits);
+			bits &= bits - 1;
+
+			frames[count].length = frameEncode(frames[count].data, coalescer->type, channel, written ? coalescer->written[channel] : coalescer->values[channel]);
+			frames[count].timestamp = written ? 0 : coalescer->timestamps[channel];
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/********************** End of File ******************************************/
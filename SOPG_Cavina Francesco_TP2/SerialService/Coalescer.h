@@ -0,0 +1,58 @@
+/*
+ * @file   : Coalescer.h
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+#ifndef COALESCER_H
+#define COALESCER_H
+
+/********************** Inclusions *******************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FrameQueue.h"
+#include "FrameParser.h"
+
+/********************** Macros ***********************************************/
+#define COALESCER_DEFAULT_CHANNELS		(64)
+
+/********************** Typedef **********************************************/
+/*
+ * Latest-value-wins table of ">TYPE:channel,value" commands. Only the
+ * newest value of each channel is kept while the destination is backed up,
+ * so a burst of toggles on one channel costs a single write. The last value
+ * written to each channel is remembered too, so the whole state can be
+ * replayed to a destination that lost it. Owned by one thread (the
+ * destination's writer), no locking.
+ */
+typedef struct
+{
+	char type[FRAME_TYPE_SIZE];		// Frame type coalesced (e.g. "OUT")
+	uint32_t channels;
+	int32_t* values;			// Newest pending value per channel
+	uint64_t* timestamps;			// When each channel's oldest pending command was received
+	uint64_t* dirty;			// Bitmap of channels with a pending value
+	int32_t* written;			// Last value written per channel
+	uint64_t* known;			// Bitmap of channels written at least once
+	uint32_t pending;			// Channels with a pending value
+	uint32_t cursor;			// Next channel to emit (round robin)
+	uint64_t saved;				// Writes avoided by overwriting a pending value
+} coalescer_t;
+
+/********************** External Data Declaration ****************************/
+
+/********************** External Functions Declaration ***********************/
+int coalescerInit(coalescer_t* coalescer, const char* type, uint32_t channels);
+void coalescerDeinit(coalescer_t* coalescer);
+void coalescerReset(coalescer_t* coalescer);
+bool coalescerPut(coalescer_t* coalescer, const frame_t* frame);
+bool coalescerTake(coalescer_t* coalescer, frame_t* frame);
+bool coalescerTakeChannel(coalescer_t* coalescer, uint32_t channel, frame_t* frame);
+void coalescerRemember(coalescer_t* coalescer, const frame_t* frame);
+uint32_t coalescerReplay(coalescer_t* coalescer, uint64_t timestamp);
+uint32_t coalescerDump(const coalescer_t* coalescer, bool written, frame_t* frames, uint32_t max);
+
+#endif /* COALESCER_H */
+
+/********************** End of File ******************************************/
@@ -0,0 +1,114 @@
+/*
+ * @file   : ControllerLinks.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ControllerLinks.h"
+#include "Router.h"
+
+/********************** Macros and Definitions *******************************/
+
+/********************** Internal Data Declaration ****************************/
+
+/********************** Internal Functions Declaration ***********************/
+
+/********************** Internal Data Definition *****************************/
+static controllerLink_t* links = NULL;
+static uint32_t count = 0;
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+
+/********************** External Functions Definition ************************/
+int linksInit(uint32_t linksCount, uint32_t queueDepth, uint32_t ackWindow)
+{
+	uint32_t i, channels;
+
+	if((linksCount == 0) || (linksCount > LINKS_MAX))
+	{
+		fprintf(stderr, "ERROR between 1 and %d controller links.\r\n", LINKS_MAX);
+		return -1;
+	}
+
+	/* Cache line aligned: counters and queue ends of neighbouring links never share a line */
+	if((links = aligned_alloc(CACHE_LINE_SIZE, linksCount * sizeof(controllerLink_t))) == NULL)
+	{
+		perror("ERROR aligned_alloc() API");
+		return -1;
+	}
+
+	memset(links, 0, linksCount * sizeof(controllerLink_t));
+	count = linksCount;
+
+	for(i = 0; i < count; i++)
+	{
+		links[i].index = i;
+		links[i].fd = -1;
+		links[i].shard = LINK_SHARD_NONE;
+		links[i].framing = LINK_FRAMING_TEXT;
+		atomic_init(&links[i].framingOffer, LINK_FRAMING_NONE);
+		serial_init(&links[i].serial);
+		frameParserInit(&links[i].parser);
+
+		/* Output commands coalesced while the link is backed up, in the controller's own channels */
+		channels = routerLinkChannels(i);
+		channels = (channels > COALESCER_DEFAULT_CHANNELS) ? channels : COALESCER_DEFAULT_CHANNELS;
+
+		if((frameQueueInit(&links[i].rxQueue, queueDepth) != 0) || (frameQueueInit(&links[i].txQueue, queueDepth) != 0) || (coalescerInit(&links[i].coalescer, "OUT", channels) != 0))
+		{
+			return -1;
+		}
+
+		if(pthread_mutex_init(&links[i].mutex, NULL) != 0)
+		{
+			perror("ERROR pthread_mutex_init() API");
+			return -1;
+		}
+
+		/* Sequence numbers are only tracked when asked for, they pass through untouched otherwise */
+		if((ackWindow > 0) && (inflightInit(&links[i].inflight, ackWindow) != 0))
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void linksDeinit(void)
+{
+	uint32_t i;
+
+	for(i = 0; i < count; i++)
+	{
+		serial_close(&links[i].serial);
+		frameQueueDeinit(&links[i].rxQueue);
+		frameQueueDeinit(&links[i].txQueue);
+		coalescerDeinit(&links[i].coalescer);
+		inflightDeinit(&links[i].inflight);
+		pthread_mutex_destroy(&links[i].mutex);
+	}
+
+	free(links);
+	links = NULL;
+	count = 0;
+}
+
+controllerLink_t* linksGet(uint32_t index)
+{
+	return &links[index];
+}
+
+uint32_t linksCount(void)
+{
+	return count;
+}
+
+/********************** End of File ******************************************/
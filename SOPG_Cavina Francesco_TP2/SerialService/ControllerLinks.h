@@ -0,0 +1,87 @@
+/*
+ * @file   : ControllerLinks.h
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+#ifndef CONTROLLER_LINKS_H
+#define CONTROLLER_LINKS_H
+
+/********************** Inclusions *******************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "SerialManager.h"
+#include "FrameQueue.h"
+#include "FrameParser.h"
+#include "Coalescer.h"
+#include "Inflight.h"
+#include "LatencyHistogram.h"
+#include "Metrics.h"
+
+/********************** Macros ***********************************************/
+#define LINKS_MAX				(64)
+#define LINK_SHARD_NONE				(UINT32_MAX)
+#define LINK_FRAMING_NONE			(-1)
+
+/********************** Typedef **********************************************/
+/* How commands are written to a controller, agreed when it offers ">BIN" */
+typedef enum
+{
+	LINK_FRAMING_TEXT = 0,			// ">OUT:n,v\r\n"
+	LINK_FRAMING_COMPACT = 1,		// Fixed binary frames with a CRC-8 (see FrameParser.h)
+	LINK_FRAMING_BITMAP = 2			// Also on/off outputs of up to 16 neighbouring channels in one frame
+} linkFraming_t;
+
+/*
+ * One Controller Emulator connection. Each link has its own queue per
+ * direction, so the thread serving it (the event loop, or its shard with
+ * --shards) never shares a queue end or a counter with another link.
+ * rxQueue holds frames already renumbered to global channels, txQueue
+ * commands already renumbered to the link's local ones (see Router.h).
+ */
+typedef struct
+{
+	uint32_t index;
+	serial_t serial;			// Descriptor and reconnection state
+	frameQueue_t rxQueue;			// Controller Emulator -> Interface Service
+	frameQueue_t txQueue;			// Interface Service -> Controller Emulator
+	frameParser_t parser;			// Frames from the controller
+	coalescer_t coalescer;			// Latest-value-wins commands to the controller
+	inflight_t inflight;			// Sequenced commands waiting for the controller's ACK (clients side, --ack-window)
+	frame_t txFrame;			// Command being written to the controller
+	frame_t txBatch[FRAME_COMPACT_BITMAP_CHANNELS - 1];	// Commands sharing txFrame's bitmap frame
+	uint32_t txBatchCount;
+	char txWire[FRAME_MAX_SIZE];		// txFrame (and txBatch) in compact framing
+	uint32_t txWireLength;			// 0: txFrame is written as text
+	uint32_t txOffset;			// Bytes of txFrame or txWire already written
+	linkFraming_t framing;			// Framing of the commands written from now on
+	bool blocked;				// Link would block
+	int fd;					// Descriptor registered in epoll
+	uint32_t events;			// epoll events registered for fd (epoll mode)
+	uint32_t shard;				// Thread serving the link, LINK_SHARD_NONE: the event loop
+	latencyHistogram_t* latency;		// Interface Service -> Controller Emulator hop, one per serving thread
+	pthread_mutex_t mutex;			// Writer state: the link's writer vs. link drops and drop-oldest
+	metricsDirection_t right;		// Counters: frames received from the controller
+	metricsDirection_t left;		// Counters: commands written to the controller
+	_Alignas(CACHE_LINE_SIZE) _Atomic uint32_t up;	// For the metrics thread
+	_Atomic uint64_t losses;
+	_Atomic uint64_t reconnects;
+	_Atomic bool rxWaiting;			// Reader stopped on a full rxQueue, the event loop kicks its shard
+	_Atomic bool txWaiting;			// A client stopped on a full txQueue, the shard kicks the event loop
+	_Atomic int32_t framingOffer;		// Framing agreed on the controller's ">BIN" offer, for the writer to answer (LINK_FRAMING_NONE: none)
+} controllerLink_t;
+
+/********************** External Data Declaration ****************************/
+
+/********************** External Functions Declaration ***********************/
+int linksInit(uint32_t count, uint32_t queueDepth, uint32_t ackWindow);
+void linksDeinit(void);
+controllerLink_t* linksGet(uint32_t index);
+uint32_t linksCount(void);
+
+#endif /* CONTROLLER_LINKS_H */
+
+/********************** End of File ******************************************/
@@ -0,0 +1,392 @@
+/*
+ * @file   : FrameParser.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "FrameParser.h"
+
+/********************** Macros and Definitions *******************************/
+#define FRAME_COMPACT_CRC_POLYNOMIAL		(0x07)
+
+/********************** Internal Data Declaration ****************************/
+
+/********************** Internal Functions Declaration ***********************/
+static void frameParserResync(frameParser_t* parser, uint32_t from);
+static int frameParserCompactNext(frameParser_t* parser, const char** frame, uint32_t* length);
+static bool frameCompactHeader(char byte);
+static uint8_t frameCompactCrc(const uint8_t* data, uint32_t length);
+static bool frameDecodeNumber(const char** p, const char* end, uint32_t max, uint32_t* number);
+
+/********************** Internal Data Definition *****************************/
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+static void frameParserResync(frameParser_t* parser, uint32_t from)
+{
+	char* next;
+
+	/* Compact frames start with a header byte instead */
+	if(parser->compact)
+	{
+		while((from < parser->end) && (parser->buffer[from] != FRAME_START_CHAR) && !frameCompactHeader(parser->buffer[from]))
+		{
+			from++;
+		}
+
+		parser->start = from;
+		return;
+	}
+
+	/* Skip everything up to the next frame start */
+	next = memchr(&parser->buffer[from], FRAME_START_CHAR, parser->end - from);
+	parser->start = (next != NULL) ? (uint32_t) (next - parser->buffer) : parser->end;
+}
+
+static int frameParserCompactNext(frameParser_t* parser, const char** frame, uint32_t* length)
+{
+	const uint8_t* wire = (const uint8_t*) &parser->buffer[parser->start];
+	uint32_t size, bit;
+
+	/* Next channel of the bitmap frame being expanded */
+	if(parser->bitmapPresent != 0)
+	{
+		bit = (uint32_t) __builtin_ctz(parser->bitmapPresent);
+		parser->bitmapPresent &= (uint16_t) (parser->bitmapPresent - 1);
+		*length = frameEncode(parser->text, (parser->bitmapHeader & FRAME_COMPACT_OUTPUT) ? "OUT" : "SW", parser->bitmapBase + bit, (parser->bitmapValues >> bit) & 1);
+		*frame = parser->text;
+		return 1;
+	}
+
+	size = (wire[0] & FRAME_COMPACT_BITMAP) ? FRAME_COMPACT_BITMAP_SIZE : FRAME_COMPACT_SINGLE_SIZE;
+
+	if((parser->end - parser->start) < size)
+	{
+		/* Partial frame: wait for more bytes */
+		return 0;
+	}
+
+	/* Corrupted, or not a header after all: look for a frame from the next byte on */
+	if(frameCompactCrc(wire, size - 1) != wire[size - 1])
+	{
+		parser->errors++;
+		frameParserResync(parser, parser->start + 1);
+		return -1;
+	}
+
+	parser->start += size;
+
+	if(wire[0] & FRAME_COMPACT_BITMAP)
+	{
+		parser->bitmapHeader = wire[0];
+		parser->bitmapBase = wire[1];
+		parser->bitmapPresent = (uint16_t) (wire[2] | (wire[3] << 8));
+		parser->bitmapValues = (uint16_t) (wire[4] | (wire[5] << 8));
+		return -1;
+	}
+
+	*length = frameEncode(parser->text, (wire[0] & FRAME_COMPACT_OUTPUT) ? "OUT" : "SW", wire[1], wire[2]);
+	*frame = parser->text;
+
+	return 1;
+}
+
+static bool frameCompactHeader(char byte)
+{
+	/* Text frames are 7-bit ASCII, headers have the top bit set */
+	return (((uint8_t) byte) & FRAME_COMPACT_HEADER_MASK) == FRAME_COMPACT_HEADER;
+}
+
+static uint8_t frameCompactCrc(const uint8_t* data, uint32_t length)
+{
+	uint8_t crc = 0;
+	uint32_t i, bit;
+
+	/* CRC-8, polynomial x^8 + x^2 + x + 1: a handful of bytes, no table needed */
+	for(i = 0; i < length; i++)
+	{
+		crc ^= data[i];
+
+		for(bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x80) ? (uint8_t) ((crc << 1) ^ FRAME_COMPACT_CRC_POLYNOMIAL) : (uint8_t) (crc << 1);
+		}
+	}
+
+	return crc;
+}
+
+static bool frameDecodeNumber(const char** p, const char* end, uint32_t max, uint32_t* number)
+{
+	uint32_t digit;
+
+	*number = 0;
+
+	/* Digits up to the first other byte. Past max the frame is malformed: a wrapped channel would go to another link or client */
+	while((*p < end) && (**p >= '0') && (**p <= '9'))
+	{
+		digit = (uint32_t) (**p - '0');
+
+		if(*number > ((max - digit) / 10))
+		{
+			return false;
+		}
+
+		*number = (*number * 10) + digit;
+		(*p)++;
+	}
+
+	return true;
+}
+
+/********************** External Functions Definition ************************/
+void frameParserInit(frameParser_t* parser)
+{
+	parser->start = 0;
+	parser->end = 0;
+	parser->errors = 0;
+	parser->timestamp = 0;
+	parser->compact = false;
+	parser->bitmapPresent = 0;
+}
+
+void frameParserReset(frameParser_t* parser)
+{
+	/* Drop buffered bytes (new stream), keep the counters */
+	parser->start = 0;
+	parser->end = 0;
+	parser->bitmapPresent = 0;
+}
+
+char* frameParserSpace(frameParser_t* parser, uint32_t* room)
+{
+	uint32_t pending = parser->end - parser->start;
+
+	/* Move the partial frame (at most FRAME_MAX_SIZE bytes) back to the beginning */
+	if(parser->start > 0)
+	{
+		memmove(parser->buffer, &parser->buffer[parser->start], pending);
+		parser->start = 0;
+		parser->end = pending;
+	}
+
+	*room = FRAME_PARSER_BUFFER_SIZE - parser->end;
+
+	return &parser->buffer[parser->end];
+}
+
+void frameParserCommit(frameParser_t* parser, uint32_t bytes, uint64_t timestamp)
+{
+	parser->end += bytes;
+	parser->timestamp = timestamp;
+}
+
+bool frameParserNext(frameParser_t* parser, const char** frame, uint32_t* length)
+{
+	uint32_t pending, window;
+	char* terminator;
+	int result;
+
+	while((parser->start < parser->end) || (parser->bitmapPresent != 0))
+	{
+		/* Compact frame, or the rest of a bitmap one: returned as text */
+		if((parser->bitmapPresent != 0) || (parser->compact && frameCompactHeader(parser->buffer[parser->start])))
+		{
+			if((result = frameParserCompactNext(parser, frame, length)) >= 0)
+			{
+				return (result == 1);
+			}
+			continue;
+		}
+
+		/* Data before a frame start is garbage */
+		if(parser->buffer[parser->start] != FRAME_START_CHAR)
+		{
+			parser->errors++;
+			frameParserResync(parser, parser->start);
+			continue;
+		}
+
+		pending = parser->end - parser->start;
+		window = (pending < FRAME_MAX_SIZE) ? pending : FRAME_MAX_SIZE;
+		terminator = memchr(&parser->buffer[parser->start], FRAME_END_CHAR, window);
+
+		if(terminator != NULL)
+		{
+			/* Complete frame, terminator included */
+			*frame = &parser->buffer[parser->start];
+			*length = (uint32_t) (terminator - *frame) + 1;
+			parser->start += *length;
+			return true;
+		}
+
+		if(pending < FRAME_MAX_SIZE)
+		{
+			/* Partial frame: wait for more bytes */
+			return false;
+		}
+
+		/* No terminator within the maximum frame size: drop it */
+		parser->errors++;
+		frameParserResync(parser, parser->start + 1);
+	}
+
+	return false;
+}
+
+void frameParserReject(frameParser_t* parser)
+{
+	/* The caller found the frame just returned malformed (e.g. a number out of range): counted like the ones the parser drops */
+	parser->errors++;
+}
+
+void frameParserUnget(frameParser_t* parser, uint32_t length)
+{
+	/* Only right after frameParserNext() returned a text frame: it is still in the buffer, parse it again later */
+	parser->start -= length;
+}
+
+void frameParserCompact(frameParser_t* parser, bool compact)
+{
+	parser->compact = compact;
+}
+
+bool frameDecode(const char* frame, uint32_t length, frameFields_t* fields)
+{
+	const char* end = frame + length;
+	const char* p = frame + 1;
+	uint32_t typeLength = 0;
+	uint32_t channel, value;
+
+	if((length < 2) || (frame[0] != FRAME_START_CHAR))
+	{
+		return false;
+	}
+
+	/* TYPE up to ':' */
+	while((p < end) && (*p != ':'))
+	{
+		if(typeLength >= (FRAME_TYPE_SIZE - 1))
+		{
+			return false;
+		}
+		fields->type[typeLength++] = *p++;
+	}
+	fields->type[typeLength] = '\0';
+
+	if((typeLength == 0) || (p++ >= end) || (p >= end) || (*p < '0') || (*p > '9'))
+	{
+		return false;
+	}
+
+	/* Channel up to ',' */
+	if(!frameDecodeNumber(&p, end, UINT32_MAX, &channel) || (p >= end) || (*p++ != ',') || (p >= end) || (*p < '0') || (*p > '9'))
+	{
+		return false;
+	}
+
+	/* Value up to ',' or the end of line */
+	if(!frameDecodeNumber(&p, end, INT32_MAX, &value))
+	{
+		return false;
+	}
+
+	/* Optional sequence number */
+	fields->sequenced = false;
+	fields->seq = 0;
+
+	if((p < end) && (*p == ','))
+	{
+		if((++p >= end) || (*p < '0') || (*p > '9') || !frameDecodeNumber(&p, end, UINT32_MAX, &fields->seq))
+		{
+			return false;
+		}
+
+		fields->sequenced = true;
+	}
+
+	if((p < end) && (*p == '\r'))
+	{
+		p++;
+	}
+
+	if((p >= end) || (*p != FRAME_END_CHAR))
+	{
+		return false;
+	}
+
+	fields->channel = channel;
+	fields->value = (int32_t) value;
+
+	return true;
+}
+
+uint32_t frameEncode(char* frame, const char* type, uint32_t channel, int32_t value)
+{
+	int length = snprintf(frame, FRAME_MAX_SIZE, ">%s:%u,%d\r\n", type, channel, value);
+
+	return ((length > 0) && (length < FRAME_MAX_SIZE)) ? (uint32_t) length : 0;
+}
+
+uint32_t frameEncodeFields(char* frame, const frameFields_t* fields)
+{
+	int length;
+
+	if(!fields->sequenced)
+	{
+		return frameEncode(frame, fields->type, fields->channel, fields->value);
+	}
+
+	length = snprintf(frame, FRAME_MAX_SIZE, ">%s:%u,%d,%u\r\n", fields->type, fields->channel, fields->value, fields->seq);
+
+	return ((length > 0) && (length < FRAME_MAX_SIZE)) ? (uint32_t) length : 0;
+}
+
+uint32_t frameEncodeCompact(char* wire, const frameFields_t* fields)
+{
+	uint8_t* bytes = (uint8_t*) wire;
+	bool output = (strcmp(fields->type, "OUT") == 0);
+
+	/* Plain switch and output states of the first channels, anything else stays text */
+	if((!output && (strcmp(fields->type, "SW") != 0)) || fields->sequenced || (fields->channel > FRAME_COMPACT_CHANNEL_MAX) || (fields->value < 0) || (fields->value > FRAME_COMPACT_VALUE_MAX))
+	{
+		return 0;
+	}
+
+	bytes[0] = FRAME_COMPACT_HEADER | (output ? FRAME_COMPACT_OUTPUT : 0);
+	bytes[1] = (uint8_t) fields->channel;
+	bytes[2] = (uint8_t) fields->value;
+	bytes[3] = frameCompactCrc(bytes, 3);
+
+	return FRAME_COMPACT_SINGLE_SIZE;
+}
+
+uint32_t frameEncodeBitmap(char* wire, const char* type, uint32_t base, uint16_t present, uint16_t values)
+{
+	uint8_t* bytes = (uint8_t*) wire;
+	bool output = (strcmp(type, "OUT") == 0);
+
+	/* Up to 16 on/off states from channel base on, one bit each */
+	if((!output && (strcmp(type, "SW") != 0)) || (base > FRAME_COMPACT_CHANNEL_MAX))
+	{
+		return 0;
+	}
+
+	bytes[0] = FRAME_COMPACT_HEADER | FRAME_COMPACT_BITMAP | (output ? FRAME_COMPACT_OUTPUT : 0);
+	bytes[1] = (uint8_t) base;
+	bytes[2] = (uint8_t) (present & 0xFF);
+	bytes[3] = (uint8_t) (present >> 8);
+	bytes[4] = (uint8_t) (values & 0xFF);
+	bytes[5] = (uint8_t) (values >> 8);
+	bytes[6] = frameCompactCrc(bytes, 6);
+
+	return FRAME_COMPACT_BITMAP_SIZE;
+}
+
+/********************** End of File ******************************************/
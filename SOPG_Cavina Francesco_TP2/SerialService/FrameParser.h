@@ -0,0 +1,94 @@
+/*
+ * @file   : FrameParser.h
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+#ifndef FRAME_PARSER_H
+#define FRAME_PARSER_H
+
+/********************** Inclusions *******************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FrameQueue.h"
+
+/********************** Macros ***********************************************/
+#define FRAME_PARSER_BUFFER_SIZE		(512)
+#define FRAME_START_CHAR			('>')
+#define FRAME_END_CHAR				('\n')
+#define FRAME_TYPE_SIZE				(8)
+
+/* Compact framing of a controller link, negotiated with ">BIN:version,flags\r\n" */
+#define FRAME_COMPACT_TYPE			("BIN")
+#define FRAME_COMPACT_OFFER			(">BIN:")
+#define FRAME_COMPACT_VERSION			(1)
+#define FRAME_COMPACT_FLAG_BITMAP		(0x01)		// Bitmap frames understood
+#define FRAME_COMPACT_HEADER			(0xA0)		// 1010 B00T: B bitmap frame, T output (1) or switch (0)
+#define FRAME_COMPACT_HEADER_MASK		(0xF6)
+#define FRAME_COMPACT_BITMAP			(0x08)
+#define FRAME_COMPACT_OUTPUT			(0x01)
+#define FRAME_COMPACT_SINGLE_SIZE		(4)		// Header, channel, value, CRC-8
+#define FRAME_COMPACT_BITMAP_SIZE		(7)		// Header, first channel, present (16 bits), values (16 bits), CRC-8
+#define FRAME_COMPACT_BITMAP_CHANNELS		(16)
+#define FRAME_COMPACT_CHANNEL_MAX		(255)
+#define FRAME_COMPACT_VALUE_MAX			(255)
+
+/********************** Typedef **********************************************/
+/*
+ * Incremental parser for ">TYPE:n,v\r\n" frames. Bytes are read straight
+ * into the parser buffer and complete frames are returned as pointers into
+ * it: the parser itself copies nothing but the tail of a partial frame,
+ * moved back to the start of the buffer. The only copy of a frame is the
+ * one frameQueuePush() makes into its queue slot.
+ *
+ * A compact parser also accepts the binary frames of a controller link in
+ * compact framing, mixed with text ones: their header byte is never found
+ * in text. Each one is checked against its CRC-8 and returned translated to
+ * text, a bitmap frame as one text frame per channel it carries.
+ */
+typedef struct
+{
+	char buffer[FRAME_PARSER_BUFFER_SIZE];
+	uint32_t start;				// First byte not parsed yet
+	uint32_t end;				// One past the last byte received
+	uint32_t errors;			// Malformed or oversized frames discarded
+	uint64_t timestamp;			// When the last bytes were committed (ns)
+	bool compact;				// Compact frames accepted too
+	char text[FRAME_MAX_SIZE];		// Last compact frame, translated
+	uint8_t bitmapHeader;			// Bitmap frame being expanded: its header, first channel,
+	uint32_t bitmapBase;			// channels not returned yet and their values
+	uint16_t bitmapPresent;
+	uint16_t bitmapValues;
+} frameParser_t;
+
+/* Fields of a ">TYPE:channel,value\r\n" or ">TYPE:channel,value,seq\r\n" frame */
+typedef struct
+{
+	char type[FRAME_TYPE_SIZE];
+	uint32_t channel;
+	int32_t value;
+	bool sequenced;				// Carries a sequence number: acknowledged, never coalesced
+	uint32_t seq;
+} frameFields_t;
+
+/********************** External Data Declaration ****************************/
+
+/********************** External Functions Declaration ***********************/
+void frameParserInit(frameParser_t* parser);
+void frameParserReset(frameParser_t* parser);
+char* frameParserSpace(frameParser_t* parser, uint32_t* room);
+void frameParserCommit(frameParser_t* parser, uint32_t bytes, uint64_t timestamp);
+bool frameParserNext(frameParser_t* parser, const char** frame, uint32_t* length);
+void frameParserUnget(frameParser_t* parser, uint32_t length);
+void frameParserReject(frameParser_t* parser);
+void frameParserCompact(frameParser_t* parser, bool compact);
+bool frameDecode(const char* frame, uint32_t length, frameFields_t* fields);
+uint32_t frameEncode(char* frame, const char* type, uint32_t channel, int32_t value);
+uint32_t frameEncodeFields(char* frame, const frameFields_t* fields);
+uint32_t frameEncodeCompact(char* wire, const frameFields_t* fields);
+uint32_t frameEncodeBitmap(char* wire, const char* type, uint32_t base, uint16_t present, uint16_t values);
+
+#endif /* FRAME_PARSER_H */
+
+/********************** End of File ******************************************/
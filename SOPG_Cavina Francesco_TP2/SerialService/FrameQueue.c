@@ -0,0 +1,238 @@
+/*
+ * @file   : FrameQueue.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FrameQueue.h"
+
+/********************** Macros and Definitions *******************************/
+#define FRAME_QUEUE_MAX_DEPTH			(1u << 20)
+#define FRAME_QUEUE_POLICIES			(4)
+
+/********************** Internal Data Declaration ****************************/
+
+/********************** Internal Functions Declaration ***********************/
+static uint32_t depthRoundUp(uint32_t depth);
+
+/********************** Internal Data Definition *****************************/
+static const char* policyNames[FRAME_QUEUE_POLICIES] = {"block", "drop-oldest", "drop-newest", "coalesce"};
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+static uint32_t depthRoundUp(uint32_t depth)
+{
+	uint32_t rounded = 1;
+
+	/* Indexes are masked, so depth has to be a power of two */
+	while(rounded < depth)
+	{
+		rounded <<= 1;
+	}
+
+	return rounded;
+}
+
+/********************** External Functions Definition ************************/
+int frameQueueInit(frameQueue_t* queue, uint32_t depth)
+{
+	if((depth == 0) || (depth > FRAME_QUEUE_MAX_DEPTH))
+	{
+		fprintf(stderr, "ERROR invalid queue depth: %u.\r\n", depth);
+		return -1;
+	}
+
+	depth = depthRoundUp(depth);
+
+	/* Only the base is aligned to the cache line, a 48-byte frame_t still straddles two lines every other slot (C11 wants the size a multiple of the alignment) */
+	queue->slots = aligned_alloc(CACHE_LINE_SIZE, ((depth * sizeof(frame_t)) + CACHE_LINE_SIZE - 1) & ~((size_t) CACHE_LINE_SIZE - 1));
+	if(queue->slots == NULL)
+	{
+		perror("ERROR aligned_alloc() API");
+		return -1;
+	}
+
+	atomic_init(&queue->head, 0);
+	atomic_init(&queue->tail, 0);
+	queue->headCache = 0;
+	queue->tailCache = 0;
+	queue->mask = depth - 1;
+
+	return 0;
+}
+
+void frameQueueDeinit(frameQueue_t* queue)
+{
+	free(queue->slots);
+	queue->slots = NULL;
+}
+
+bool frameQueuePush(frameQueue_t* queue, const char* data, uint32_t length, uint64_t timestamp)
+{
+	uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	frame_t* slot;
+
+	if(length > FRAME_MAX_SIZE)
+	{
+		return false;
+	}
+
+	/* Only reload the consumer index when the cached one says the queue is full */
+	if((tail - queue->headCache) > queue->mask)
+	{
+		queue->headCache = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+		if((tail - queue->headCache) > queue->mask)
+		{
+			return false;
+		}
+	}
+
+	slot = &queue->slots[tail & queue->mask];
+	memcpy(slot->data, data, length);
+	slot->length = length;
+	slot->timestamp = timestamp;
+
+	/* Publish the frame to the consumer */
+	atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+
+	return true;
+}
+
+bool frameQueuePop(frameQueue_t* queue, frame_t* frame)
+{
+	frame_t* slot = frameQueuePeek(queue);
+
+	if(slot == NULL)
+	{
+		return false;
+	}
+
+	memcpy(frame, slot, sizeof(frame_t));
+	frameQueueRelease(queue);
+
+	return true;
+}
+
+frame_t* frameQueuePeek(frameQueue_t* queue)
+{
+	uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+	/* Only reload the producer index when the cached one says the queue is empty */
+	if(head == queue->tailCache)
+	{
+		queue->tailCache = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+		if(head == queue->tailCache)
+		{
+			return NULL;
+		}
+	}
+
+	return &queue->slots[head & queue->mask];
+}
+
+void frameQueueRelease(frameQueue_t* queue)
+{
+	uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+	/* Hand the slot back to the producer */
+	atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+}
+
+uint32_t frameQueuePeekMany(frameQueue_t* queue, frame_t** frames, uint32_t max)
+{
+	uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	uint32_t available, i;
+
+	queue->tailCache = atomic_load_explicit(&queue->tail, memory_order_acquire);
+	available = queue->tailCache - head;
+
+	if(available > max)
+	{
+		available = max;
+	}
+
+	/* Oldest first, so the caller can hand them to writev() in order */
+	for(i = 0; i < available; i++)
+	{
+		frames[i] = &queue->slots[(head + i) & queue->mask];
+	}
+
+	return available;
+}
+
+void frameQueueReleaseMany(frameQueue_t* queue, uint32_t count)
+{
+	uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+	atomic_store_explicit(&queue->head, head + count, memory_order_release);
+}
+
+bool frameQueueFull(frameQueue_t* queue)
+{
+	uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+	/* Producer side check */
+	if((tail - queue->headCache) > queue->mask)
+	{
+		queue->headCache = atomic_load_explicit(&queue->head, memory_order_acquire);
+	}
+
+	return ((tail - queue->headCache) > queue->mask);
+}
+
+uint32_t frameQueueCount(frameQueue_t* queue)
+{
+	uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+	uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+	return (tail - head);
+}
+
+bool frameQueueDropOldest(frameQueue_t* queue)
+{
+	/*
+	 * Consumer side: head and tailCache belong to the consumer, so the caller
+	 * is the consumer or keeps it out (the destination's lock) while this
+	 * runs. The oldest frame is released the way the consumer would, which
+	 * keeps its cached tail in step with head.
+	 */
+	if(frameQueuePeek(queue) == NULL)
+	{
+		return false;
+	}
+
+	frameQueueRelease(queue);
+
+	return true;
+}
+
+int frameQueuePolicyParse(const char* name, frameQueuePolicy_t* policy)
+{
+	uint32_t i;
+
+	for(i = 0; i < FRAME_QUEUE_POLICIES; i++)
+	{
+		if(strcmp(name, policyNames[i]) == 0)
+		{
+			*policy = (frameQueuePolicy_t) i;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+const char* frameQueuePolicyName(frameQueuePolicy_t policy)
+{
+	return policyNames[policy];
+}
+
+/********************** End of File ******************************************/
@@ -0,0 +1,71 @@
+/*
+ * @file   : FrameQueue.h
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+/********************** Inclusions *******************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/********************** Macros ***********************************************/
+#define CACHE_LINE_SIZE				(64)
+#define FRAME_MAX_SIZE				(32)
+#define FRAME_QUEUE_DEFAULT_DEPTH		(256)
+
+/********************** Typedef **********************************************/
+/* What a producer does with a frame when the destination's queue is full */
+typedef enum
+{
+	FRAME_QUEUE_POLICY_BLOCK = 0,			// Stop reading the source until there is room
+	FRAME_QUEUE_POLICY_DROP_OLDEST = 1,		// Discard the oldest queued frame
+	FRAME_QUEUE_POLICY_DROP_NEWEST = 2,		// Discard the incoming frame
+	FRAME_QUEUE_POLICY_COALESCE = 3			// Keep only the newest value per type and channel
+} frameQueuePolicy_t;
+
+typedef struct
+{
+	uint32_t length;
+	char data[FRAME_MAX_SIZE];
+	uint64_t timestamp;			// Monotonic time the frame was received (ns)
+} frame_t;
+
+/*
+ * Bounded single-producer/single-consumer ring of frames. Head is only
+ * written by the consumer and tail only by the producer, each one on its own
+ * cache line so both sides never share a line on the hot path.
+ */
+typedef struct
+{
+	_Alignas(CACHE_LINE_SIZE) _Atomic uint32_t head;	// Consumer index
+	uint32_t tailCache;					// Consumer's copy of tail
+	_Alignas(CACHE_LINE_SIZE) _Atomic uint32_t tail;	// Producer index
+	uint32_t headCache;					// Producer's copy of head
+	_Alignas(CACHE_LINE_SIZE) uint32_t mask;		// Depth - 1 (depth is a power of two)
+	frame_t* slots;
+} frameQueue_t;
+
+/********************** External Data Declaration ****************************/
+
+/********************** External Functions Declaration ***********************/
+int frameQueueInit(frameQueue_t* queue, uint32_t depth);
+void frameQueueDeinit(frameQueue_t* queue);
+bool frameQueuePush(frameQueue_t* queue, const char* data, uint32_t length, uint64_t timestamp);
+bool frameQueuePop(frameQueue_t* queue, frame_t* frame);
+frame_t* frameQueuePeek(frameQueue_t* queue);
+void frameQueueRelease(frameQueue_t* queue);
+uint32_t frameQueuePeekMany(frameQueue_t* queue, frame_t** frames, uint32_t max);
+void frameQueueReleaseMany(frameQueue_t* queue, uint32_t count);
+bool frameQueueFull(frameQueue_t* queue);
+uint32_t frameQueueCount(frameQueue_t* queue);
+bool frameQueueDropOldest(frameQueue_t* queue);
+int frameQueuePolicyParse(const char* name, frameQueuePolicy_t* policy);
+const char* frameQueuePolicyName(frameQueuePolicy_t policy);
+
+#endif /* FRAME_QUEUE_H */
+
+/********************** End of File ******************************************/
@@ -0,0 +1,396 @@
+/*
+ * @file   : HotRestart.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "HotRestart.h"
+
+/********************** Macros and Definitions *******************************/
+#define HOT_RESTART_MESSAGE_CHUNK		(4096)
+
+/********************** Internal Data Declaration ****************************/
+/* Sent together with the descriptors, the records follow */
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t fds;
+	uint32_t reserved;
+	uint64_t length;
+} preamble_t;
+
+/* Replacement is up and owns everything */
+typedef struct
+{
+	uint32_t magic;
+	int32_t pid;
+} ack_t;
+
+/********************** Internal Functions Declaration ***********************/
+static int addressInit(struct sockaddr_un* address, const char* path);
+static void timeoutsSet(int sock);
+static int writeAll(int sock, const void* data, size_t length);
+static int readAll(int sock, void* data, size_t length);
+
+/********************** Internal Data Definition *****************************/
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+static int addressInit(struct sockaddr_un* address, const char* path)
+{
+	memset(address, 0, sizeof(*address));
+	address->sun_family = AF_UNIX;
+
+	if(strlen(path) >= sizeof(address->sun_path))
+	{
+		fprintf(stderr, "ERROR hot restart socket path too long: %s\r\n", path);
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	strcpy(address->sun_path, path);
+
+	return 0;
+}
+
+static void timeoutsSet(int sock)
+{
+	struct timeval timeout = { .tv_sec = HOT_RESTART_TIMEOUT_MS / 1000, .tv_usec = (HOT_RESTART_TIMEOUT_MS % 1000) * 1000 };
+
+	/* A replacement that dies halfway must not hang the running process */
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+static int writeAll(int sock, const void* data, size_t length)
+{
+	const uint8_t* bytes = data;
+	ssize_t written;
+
+	while(length > 0)
+	{
+		if((written = send(sock, bytes, length, MSG_NOSIGNAL)) == -1)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+
+			return -1;
+		}
+
+		bytes += written;
+		length -= written;
+	}
+
+	return 0;
+}
+
+static int readAll(int sock, void* data, size_t length)
+{
+	uint8_t* bytes = data;
+	ssize_t got;
+
+	while(length > 0)
+	{
+		if((got = recv(sock, bytes, length, 0)) <= 0)
+		{
+			if((got == -1) && (errno == EINTR))
+			{
+				continue;
+			}
+
+			if(got == 0)
+			{
+				errno = ECONNRESET;
+			}
+
+			return -1;
+		}
+
+		bytes += got;
+		length -= got;
+	}
+
+	return 0;
+}
+
+/********************** External Functions Definition ************************/
+int hotRestartListen(const char* path)
+{
+	struct sockaddr_un address;
+	int fd;
+
+	if(addressInit(&address, path) != 0)
+	{
+		return -1;
+	}
+
+	if((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+	{
+		perror("ERROR socket(AF_UNIX) API");
+		return -1;
+	}
+
+	/* Left behind by a previous instance (or just handed over by it) */
+	unlink(path);
+
+	if((bind(fd, (struct sockaddr *) &address, sizeof(address)) == -1) || (listen(fd, 1) == -1))
+	{
+		fprintf(stderr, "ERROR hot restart socket %s: %s\r\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int hotRestartAccept(int listen_fd)
+{
+	int sock;
+
+	if((sock = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC)) == -1)
+	{
+		return -1;
+	}
+
+	timeoutsSet(sock);
+
+	return sock;
+}
+
+int hotRestartSend(int sock, const hotRestartMessage_t* message, const int* fds, uint32_t count)
+{
+	preamble_t preamble = { .magic = HOT_RESTART_MAGIC, .version = HOT_RESTART_VERSION, .fds = count, .length = message->length };
+	char control[CMSG_SPACE(sizeof(int) * HOT_RESTART_MAX_FDS)];
+	struct iovec iov = { .iov_base = &preamble, .iov_len = sizeof(preamble) };
+	struct msghdr header;
+	struct cmsghdr* cmsg;
+
+	if(count > HOT_RESTART_MAX_FDS)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.msg_iov = &iov;
+	header.msg_iovlen = 1;
+
+	/* Descriptors ride on the preamble, the kernel dups them into the receiver */
+	if(count > 0)
+	{
+		memset(control, 0, sizeof(control));
+		header.msg_control = control;
+		header.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+		cmsg = CMSG_FIRSTHDR(&header);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+		memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+	}
+
+	if(sendmsg(sock, &header, MSG_NOSIGNAL) != sizeof(preamble))
+	{
+		return -1;
+	}
+
+	return writeAll(sock, message->data, message->length);
+}
+
+int hotRestartWaitAck(int sock, pid_t* pid)
+{
+	ack_t ack;
+
+	/* Bounded by SO_RCVTIMEO */
+	if((readAll(sock, &ack, sizeof(ack)) != 0) || (ack.magic != HOT_RESTART_MAGIC))
+	{
+		return -1;
+	}
+
+	*pid = (pid_t) ack.pid;
+
+	return 0;
+}
+
+pid_t hotRestartSpawn(const char* path, char* const argv[])
+{
+	sigset_t set;
+	pid_t pid;
+
+	if((pid = fork()) == -1)
+	{
+		perror("ERROR fork() API");
+		return -1;
+	}
+
+	if(pid == 0)
+	{
+		/* The replacement sets up its own signal handling */
+		sigemptyset(&set);
+		sigprocmask(SIG_SETMASK, &set, NULL);
+
+		execv(path, argv);
+		fprintf(stderr, "ERROR execv(%s) API: %s\r\n", path, strerror(errno));
+		_exit(127);
+	}
+
+	return pid;
+}
+
+int hotRestartConnect(const char* path)
+{
+	struct sockaddr_un address;
+	int sock;
+
+	if(addressInit(&address, path) != 0)
+	{
+		return -1;
+	}
+
+	if((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+	{
+		perror("ERROR socket(AF_UNIX) API");
+		return -1;
+	}
+
+	if(connect(sock, (struct sockaddr *) &address, sizeof(address)) == -1)
+	{
+		fprintf(stderr, "ERROR no running Serial Service at %s: %s\r\n", path, strerror(errno));
+		close(sock);
+		return -1;
+	}
+
+	timeoutsSet(sock);
+
+	return sock;
+}
+
+int hotRestartReceive(int sock, hotRestartMessage_t* message, int* fds, uint32_t* count)
+{
+	char control[CMSG_SPACE(sizeof(int) * HOT_RESTART_MAX_FDS)];
+	preamble_t preamble;
+	struct iovec iov = { .iov_base = &preamble, .iov_len = sizeof(preamble) };
+	struct msghdr header;
+	struct cmsghdr* cmsg;
+
+	memset(&header, 0, sizeof(header));
+	header.msg_iov = &iov;
+	header.msg_iovlen = 1;
+	header.msg_control = control;
+	header.msg_controllen = sizeof(control);
+
+	if(recvmsg(sock, &header, MSG_WAITALL | MSG_CMSG_CLOEXEC) != sizeof(preamble))
+	{
+		return -1;
+	}
+
+	*count = 0;
+
+	for(cmsg = CMSG_FIRSTHDR(&header); cmsg != NULL; cmsg = CMSG_NXTHDR(&header, cmsg))
+	{
+		if((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS))
+		{
+			*count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * (*count));
+		}
+	}
+
+	/* Another version of the service, or descriptors lost on the way */
+	if((preamble.magic != HOT_RESTART_MAGIC) || (preamble.version != HOT_RESTART_VERSION) || (header.msg_flags & MSG_CTRUNC) || (*count != preamble.fds))
+	{
+		errno = EPROTO;
+		return -1;
+	}
+
+	hotRestartMessageFree(message);
+
+	if((message->data = malloc(preamble.length + 1)) == NULL)
+	{
+		return -1;
+	}
+
+	message->capacity = preamble.length + 1;
+	message->length = preamble.length;
+	message->offset = 0;
+
+	return readAll(sock, message->data, message->length);
+}
+
+int hotRestartAck(int sock)
+{
+	ack_t ack = { .magic = HOT_RESTART_MAGIC, .pid = (int32_t) getpid() };
+
+	return writeAll(sock, &ack, sizeof(ack));
+}
+
+void hotRestartMessageInit(hotRestartMessage_t* message)
+{
+	message->data = NULL;
+	message->length = 0;
+	message->capacity = 0;
+	message->offset = 0;
+}
+
+void hotRestartMessageFree(hotRestartMessage_t* message)
+{
+	free(message->data);
+	hotRestartMessageInit(message);
+}
+
+int hotRestartAppend(hotRestartMessage_t* message, const void* data, size_t length)
+{
+	uint8_t* grown;
+	size_t capacity;
+
+	if((message->length + length) > message->capacity)
+	{
+		capacity = (2 * message->capacity) + length + HOT_RESTART_MESSAGE_CHUNK;
+
+		if((grown = realloc(message->data, capacity)) == NULL)
+		{
+			perror("ERROR realloc() API");
+			return -1;
+		}
+
+		message->data = grown;
+		message->capacity = capacity;
+	}
+
+	memcpy(&message->data[message->length], data, length);
+	message->length += length;
+
+	return 0;
+}
+
+bool hotRestartTake(hotRestartMessage_t* message, void* data, size_t length)
+{
+	/* Truncated message */
+	if((message->offset + length) > message->length)
+	{
+		return false;
+	}
+
+	memcpy(data, &message->data[message->offset], length);
+	message->offset += length;
+
+	return true;
+}
+
+/********************** End of File ******************************************/
@@ -0,0 +1,61 @@
+/*
+ * @file   : HotRestart.h
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+#ifndef HOT_RESTART_H
+#define HOT_RESTART_H
+
+/********************** Inclusions *******************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/********************** Macros ***********************************************/
+#define HOT_RESTART_DEFAULT_PATH		("/tmp/serialService.restart")
+#define HOT_RESTART_MAGIC			(0x484f5452u)		// "HOTR"
+#define HOT_RESTART_VERSION			(5)
+#define HOT_RESTART_MAX_FDS			(128)
+#define HOT_RESTART_TIMEOUT_MS			(5000)
+
+/********************** Typedef **********************************************/
+/*
+ * State handed from the running Serial Service to its replacement. The
+ * sender appends fixed-size records in a known order and sends them in one
+ * message together with the descriptors (SCM_RIGHTS); the receiver takes
+ * them back in the same order.
+ */
+typedef struct
+{
+	uint8_t* data;
+	size_t length;				// Bytes appended (sender) or received (receiver)
+	size_t capacity;
+	size_t offset;				// Next byte to take (receiver)
+} hotRestartMessage_t;
+
+/********************** External Data Declaration ****************************/
+
+/********************** External Functions Declaration ***********************/
+/* Running process */
+int hotRestartListen(const char* path);
+int hotRestartAccept(int listen_fd);
+int hotRestartSend(int sock, const hotRestartMessage_t* message, const int* fds, uint32_t count);
+int hotRestartWaitAck(int sock, pid_t* pid);
+pid_t hotRestartSpawn(const char* path, char* const argv[]);
+
+/* Replacement process */
+int hotRestartConnect(const char* path);
+int hotRestartReceive(int sock, hotRestartMessage_t* message, int* fds, uint32_t* count);
+int hotRestartAck(int sock);
+
+/* Message records */
+void hotRestartMessageInit(hotRestartMessage_t* message);
+void hotRestartMessageFree(hotRestartMessage_t* message);
+int hotRestartAppend(hotRestartMessage_t* message, const void* data, size_t length);
+bool hotRestartTake(hotRestartMessage_t* message, void* data, size_t length);
+
+#endif /* HOT_RESTART_H */
+
+/********************** End of File ******************************************/
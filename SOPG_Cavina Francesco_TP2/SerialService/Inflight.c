@@ -0,0 +1,125 @@
+/*
+ * @file   : Inflight.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Inflight.h"
+
+/********************** Macros and Definitions *******************************/
+#define INFLIGHT_MAX_WINDOW			(1u << 20)
+
+/********************** Internal Data Declaration ****************************/
+
+/********************** Internal Functions Declaration ***********************/
+
+/********************** Internal Data Definition *****************************/
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+
+/********************** External Functions Definition ************************/
+int inflightInit(inflight_t* inflight, uint32_t window)
+{
+	uint32_t rounded = 1, i;
+
+	if((window == 0) || (window > INFLIGHT_MAX_WINDOW))
+	{
+		fprintf(stderr, "ERROR invalid in-flight window: %u.\r\n", window);
+		return -1;
+	}
+
+	/* Slots are picked by masking the sequence number, so the window is a power of two */
+	while(rounded < window)
+	{
+		rounded <<= 1;
+	}
+
+	if((inflight->entries = malloc(rounded * sizeof(inflightEntry_t))) == NULL)
+	{
+		perror("ERROR malloc() API");
+		return -1;
+	}
+
+	for(i = 0; i < rounded; i++)
+	{
+		inflight->entries[i].client = INFLIGHT_CLIENT_NONE;
+	}
+
+	inflight->mask = rounded - 1;
+	inflight->next = 1;
+	inflight->count = 0;
+
+	return 0;
+}
+
+void inflightDeinit(inflight_t* inflight)
+{
+	free(inflight->entries);
+	inflight->entries = NULL;
+	inflight->count = 0;
+}
+
+bool inflightTrack(inflight_t* inflight, inflightEntry_t* entry, inflightEntry_t* expired)
+{
+	inflightEntry_t* slot;
+	bool wrapped = false;
+
+	entry->seq = inflight->next++;
+	slot = &inflight->entries[entry->seq & inflight->mask];
+
+	/* A whole window later and still no ACK: give up on the old command */
+	if(slot->client != INFLIGHT_CLIENT_NONE)
+	{
+		*expired = *slot;
+		inflight->count--;
+		wrapped = true;
+	}
+
+	*slot = *entry;
+	inflight->count++;
+
+	return wrapped;
+}
+
+bool inflightComplete(inflight_t* inflight, uint32_t seq, inflightEntry_t* entry)
+{
+	inflightEntry_t* slot = &inflight->entries[seq & inflight->mask];
+
+	/* Not ours, already acknowledged or given up on */
+	if((slot->client == INFLIGHT_CLIENT_NONE) || (slot->seq != seq))
+	{
+		return false;
+	}
+
+	*entry = *slot;
+	slot->client = INFLIGHT_CLIENT_NONE;
+	inflight->count--;
+
+	return true;
+}
+
+uint32_t inflightForget(inflight_t* inflight, int32_t client)
+{
+	uint32_t i, forgotten = 0;
+
+	/* The client left: its slot may be reused by another connection, which must not get the ACKs */
+	for(i = 0; (inflight->count > 0) && (i <= inflight->mask); i++)
+	{
+		if(inflight->entries[i].client == client)
+		{
+			inflight->entries[i].client = INFLIGHT_CLIENT_NONE;
+			inflight->count--;
+			forgotten++;
+		}
+	}
+
+	return forgotten;
+}
+
+/********************** End of File ******************************************/
@@ -0,0 +1,56 @@
+/*
+ * @file   : Inflight.h
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+#ifndef INFLIGHT_H
+#define INFLIGHT_H
+
+/********************** Inclusions *******************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************** Macros ***********************************************/
+#define INFLIGHT_DEFAULT_WINDOW			(1024)
+#define INFLIGHT_CLIENT_NONE			(-1)
+
+/********************** Typedef **********************************************/
+/* A sequenced command written to a controller and not acknowledged yet */
+typedef struct
+{
+	uint32_t seq;				// Number given by the Serial Service on the link
+	int32_t client;				// Client that sent it, INFLIGHT_CLIENT_NONE: slot free
+	uint32_t clientSeq;			// Number given by the client
+	uint32_t channel;			// Global channel, echoed in the client's ACK
+	uint64_t timestamp;			// When the command was received (ns)
+} inflightEntry_t;
+
+/*
+ * Window of sequenced commands of one controller link. Link sequence
+ * numbers are handed out in order, so the command numbered seq lives in
+ * slot seq & mask and a lookup is a single compare. When the window wraps
+ * around onto a command that was never acknowledged, that command is given
+ * up on and returned to the caller. Owned by the clients side (socketRead()
+ * and socketWrite(), both under the clients mutex), no locking.
+ */
+typedef struct
+{
+	inflightEntry_t* entries;
+	uint32_t mask;
+	uint32_t next;				// Next link sequence number
+	uint32_t count;				// Commands in flight
+} inflight_t;
+
+/********************** External Data Declaration ****************************/
+
+/********************** External Functions Declaration ***********************/
+int inflightInit(inflight_t* inflight, uint32_t window);
+void inflightDeinit(inflight_t* inflight);
+bool inflightTrack(inflight_t* inflight, inflightEntry_t* entry, inflightEntry_t* expired);
+bool inflightComplete(inflight_t* inflight, uint32_t seq, inflightEntry_t* entry);
+uint32_t inflightForget(inflight_t* inflight, int32_t client);
+
+#endif /* INFLIGHT_H */
+
+/********************** End of File ******************************************/
@@ -0,0 +1,321 @@
+/*
+ * @file   : InterfaceClients.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "InterfaceClients.h"
+
+/********************** Macros and Definitions *******************************/
+#define CLIENT_WRITE_BATCH			(64)
+
+/********************** Internal Data Declaration ****************************/
+
+/********************** Internal Functions Declaration ***********************/
+static bool clientQueue(client_t* client, const frame_t* frame);
+static void clientRefill(client_t* client);
+
+/********************** Internal Data Definition *****************************/
+static client_t clients[CLIENTS_MAX];
+static latencyHistogram_t* clientsLatency;		// Received-to-sent time of every frame delivered
+static metricsDirection_t* clientsMetrics;		// Frames and bytes delivered, frames dropped
+static _Atomic uint32_t connected = 0;			// Clients added and not released yet, read by the metrics thread
+static frameQueuePolicy_t clientsPolicy;		// What to do with a frame for a full send queue
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+static bool clientQueue(client_t* client, const frame_t* frame)
+{
+	uint64_t saved = client->coalescer.saved;
+
+	/* Coalesce: once the queue is full, switch values wait in the coalescer until it drains */
+	if((clientsPolicy == FRAME_QUEUE_POLICY_COALESCE) && ((client->coalescer.pending > 0) || frameQueueFull(&client->txQueue)) && coalescerPut(&client->coalescer, frame))
+	{
+		atomic_fetch_add_explicit(&clientsMetrics->coalesced, client->coalescer.saved - saved, memory_order_relaxed);
+		return true;
+	}
+
+	/* Drop oldest: make room, unless the oldest frame is already halfway out */
+	if((clientsPolicy == FRAME_QUEUE_POLICY_DROP_OLDEST) && frameQueueFull(&client->txQueue) && (client->txOffset == 0) && frameQueueDropOldest(&client->txQueue))
+	{
+		client->dropped++;
+		atomic_fetch_add_explicit(&clientsMetrics->dropped, 1, memory_order_relaxed);
+	}
+
+	if(frameQueuePush(&client->txQueue, frame->data, frame->length, frame->timestamp))
+	{
+		return true;
+	}
+
+	/* Drop newest, or nothing else could make room */
+	client->dropped++;
+	atomic_fetch_add_explicit(&clientsMetrics->dropped, 1, memory_order_relaxed);
+
+	return false;
+}
+
+static void clientRefill(client_t* client)
+{
+	frame_t frame;
+
+	/* Coalesced values follow the frames queued before them */
+	while(!frameQueueFull(&client->txQueue) && coalescerTake(&client->coalescer, &frame))
+	{
+		frameQueuePush(&client->txQueue, frame.data, frame.length, frame.timestamp);
+	}
+}
+
+/********************** External Functions Definition ************************/
+void clientsInit(uint32_t queueDepth, uint32_t channels, latencyHistogram_t* latency, metricsDirection_t* metrics, frameQueuePolicy_t policy)
+{
+	uint32_t i;
+
+	clientsLatency = latency;
+	clientsMetrics = metrics;
+	clientsPolicy = policy;
+
+	/* Send queues are allocated once, slots are reused across connections */
+	for(i = 0; i < CLIENTS_MAX; i++)
+	{
+		clients[i].fd = -1;
+		clients[i].index = i;
+		clients[i].status = CLIENT_FREE;
+
+		if(frameQueueInit(&clients[i].txQueue, queueDepth) != 0)
+		{
+			exit(1);
+		}
+
+		if((policy == FRAME_QUEUE_POLICY_COALESCE) && (coalescerInit(&clients[i].coalescer, "SW", (channels > COALESCER_DEFAULT_CHANNELS) ? channels : COALESCER_DEFAULT_CHANNELS) != 0))
+		{
+			exit(1);
+		}
+	}
+}
+
+void clientsDeinit(void)
+{
+	uint32_t i;
+
+	for(i = 0; i < CLIENTS_MAX; i++)
+	{
+		if(clients[i].status != CLIENT_FREE)
+		{
+			clientsRelease(&clients[i]);
+		}
+
+		frameQueueDeinit(&clients[i].txQueue);
+
+		if(clientsPolicy == FRAME_QUEUE_POLICY_COALESCE)
+		{
+			coalescerDeinit(&clients[i].coalescer);
+		}
+	}
+}
+
+client_t* clientsAdd(int fd, const char* name)
+{
+	frame_t* frame;
+	uint32_t i;
+
+	for(i = 0; i < CLIENTS_MAX; i++)
+	{
+		if(clients[i].status == CLIENT_FREE)
+		{
+			clients[i].fd = fd;
+			clients[i].txOffset = 0;
+			clients[i].dropped = 0;
+			clients[i].quickAck = false;
+			clients[i].blockedLink = -1;
+			snprintf(clients[i].name, sizeof(clients[i].name), "%s", name);
+			frameParserInit(&clients[i].parser);
+
+			/* Forget frames left over by the previous connection */
+			while((frame = frameQueuePeek(&clients[i].txQueue)) != NULL)
+			{
+				frameQueueRelease(&clients[i].txQueue);
+			}
+
+			if(clientsPolicy == FRAME_QUEUE_POLICY_COALESCE)
+			{
+				coalescerReset(&clients[i].coalescer);
+			}
+
+			clients[i].status = CLIENT_CONNECTED;
+			atomic_fetch_add_explicit(&connected, 1, memory_order_relaxed);
+
+			return &clients[i];
+		}
+	}
+
+	/* Table full */
+	return NULL;
+}
+
+void clientsRelease(client_t* client)
+{
+	if((client->dropped > 0) || (client->coalescer.saved > 0))
+	{
+		printf("CLIENT %s: %u frames dropped, %llu coalesced (send queue full, %s).\r\n", client->name, client->dropped, (unsigned long long) client->coalescer.saved, frameQueuePolicyName(clientsPolicy));
+	}
+
+	close(client->fd);
+	client->fd = -1;
+	client->status = CLIENT_FREE;
+	atomic_fetch_sub_explicit(&connected, 1, memory_order_relaxed);
+}
+
+client_t* clientsGet(uint32_t index)
+{
+	return &clients[index];
+}
+
+uint32_t clientsCount(void)
+{
+	uint32_t i, count = 0;
+
+	for(i = 0; i < CLIENTS_MAX; i++)
+	{
+		if(clients[i].status == CLIENT_CONNECTED)
+		{
+			count++;
+		}
+	}
+
+	return count;
+}
+
+uint32_t clientsConnected(void)
+{
+	/* Unlike clientsCount(), safe from any thread */
+	return atomic_load_explicit(&connected, memory_order_relaxed);
+}
+
+bool clientsWritable(void)
+{
+	uint32_t i;
+
+	if(clientsPolicy != FRAME_QUEUE_POLICY_BLOCK)
+	{
+		return true;
+	}
+
+	/* Block: the slowest client holds back every frame for all of them */
+	for(i = 0; i < CLIENTS_MAX; i++)
+	{
+		if((clients[i].status == CLIENT_CONNECTED) && frameQueueFull(&clients[i].txQueue))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+uint32_t clientsBroadcast(const frame_t* frame)
+{
+	uint32_t i, queued = 0;
+
+	/* Copy the frame into every connected client's send queue */
+	for(i = 0; i < CLIENTS_MAX; i++)
+	{
+		if(clients[i].status != CLIENT_CONNECTED)
+		{
+			continue;
+		}
+
+		if(clientQueue(&clients[i], frame))
+		{
+			queued++;
+		}
+	}
+
+	return queued;
+}
+
+bool clientsSend(client_t* client, const frame_t* frame)
+{
+	/* One client only, e.g. the ACK of its own command */
+	if(client->status != CLIENT_CONNECTED)
+	{
+		return false;
+	}
+
+	return clientQueue(client, frame);
+}
+
+int clientsFlush(client_t* client)
+{
+	frame_t* frames[CLIENT_WRITE_BATCH];
+	struct iovec iov[CLIENT_WRITE_BATCH];
+	uint32_t count, sent, i;
+	uint64_t now, delivered;
+	ssize_t bytes;
+
+	clientRefill(client);
+
+	while((count = frameQueuePeekMany(&client->txQueue, frames, CLIENT_WRITE_BATCH)) > 0)
+	{
+		/* Gather queued frames into a single syscall, resuming a partially sent one */
+		for(i = 0; i < count; i++)
+		{
+			iov[i].iov_base = frames[i]->data;
+			iov[i].iov_len = frames[i]->length;
+		}
+		iov[0].iov_base = &frames[0]->data[client->txOffset];
+		iov[0].iov_len -= client->txOffset;
+
+		struct msghdr message = { .msg_iov = iov, .msg_iovlen = count };
+		bytes = sendmsg(client->fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+		if(bytes == -1)
+		{
+			if((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			{
+				return 1;
+			}
+
+			client->status = CLIENT_DISCONNECTED;
+			return -1;
+		}
+
+		/* Release every fully sent frame and remember where the next one stops */
+		now = latencyNow();
+		delivered = 0;
+		for(sent = 0; (sent < count) && ((size_t) bytes >= iov[sent].iov_len); sent++)
+		{
+			bytes -= iov[sent].iov_len;
+			delivered += frames[sent]->length;
+			latencyHistogramRecord(clientsLatency, now - frames[sent]->timestamp);
+		}
+
+		atomic_fetch_add_explicit(&clientsMetrics->framesSent, sent, memory_order_relaxed);
+		atomic_fetch_add_explicit(&clientsMetrics->bytesSent, delivered, memory_order_relaxed);
+
+		frameQueueReleaseMany(&client->txQueue, sent);
+		client->txOffset = (sent == 0) ? (client->txOffset + bytes) : (uint32_t) bytes;
+		clientRefill(client);
+
+		if(sent < count)
+		{
+			/* Socket buffer full */
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/********************** End of File ******************************************/
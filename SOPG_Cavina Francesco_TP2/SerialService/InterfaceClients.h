@@ -0,0 +1,71 @@
+/*
+ * @file   : InterfaceClients.h
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+#ifndef INTERFACE_CLIENTS_H
+#define INTERFACE_CLIENTS_H
+
+/********************** Inclusions *******************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FrameQueue.h"
+#include "FrameParser.h"
+#include "LatencyHistogram.h"
+#include "Coalescer.h"
+#include "Metrics.h"
+
+/********************** Macros ***********************************************/
+#define CLIENTS_MAX				(32)
+#define CLIENT_NAME_SIZE			(64)
+
+/********************** Typedef **********************************************/
+typedef enum
+{
+	CLIENT_DISCONNECTED = 0,
+	CLIENT_CONNECTED = 1,
+	CLIENT_FREE = 2
+} clientStatus_t;
+
+/*
+ * One Interface Service connection. Frames from the Controller Emulator are
+ * copied into every client's own send queue, so a slow client only fills its
+ * own queue instead of stalling the others. What happens to a frame that
+ * doesn't fit is the clients' policy (see clientsInit()).
+ */
+typedef struct
+{
+	int fd;
+	uint32_t index;
+	clientStatus_t status;
+	char name[CLIENT_NAME_SIZE];
+	frameParser_t parser;			// Frames from this client
+	frameQueue_t txQueue;			// Frames to this client
+	uint32_t txOffset;			// Bytes of the oldest queued frame already sent
+	uint32_t dropped;			// Frames lost because txQueue was full
+	coalescer_t coalescer;			// Newest switch values held while txQueue is full (coalesce policy)
+	uint32_t events;			// epoll events registered for fd (epoll mode)
+	bool quickAck;				// TCP client: TCP_QUICKACK is re-armed after every read
+	int32_t blockedLink;			// Controller link whose full queue stopped reading this client, -1 if none
+} client_t;
+
+/********************** External Data Declaration ****************************/
+
+/********************** External Functions Declaration ***********************/
+void clientsInit(uint32_t queueDepth, uint32_t channels, latencyHistogram_t* latency, metricsDirection_t* metrics, frameQueuePolicy_t policy);
+void clientsDeinit(void);
+client_t* clientsAdd(int fd, const char* name);
+void clientsRelease(client_t* client);
+client_t* clientsGet(uint32_t index);
+uint32_t clientsCount(void);
+uint32_t clientsConnected(void);
+bool clientsWritable(void);
+uint32_t clientsBroadcast(const frame_t* frame);
+bool clientsSend(client_t* client, const frame_t* frame);
+int clientsFlush(client_t* client);
+
+#endif /* INTERFACE_CLIENTS_H */
+
+/********************** End of File ******************************************/
@@ -0,0 +1,274 @@
+/*
+ * @file   : Journal.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Journal.h"
+
+/********************** Macros and Definitions *******************************/
+#define NANOSECONDS_PER_SECOND			(1000000000ULL)
+#define BYTES_PER_MB				(1024ULL * 1024ULL)
+
+_Static_assert(sizeof(journalRecord_t) == CACHE_LINE_SIZE, "journal records are one cache line");
+_Static_assert(sizeof(journalHeader_t) <= JOURNAL_HEADER_SIZE, "journal header fits its page");
+
+/********************** Internal Data Declaration ****************************/
+
+/********************** Internal Functions Declaration ***********************/
+static uint64_t clockNow(clockid_t clock);
+static journal_t* journalMap(int fd, uint64_t size, bool writable);
+
+/********************** Internal Data Definition *****************************/
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+static uint64_t clockNow(clockid_t clock)
+{
+	struct timespec now;
+
+	clock_gettime(clock, &now);
+
+	return ((uint64_t) now.tv_sec * NANOSECONDS_PER_SECOND) + (uint64_t) now.tv_nsec;
+}
+
+static journal_t* journalMap(int fd, uint64_t size, bool writable)
+{
+	journal_t* journal;
+	void* base;
+
+	/* Writer: every page populated now, so appending never faults */
+	base = mmap(NULL, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED | (writable ? MAP_POPULATE : 0), fd, 0);
+
+	if(base == MAP_FAILED)
+	{
+		perror("ERROR mmap() API");
+		return NULL;
+	}
+
+	if((journal = malloc(sizeof(journal_t))) == NULL)
+	{
+		perror("ERROR malloc() API");
+		munmap(base, size);
+		return NULL;
+	}
+
+	journal->header = base;
+	journal->records = (journalRecord_t*) ((uint8_t*) base + JOURNAL_HEADER_SIZE);
+	journal->mapped = size;
+	journal->writable = writable;
+
+	return journal;
+}
+
+/********************** External Functions Definition ************************/
+journal_t* journalCreate(const char* path, uint64_t sizeMb, bool keep)
+{
+	journalHeader_t* header;
+	journal_t* journal;
+	struct stat status;
+	uint64_t slots;
+	int fd, result;
+
+	slots = ((sizeMb * BYTES_PER_MB) - JOURNAL_HEADER_SIZE) / sizeof(journalRecord_t);
+
+	if((sizeMb == 0) || (slots == 0))
+	{
+		fprintf(stderr, "ERROR journal size must be at least 1 MB.\r\n");
+		return NULL;
+	}
+
+	if((fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) == -1)
+	{
+		fprintf(stderr, "ERROR journal %s: %s\r\n", path, strerror(errno));
+		return NULL;
+	}
+
+	/* Hot restart: carry on appending to the ring the previous process left if it is the same layout */
+	if(keep && (fstat(fd, &status) == 0) && ((uint64_t) status.st_size == (JOURNAL_HEADER_SIZE + (slots * sizeof(journalRecord_t)))))
+	{
+		if((journal = journalMap(fd, (uint64_t) status.st_size, true)) != NULL)
+		{
+			header = journal->header;
+
+			if((header->magic == JOURNAL_MAGIC) && (header->version == JOURNAL_VERSION) && (header->recordSize == sizeof(journalRecord_t)) && (header->slots == slots))
+			{
+				/* A record the previous process claimed and never finished would hold every later one back */
+				atomic_store_explicit(&header->committed, atomic_load_explicit(&header->written, memory_order_relaxed), memory_order_release);
+				close(fd);
+				return journal;
+			}
+
+			journalClose(journal);
+		}
+	}
+
+	/* Blocks reserved up front: a full disk shows up now, not as SIGBUS while forwarding */
+	result = (ftruncate(fd, 0) == -1) ? errno : posix_fallocate(fd, 0, JOURNAL_HEADER_SIZE + (slots * sizeof(journalRecord_t)));
+
+	if(result != 0)
+	{
+		fprintf(stderr, "ERROR journal %s: %s\r\n", path, strerror(result));
+		close(fd);
+		return NULL;
+	}
+
+	journal = journalMap(fd, JOURNAL_HEADER_SIZE + (slots * sizeof(journalRecord_t)), true);
+	close(fd);
+
+	if(journal == NULL)
+	{
+		return NULL;
+	}
+
+	/* Readers check magic and version before trusting the rest */
+	header = journal->header;
+	header->version = JOURNAL_VERSION;
+	header->recordSize = sizeof(journalRecord_t);
+	header->slots = slots;
+	header->startRealtime = clockNow(CLOCK_REALTIME);
+	header->startMonotonic = clockNow(CLOCK_MONOTONIC);
+	atomic_store_explicit(&header->written, 0, memory_order_relaxed);
+	atomic_store_explicit(&header->committed, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	header->magic = JOURNAL_MAGIC;
+
+	return journal;
+}
+
+void journalAppend(journal_t* journal, journalDirection_t direction, uint32_t link, const char* data, uint32_t length, uint64_t timestamp)
+{
+	journalRecord_t* record;
+	uint64_t index;
+
+	/* Both directions may append at once (threads mode): each one claims its own slot */
+	index = atomic_fetch_add_explicit(&journal->header->written, 1, memory_order_relaxed);
+	record = &journal->records[index % journal->header->slots];
+
+	if(length > FRAME_MAX_SIZE)
+	{
+		length = FRAME_MAX_SIZE;
+	}
+
+	/* Invalid while being written, readers skip it */
+	atomic_store_explicit(&record->sequence, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	record->timestamp = timestamp;
+	record->direction = (uint8_t) direction;
+	record->length = (uint8_t) length;
+	record->link = (uint16_t) link;
+	memcpy(record->data, data, length);
+
+	atomic_store_explicit(&record->sequence, index + 1, memory_order_release);
+
+	/* Publish in claim order: an appender that claimed an earlier slot is a memcpy away from done */
+	while(atomic_load_explicit(&journal->header->committed, memory_order_relaxed) != index)
+	{
+		sched_yield();
+	}
+
+	atomic_store_explicit(&journal->header->committed, index + 1, memory_order_release);
+}
+
+journal_t* journalOpen(const char* path)
+{
+	journalHeader_t* header;
+	journal_t* journal;
+	struct stat status;
+	int fd;
+
+	if((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+	{
+		fprintf(stderr, "ERROR journal %s: %s\r\n", path, strerror(errno));
+		return NULL;
+	}
+
+	if((fstat(fd, &status) == -1) || ((uint64_t) status.st_size < JOURNAL_HEADER_SIZE))
+	{
+		fprintf(stderr, "ERROR %s is not a journal.\r\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	journal = journalMap(fd, (uint64_t) status.st_size, false);
+	close(fd);
+
+	if(journal == NULL)
+	{
+		return NULL;
+	}
+
+	/* Written by another version of the service, or cut short */
+	header = journal->header;
+	if((header->magic != JOURNAL_MAGIC) || (header->version != JOURNAL_VERSION) || (header->recordSize != sizeof(journalRecord_t)) || ((JOURNAL_HEADER_SIZE + (header->slots * sizeof(journalRecord_t))) > (uint64_t) status.st_size))
+	{
+		fprintf(stderr, "ERROR %s is not a journal of this version.\r\n", path);
+		journalClose(journal);
+		return NULL;
+	}
+
+	return journal;
+}
+
+uint64_t journalFirst(const journal_t* journal)
+{
+	uint64_t end = journalEnd(journal);
+
+	/* Oldest record still in the ring */
+	return (end > journal->header->slots) ? (end - journal->header->slots) : 0;
+}
+
+uint64_t journalEnd(const journal_t* journal)
+{
+	return atomic_load_explicit(&journal->header->committed, memory_order_acquire);
+}
+
+bool journalRead(const journal_t* journal, uint64_t index, journalRecord_t* record)
+{
+	const journalRecord_t* slot = &journal->records[index % journal->header->slots];
+	uint64_t before, after;
+
+	/* The service may be appending while we read: keep the copy only if nobody touched the slot meanwhile */
+	before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+	record->timestamp = slot->timestamp;
+	record->direction = slot->direction;
+	record->length = slot->length;
+	record->link = slot->link;
+	memcpy(record->data, slot->data, FRAME_MAX_SIZE);
+
+	atomic_thread_fence(memory_order_acquire);
+	after = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+
+	atomic_store_explicit(&record->sequence, after, memory_order_relaxed);
+
+	return ((before == (index + 1)) && (after == before) && (record->length <= FRAME_MAX_SIZE));
+}
+
+void journalClose(journal_t* journal)
+{
+	if(journal == NULL)
+	{
+		return;
+	}
+
+	munmap(journal->header, journal->mapped);
+	free(journal);
+}
+
+/********************** End of File ******************************************/
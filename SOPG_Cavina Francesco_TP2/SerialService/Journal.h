@@ -0,0 +1,95 @@
+/*
+ * @file   : Journal.h
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+/********************** Inclusions *******************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "FrameQueue.h"
+
+/********************** Macros ***********************************************/
+#define JOURNAL_MAGIC				(0x4c4e524au)		// "JRNL"
+#define JOURNAL_VERSION				(2)
+#define JOURNAL_DEFAULT_SIZE_MB			(16)
+#define JOURNAL_HEADER_SIZE			(4096)
+#define JOURNAL_LINK_NONE			(0xFFFF)
+
+/********************** Typedef **********************************************/
+typedef enum
+{
+	JOURNAL_CONTROLLER = 0,			// Controller Emulator -> Interface Service
+	JOURNAL_INTERFACE = 1			// Interface Service -> Controller Emulator
+} journalDirection_t;
+
+/*
+ * One frame as it entered the bridge. Records are fixed size, one cache line
+ * each, so the oldest one in a wrapped ring is always at a known slot.
+ * sequence is written last: a reader only trusts a record whose sequence is
+ * its own index + 1 (zero while being written or never written).
+ */
+typedef struct
+{
+	_Atomic uint64_t sequence;
+	uint64_t timestamp;			// Monotonic time the frame was received (ns)
+	uint8_t direction;			// journalDirection_t
+	uint8_t length;
+	char data[FRAME_MAX_SIZE];
+	uint16_t link;				// Controller link it came from or was routed to, JOURNAL_LINK_NONE if unroutable
+	uint8_t reserved[CACHE_LINE_SIZE - 20 - FRAME_MAX_SIZE];
+} journalRecord_t;
+
+/*
+ * Ring file: a one page header, then slots records. written counts every
+ * record ever claimed, the next one goes to slot written % slots. committed
+ * counts the records completely stored, in order: readers stop there, so a
+ * slot claimed but still being filled is never taken for a torn one. The file
+ * is preallocated and mapped once, appending a frame is a memcpy into the
+ * page cache: no syscall, and the kernel writes it back even if the service
+ * crashes.
+ */
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t recordSize;
+	uint32_t reserved;
+	uint64_t slots;
+	uint64_t startRealtime;			// Wall clock when the journal was created (ns since the epoch)
+	uint64_t startMonotonic;		// Monotonic clock at the same moment (ns)
+	_Alignas(CACHE_LINE_SIZE) _Atomic uint64_t written;
+	_Alignas(CACHE_LINE_SIZE) _Atomic uint64_t committed;
+} journalHeader_t;
+
+typedef struct
+{
+	journalHeader_t* header;
+	journalRecord_t* records;
+	uint64_t mapped;			// Bytes mapped
+	bool writable;
+} journal_t;
+
+/********************** External Data Declaration ****************************/
+
+/********************** External Functions Declaration ***********************/
+/* Writer side (Serial Service) */
+journal_t* journalCreate(const char* path, uint64_t sizeMb, bool keep);
+void journalAppend(journal_t* journal, journalDirection_t direction, uint32_t link, const char* data, uint32_t length, uint64_t timestamp);
+
+/* Reader side */
+journal_t* journalOpen(const char* path);
+uint64_t journalFirst(const journal_t* journal);
+uint64_t journalEnd(const journal_t* journal);
+bool journalRead(const journal_t* journal, uint64_t index, journalRecord_t* record);
+
+void journalClose(journal_t* journal);
+
+#endif /* JOURNAL_H */
+
+/********************** End of File ******************************************/
@@ -0,0 +1,189 @@
+/*
+ * @file   : LatencyHistogram.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "LatencyHistogram.h"
+
+/********************** Macros and Definitions *******************************/
+#define NANOSECONDS_PER_SECOND			(1000000000ULL)
+
+/********************** Internal Data Declaration ****************************/
+
+/********************** Internal Functions Declaration ***********************/
+static uint32_t bucketIndex(uint64_t value);
+static uint64_t bucketHighest(uint32_t index);
+
+/********************** Internal Data Definition *****************************/
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+static uint32_t bucketIndex(uint64_t value)
+{
+	uint32_t shift;
+
+	/* Small values have a bucket each */
+	if(value < (2 * LATENCY_SUB_BUCKETS))
+	{
+		return (uint32_t) value;
+	}
+
+	/* Keep the LATENCY_SUB_BUCKET_BITS + 1 most significant bits */
+	shift = (63 - (uint32_t) __builtin_clzll(value)) - LATENCY_SUB_BUCKET_BITS;
+
+	return (shift * LATENCY_SUB_BUCKETS) + (uint32_t) (value >> shift);
+}
+
+static uint64_t bucketHighest(uint32_t index)
+{
+	uint32_t shift;
+	uint64_t mantissa;
+
+	if(index < (2 * LATENCY_SUB_BUCKETS))
+	{
+		return index;
+	}
+
+	shift = (index / LATENCY_SUB_BUCKETS) - 1;
+	mantissa = (index % LATENCY_SUB_BUCKETS) + LATENCY_SUB_BUCKETS;
+
+	return ((mantissa + 1) << shift) - 1;
+}
+
+/********************** External Functions Definition ************************/
+uint64_t latencyNow(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t) now.tv_sec * NANOSECONDS_PER_SECOND) + (uint64_t) now.tv_nsec;
+}
+
+void latencyHistogramInit(latencyHistogram_t* histogram, const char* name)
+{
+	uint32_t i;
+
+	snprintf(histogram->name, sizeof(histogram->name), "%s", name);
+
+	for(i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		atomic_init(&histogram->counts[i], 0);
+	}
+
+	atomic_init(&histogram->total, 0);
+	atomic_init(&histogram->sum, 0);
+	atomic_init(&histogram->max, 0);
+}
+
+void latencyHistogramRecord(latencyHistogram_t* histogram, uint64_t nanoseconds)
+{
+	uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+
+	atomic_fetch_add_explicit(&histogram->counts[bucketIndex(nanoseconds)], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&histogram->total, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&histogram->sum, nanoseconds, memory_order_relaxed);
+
+	/* Raise the maximum unless another writer already raised it further */
+	while((nanoseconds > max) && !atomic_compare_exchange_weak_explicit(&histogram->max, &max, nanoseconds, memory_order_relaxed, memory_order_relaxed));
+}
+
+void latencyHistogramMerge(latencyHistogram_t* histogram, latencyHistogram_t* other)
+{
+	uint64_t max = atomic_load_explicit(&other->max, memory_order_relaxed);
+	uint32_t i;
+
+	/* Values recorded by another writer (e.g. one per thread), added to ours */
+	for(i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		atomic_fetch_add_explicit(&histogram->counts[i], atomic_load_explicit(&other->counts[i], memory_order_relaxed), memory_order_relaxed);
+	}
+
+	atomic_fetch_add_explicit(&histogram->total, atomic_load_explicit(&other->total, memory_order_relaxed), memory_order_relaxed);
+	atomic_fetch_add_explicit(&histogram->sum, atomic_load_explicit(&other->sum, memory_order_relaxed), memory_order_relaxed);
+
+	if(max > atomic_load_explicit(&histogram->max, memory_order_relaxed))
+	{
+		atomic_store_explicit(&histogram->max, max, memory_order_relaxed);
+	}
+}
+
+uint64_t latencyHistogramPercentile(latencyHistogram_t* histogram, double percentile)
+{
+	uint64_t total = atomic_load_explicit(&histogram->total, memory_order_relaxed);
+	uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+	uint64_t target, seen = 0;
+	uint32_t i;
+
+	if(total == 0)
+	{
+		return 0;
+	}
+
+	/* Rank of the value below which percentile % of the values lie */
+	target = (uint64_t) ((percentile / 100.0) * (double) total);
+	if(target == 0)
+	{
+		target = 1;
+	}
+
+	for(i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		seen += atomic_load_explicit(&histogram->counts[i], memory_order_relaxed);
+
+		if(seen >= target)
+		{
+			/* Report the bucket's highest value, never more than the real maximum */
+			return (bucketHighest(i) < max) ? bucketHighest(i) : max;
+		}
+	}
+
+	/* Counts still being updated by a writer */
+	return max;
+}
+
+uint64_t latencyHistogramCumulative(latencyHistogram_t* histogram, const uint64_t* bounds, uint64_t* counts, uint32_t boundsCount)
+{
+	uint64_t seen = 0;
+	uint32_t i, bound = 0;
+
+	/* One pass over the buckets (bounds ascending): counts[] and the total agree even while writers record */
+	for(i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		/* A bucket is below a bound when its highest value is */
+		while((bound < boundsCount) && (bucketHighest(i) > bounds[bound]))
+		{
+			counts[bound++] = seen;
+		}
+
+		seen += atomic_load_explicit(&histogram->counts[i], memory_order_relaxed);
+	}
+
+	while(bound < boundsCount)
+	{
+		counts[bound++] = seen;
+	}
+
+	return seen;
+}
+
+void latencyHistogramPrint(latencyHistogram_t* histogram)
+{
+	printf("LATENCY %s: %llu frames, p50 %.1f us, p99 %.1f us, p999 %.1f us, max %.1f us.\r\n",
+		histogram->name,
+		(unsigned long long) atomic_load_explicit(&histogram->total, memory_order_relaxed),
+		latencyHistogramPercentile(histogram, 50.0) / 1000.0,
+		latencyHistogramPercentile(histogram, 99.0) / 1000.0,
+		latencyHistogramPercentile(histogram, 99.9) / 1000.0,
+		atomic_load_explicit(&histogram->max, memory_order_relaxed) / 1000.0);
+}
+
+/********************** End of File ******************************************/
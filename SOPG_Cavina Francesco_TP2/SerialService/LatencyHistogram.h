@@ -0,0 +1,49 @@
+/*
+ * @file   : LatencyHistogram.h
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+/********************** Inclusions *******************************************/
+#include <stdint.h>
+#include <stdatomic.h>
+
+/********************** Macros ***********************************************/
+#define LATENCY_SUB_BUCKET_BITS			(5)
+#define LATENCY_SUB_BUCKETS			(1u << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_BUCKETS				((65 - LATENCY_SUB_BUCKET_BITS) * LATENCY_SUB_BUCKETS)
+#define LATENCY_NAME_SIZE			(64)
+
+/********************** Typedef **********************************************/
+/*
+ * Log-linear (HDR style) histogram of latencies in nanoseconds. Every power
+ * of two is split in LATENCY_SUB_BUCKETS linear buckets, so any value is
+ * known within ~3% whatever its magnitude. Recording is a few relaxed atomic
+ * adds: writers never lock and the histogram can be printed while they run.
+ */
+typedef struct
+{
+	char name[LATENCY_NAME_SIZE];
+	_Atomic uint64_t counts[LATENCY_BUCKETS];
+	_Atomic uint64_t total;			// Values recorded
+	_Atomic uint64_t sum;			// Of every value recorded (ns)
+	_Atomic uint64_t max;			// Highest value recorded (ns)
+} latencyHistogram_t;
+
+/********************** External Data Declaration ****************************/
+
+/********************** External Functions Declaration ***********************/
+uint64_t latencyNow(void);
+void latencyHistogramInit(latencyHistogram_t* histogram, const char* name);
+void latencyHistogramRecord(latencyHistogram_t* histogram, uint64_t nanoseconds);
+uint64_t latencyHistogramPercentile(latencyHistogram_t* histogram, double percentile);
+void latencyHistogramMerge(latencyHistogram_t* histogram, latencyHistogram_t* other);
+uint64_t latencyHistogramCumulative(latencyHistogram_t* histogram, const uint64_t* bounds, uint64_t* counts, uint32_t boundsCount);
+void latencyHistogramPrint(latencyHistogram_t* histogram);
+
+#endif /* LATENCY_HISTOGRAM_H */
+
+/********************** End of File ******************************************/
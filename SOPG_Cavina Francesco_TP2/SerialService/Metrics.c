@@ -0,0 +1,427 @@
+/*
+ * @file   : Metrics.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "Metrics.h"
+
+/********************** Macros and Definitions *******************************/
+#define METRICS_BUFFER_CHUNK			(4096)
+#define METRICS_HEADER_SIZE			(256)
+#define METRICS_CONTENT_TYPE			("text/plain; version=0.0.4; charset=utf-8")
+#define NANOSECONDS_PER_SECOND			(1e9)
+#define LATENCY_BOUNDS				(sizeof(latencyBounds) / sizeof(latencyBounds[0]))
+
+/********************** Internal Data Declaration ****************************/
+
+/********************** Internal Functions Declaration ***********************/
+static void* thread_metrics(void* arg);
+static void metricsServe(int sock);
+static void metricsRespond(int sock, const char* status, const char* content, size_t length);
+static int writeAll(int sock, const void* data, size_t length);
+static bool addressIsUnix(const char* address);
+
+/********************** Internal Data Definition *****************************/
+static pthread_t ThreadHandle_metrics;				// Thread handler
+static bool running = false;
+static int listenFd = -1;					// Scrapes are accepted here
+static int stopFd = -1;						// Thread wakeup: stop
+static metricsRender_t renderFunction = NULL;			// Writes every metric of the service
+static metricsBuffer_t page;					// Reused by every scrape
+
+/* Latency histogram buckets (ns), exported in seconds */
+static const uint64_t latencyBounds[] =
+{
+	1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+	1000000, 2500000, 5000000, 10000000, 25000000, 50000000, 100000000, 250000000, 500000000,
+	1000000000
+};
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+static void* thread_metrics(void* arg)
+{
+	struct pollfd fds[2];
+	int sock;
+
+	fds[0].fd = listenFd;
+	fds[0].events = POLLIN;
+	fds[1].fd = stopFd;
+	fds[1].events = POLLIN;
+
+	/* One scrape at a time, never on a forwarding thread */
+	while(1)
+	{
+		if(poll(fds, 2, -1) == -1)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+
+			perror("ERROR metrics poll() API");
+			break;
+		}
+
+		if(fds[1].revents != 0)
+		{
+			break;
+		}
+
+		/* Non-blocking listener: the process it is shared with during a hot restart may have taken the scrape */
+		if((sock = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC)) == -1)
+		{
+			continue;
+		}
+
+		metricsServe(sock);
+		close(sock);
+	}
+
+	return NULL;
+}
+
+static void metricsServe(int sock)
+{
+	struct timeval timeout = { .tv_sec = METRICS_TIMEOUT_MS / 1000, .tv_usec = (METRICS_TIMEOUT_MS % 1000) * 1000 };
+	char request[METRICS_REQUEST_SIZE];
+	size_t length = 0;
+	ssize_t bytes;
+
+	/* A stuck scraper holds this thread for METRICS_TIMEOUT_MS at most */
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	/* Headers end with an empty line, a GET has no body */
+	while((length < (sizeof(request) - 1)) && (memmem(request, length, "\r\n\r\n", 4) == NULL))
+	{
+		if((bytes = read(sock, &request[length], sizeof(request) - 1 - length)) <= 0)
+		{
+			return;
+		}
+
+		length += (size_t) bytes;
+	}
+
+	request[length] = '\0';
+
+	if(strncmp(request, "GET ", 4) != 0)
+	{
+		metricsRespond(sock, "405 Method Not Allowed", "GET only.\n", 10);
+		return;
+	}
+
+	if((strncmp(&request[4], "/metrics ", 9) != 0) && (strncmp(&request[4], "/metrics?", 9) != 0))
+	{
+		metricsRespond(sock, "404 Not Found", "See /metrics.\n", 14);
+		return;
+	}
+
+	/* The whole page is rendered before sending: every counter is read within a few microseconds */
+	page.length = 0;
+	page.failed = false;
+	renderFunction(&page);
+
+	if(page.failed)
+	{
+		metricsRespond(sock, "500 Internal Server Error", "Out of memory.\n", 15);
+		return;
+	}
+
+	metricsRespond(sock, "200 OK", page.data, page.length);
+}
+
+static void metricsRespond(int sock, const char* status, const char* content, size_t length)
+{
+	char header[METRICS_HEADER_SIZE];
+	int size;
+
+	size = snprintf(header, sizeof(header), "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", status, METRICS_CONTENT_TYPE, length);
+
+	if(writeAll(sock, header, (size_t) size) == 0)
+	{
+		writeAll(sock, content, length);
+	}
+}
+
+static int writeAll(int sock, const void* data, size_t length)
+{
+	const uint8_t* next = data;
+	ssize_t bytes;
+
+	while(length > 0)
+	{
+		if((bytes = send(sock, next, length, MSG_NOSIGNAL)) == -1)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+
+			return -1;
+		}
+
+		next += bytes;
+		length -= (size_t) bytes;
+	}
+
+	return 0;
+}
+
+static bool addressIsUnix(const char* address)
+{
+	/* PORT or IP:PORT, anything with a slash is a unix socket path */
+	return (strchr(address, '/') != NULL);
+}
+
+/********************** External Functions Definition ************************/
+int metricsListen(const char* address)
+{
+	struct sockaddr_un unixAddress;
+	struct sockaddr_in inetAddress;
+	char ip[INET_ADDRSTRLEN];
+	const char* port;
+	char* end;
+	long number;
+	int fd, reuse = 1;
+
+	if(addressIsUnix(address))
+	{
+		memset(&unixAddress, 0, sizeof(unixAddress));
+		unixAddress.sun_family = AF_UNIX;
+
+		if(strlen(address) >= sizeof(unixAddress.sun_path))
+		{
+			fprintf(stderr, "ERROR metrics socket path too long: %s\r\n", address);
+			return -1;
+		}
+
+		strcpy(unixAddress.sun_path, address);
+
+		if((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+		{
+			perror("ERROR socket(AF_UNIX) API");
+			return -1;
+		}
+
+		/* Left behind by a previous run that didn't shut down */
+		unlink(address);
+
+		if((bind(fd, (struct sockaddr*) &unixAddress, sizeof(unixAddress)) == -1) || (listen(fd, 4) == -1))
+		{
+			fprintf(stderr, "ERROR metrics socket %s: %s\r\n", address, strerror(errno));
+			close(fd);
+			return -1;
+		}
+
+		return fd;
+	}
+
+	/* Loopback unless an IP is given */
+	if((port = strrchr(address, ':')) != NULL)
+	{
+		snprintf(ip, sizeof(ip), "%.*s", (int) (port - address), address);
+		port++;
+	}
+	else
+	{
+		snprintf(ip, sizeof(ip), "%s", METRICS_DEFAULT_IP);
+		port = address;
+	}
+
+	number = strtol(port, &end, 10);
+
+	memset(&inetAddress, 0, sizeof(inetAddress));
+	inetAddress.sin_family = AF_INET;
+	inetAddress.sin_port = htons((uint16_t) number);
+
+	if((*port == '\0') || (*end != '\0') || (number <= 0) || (number > 65535) || (inet_pton(AF_INET, ip, &inetAddress.sin_addr) <= 0))
+	{
+		fprintf(stderr, "ERROR invalid metrics address: %s\r\n", address);
+		return -1;
+	}
+
+	if((fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+	{
+		perror("ERROR socket(AF_INET) API");
+		return -1;
+	}
+
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	if((bind(fd, (struct sockaddr*) &inetAddress, sizeof(inetAddress)) == -1) || (listen(fd, 4) == -1))
+	{
+		fprintf(stderr, "ERROR metrics address %s: %s\r\n", address, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int metricsStart(int listen_fd, metricsRender_t render)
+{
+	int result;
+
+	if((stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+	{
+		perror("ERROR eventfd() API");
+		return -1;
+	}
+
+	listenFd = listen_fd;
+	renderFunction = render;
+
+	if((result = pthread_create(&ThreadHandle_metrics, NULL, thread_metrics, NULL)) != 0)
+	{
+		fprintf(stderr, "ERROR pthread_create() API: %s\r\n", strerror(result));
+		close(stopFd);
+		stopFd = -1;
+		return -1;
+	}
+
+	running = true;
+
+	return 0;
+}
+
+void metricsStop(void)
+{
+	uint64_t one = 1;
+
+	if(!running)
+	{
+		return;
+	}
+
+	/* The listener stays open: it is closed by its owner or handed over */
+	if(write(stopFd, &one, sizeof(one)) == -1)
+	{
+		perror("ERROR metrics stop");
+	}
+
+	pthread_join(ThreadHandle_metrics, NULL);
+	running = false;
+
+	close(stopFd);
+	stopFd = -1;
+
+	free(page.data);
+	memset(&page, 0, sizeof(page));
+}
+
+void metricsClose(int listen_fd, const char* address)
+{
+	close(listen_fd);
+
+	if(addressIsUnix(address))
+	{
+		unlink(address);
+	}
+}
+
+void metricsPrint(metricsBuffer_t* buffer, const char* format, ...)
+{
+	va_list arguments;
+	size_t capacity;
+	char* data;
+	int length;
+
+	if(buffer->failed)
+	{
+		return;
+	}
+
+	while(1)
+	{
+		va_start(arguments, format);
+		length = vsnprintf(&buffer->data[buffer->length], buffer->capacity - buffer->length, format, arguments);
+		va_end(arguments);
+
+		if(length < 0)
+		{
+			buffer->failed = true;
+			return;
+		}
+
+		if((buffer->length + (size_t) length) < buffer->capacity)
+		{
+			buffer->length += (size_t) length;
+			return;
+		}
+
+		/* Grown once per chunk, then reused by the next scrapes */
+		capacity = buffer->capacity + METRICS_BUFFER_CHUNK + (size_t) length;
+
+		if((data = realloc(buffer->data, capacity)) == NULL)
+		{
+			buffer->failed = true;
+			return;
+		}
+
+		buffer->data = data;
+		buffer->capacity = capacity;
+	}
+}
+
+void metricsHeader(metricsBuffer_t* buffer, const char* name, const char* type, const char* help)
+{
+	metricsPrint(buffer, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metricsValue(metricsBuffer_t* buffer, const char* name, const char* labels, uint64_t value)
+{
+	if(labels == NULL)
+	{
+		metricsPrint(buffer, "%s %llu\n", name, (unsigned long long) value);
+	}
+	else
+	{
+		metricsPrint(buffer, "%s{%s} %llu\n", name, labels, (unsigned long long) value);
+	}
+}
+
+void metricsHistogram(metricsBuffer_t* buffer, const char* name, const char* labels, latencyHistogram_t* histogram)
+{
+	const char* separator = (labels == NULL) ? "" : ",";
+	uint64_t counts[LATENCY_BOUNDS];
+	uint64_t total;
+	uint32_t i;
+
+	/* Histogram without labels of its own: only le */
+	labels = (labels == NULL) ? "" : labels;
+
+	/* Cumulative buckets, +Inf and _count come from the same pass so they always agree */
+	total = latencyHistogramCumulative(histogram, latencyBounds, counts, LATENCY_BOUNDS);
+
+	for(i = 0; i < LATENCY_BOUNDS; i++)
+	{
+		metricsPrint(buffer, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, separator, (double) latencyBounds[i] / NANOSECONDS_PER_SECOND, (unsigned long long) counts[i]);
+	}
+
+	metricsPrint(buffer, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, separator, (unsigned long long) total);
+	metricsPrint(buffer, "%s_sum{%s} %.9f\n", name, labels, (double) atomic_load_explicit(&histogram->sum, memory_order_relaxed) / NANOSECONDS_PER_SECOND);
+	metricsPrint(buffer, "%s_count{%s} %llu\n", name, labels, (unsigned long long) total);
+}
+
+/********************** End of File ******************************************/
@@ -0,0 +1,73 @@
+/*
+ * @file   : Metrics.h
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+/********************** Inclusions *******************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "FrameQueue.h"
+#include "LatencyHistogram.h"
+
+/********************** Macros ***********************************************/
+#define METRICS_DEFAULT_IP			("127.0.0.1")
+#define METRICS_REQUEST_SIZE			(1024)
+#define METRICS_TIMEOUT_MS			(1000)
+
+/********************** Typedef **********************************************/
+/*
+ * Counters of one forwarding direction. They are only ever added to with
+ * relaxed atomics by the thread that owns that side of the bridge, so a
+ * scrape reads them without taking any mutex and without stopping anyone.
+ * The source and destination sides live on their own cache lines, they are
+ * written by different threads in threads mode.
+ */
+typedef struct
+{
+	_Alignas(CACHE_LINE_SIZE) _Atomic uint64_t framesReceived;	// Complete frames parsed from the source
+	_Atomic uint64_t bytesReceived;
+	_Atomic uint64_t parseErrors;					// Malformed or oversized frames discarded
+	_Atomic uint64_t dropped;					// Frames lost because a queue was full
+	_Atomic uint64_t unroutable;					// Frames whose channel has no route to the other side
+	_Alignas(CACHE_LINE_SIZE) _Atomic uint64_t framesSent;		// Frames written whole to the destination (once per client)
+	_Atomic uint64_t bytesSent;
+	_Atomic uint64_t coalesced;					// Frames overwritten by a newer value while the destination was backed up
+} metricsDirection_t;
+
+/* Prometheus text being rendered for a scrape */
+typedef struct
+{
+	char* data;
+	size_t length;
+	size_t capacity;
+	bool failed;				// Out of memory, the scrape gets a 500
+} metricsBuffer_t;
+
+/* Called by the metrics thread for every scrape, must not lock anything the forwarding path holds */
+typedef void (*metricsRender_t)(metricsBuffer_t* buffer);
+
+/********************** External Data Declaration ****************************/
+
+/********************** External Functions Declaration ***********************/
+/* Endpoint */
+int metricsListen(const char* address);
+int metricsStart(int listen_fd, metricsRender_t render);
+void metricsStop(void);
+void metricsClose(int listen_fd, const char* address);
+
+/* Rendering (metrics thread) */
+void metricsPrint(metricsBuffer_t* buffer, const char* format, ...) __attribute__((format(printf, 2, 3)));
+void metricsHeader(metricsBuffer_t* buffer, const char* name, const char* type, const char* help);
+void metricsValue(metricsBuffer_t* buffer, const char* name, const char* labels, uint64_t value);
+void metricsHistogram(metricsBuffer_t* buffer, const char* name, const char* labels, latencyHistogram_t* histogram);
+
+#endif /* METRICS_H */
+
+/********************** End of File ******************************************/
@@ -0,0 +1,213 @@
+/*
+ * @file   : RealTime.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "RealTime.h"
+#include "LatencyHistogram.h"
+
+/********************** Macros and Definitions *******************************/
+#define NANOSECONDS_PER_SECOND			(1000000000ULL)
+
+/********************** Internal Data Declaration ****************************/
+
+/********************** Internal Functions Declaration ***********************/
+static void stackPrefault(void);
+static void jitterMeasure(const char* name, int cpu, int priority);
+
+/********************** Internal Data Definition *****************************/
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+static __attribute__((noinline)) void stackPrefault(void)
+{
+	volatile uint8_t stack[REAL_TIME_STACK_PREFAULT];
+	uint32_t i;
+
+	/* One write per page: the pages the forwarding path will use are mapped (and locked) from now on */
+	for(i = 0; i < sizeof(stack); i += 4096)
+	{
+		stack[i] = 0;
+	}
+}
+
+static void jitterMeasure(const char* name, int cpu, int priority)
+{
+	latencyHistogram_t jitter;
+	struct timespec wakeup;
+	uint64_t due;
+	uint32_t i;
+	char where[32];
+
+	latencyHistogramInit(&jitter, name);
+
+	/* How late this thread wakes up from a timed sleep, with the scheduling it will forward frames with */
+	for(i = 0; i < REAL_TIME_JITTER_SAMPLES; i++)
+	{
+		due = latencyNow() + (REAL_TIME_JITTER_PERIOD_US * 1000ULL);
+		wakeup.tv_sec = (time_t) (due / NANOSECONDS_PER_SECOND);
+		wakeup.tv_nsec = (long) (due % NANOSECONDS_PER_SECOND);
+
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, NULL) == EINTR);
+
+		latencyHistogramRecord(&jitter, latencyNow() - due);
+	}
+
+	if(cpu == REAL_TIME_CPU_ANY)
+	{
+		snprintf(where, sizeof(where), "any CPU");
+	}
+	else
+	{
+		snprintf(where, sizeof(where), "CPU %d", cpu);
+	}
+
+	printf("JITTER %s (%s, %s %d): %u wakeups, p50 %.1f us, p99 %.1f us, p999 %.1f us, max %.1f us.\r\n",
+		name, where, (priority > 0) ? "SCHED_FIFO" : "SCHED_OTHER", priority, REAL_TIME_JITTER_SAMPLES,
+		latencyHistogramPercentile(&jitter, 50.0) / 1000.0,
+		latencyHistogramPercentile(&jitter, 99.0) / 1000.0,
+		latencyHistogramPercentile(&jitter, 99.9) / 1000.0,
+		atomic_load_explicit(&jitter.max, memory_order_relaxed) / 1000.0);
+}
+
+/********************** External Functions Definition ************************/
+void realTimeInit(realTimeConfig_t* config)
+{
+	uint32_t i;
+
+	for(i = 0; i < REAL_TIME_THREADS_MAX; i++)
+	{
+		config->cpus[i] = REAL_TIME_CPU_ANY;
+	}
+
+	config->cpusCount = 0;
+	config->priority = 0;
+	config->lockMemory = false;
+	config->measureJitter = false;
+}
+
+int realTimeParseCpus(realTimeConfig_t* config, const char* list)
+{
+	const char* next = list;
+	char* end;
+	long cpu;
+
+	config->cpusCount = 0;
+
+	/* Comma separated CPU numbers, one per thread */
+	while((*next != '\0') && (config->cpusCount < REAL_TIME_THREADS_MAX))
+	{
+		cpu = strtol(next, &end, 10);
+
+		if((end == next) || (cpu < 0) || (cpu >= CPU_SETSIZE) || ((*end != ',') && (*end != '\0')))
+		{
+			return -1;
+		}
+
+		config->cpus[config->cpusCount++] = (int) cpu;
+		next = (*end == ',') ? (end + 1) : end;
+	}
+
+	if((config->cpusCount == 0) || (*next != '\0'))
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+bool realTimeEnabled(const realTimeConfig_t* config)
+{
+	return ((config->cpusCount > 0) || (config->priority > 0) || config->lockMemory);
+}
+
+int realTimeLockMemory(void)
+{
+	/* Everything mapped now and later (queues, thread stacks) stays in RAM */
+	if(mlockall(MCL_CURRENT | MCL_FUTURE) == -1)
+	{
+		perror("WARNING mlockall() API");
+		return -1;
+	}
+
+	return 0;
+}
+
+void realTimeThreadInit(const realTimeConfig_t* config, uint32_t index, const char* name)
+{
+	struct sched_param param;
+	cpu_set_t set;
+	int cpu = REAL_TIME_CPU_ANY, result;
+
+	if(!realTimeEnabled(config) && !config->measureJitter)
+	{
+		return;
+	}
+
+	/* Shorter list: the remaining threads share the last CPU */
+	if(config->cpusCount > 0)
+	{
+		cpu = config->cpus[(index < config->cpusCount) ? index : (config->cpusCount - 1)];
+	}
+
+	if(cpu != REAL_TIME_CPU_ANY)
+	{
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+
+		if((result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0)
+		{
+			fprintf(stderr, "WARNING %s not pinned to CPU %d: %s\r\n", name, cpu, strerror(result));
+			cpu = REAL_TIME_CPU_ANY;
+		}
+	}
+
+	/* Without CAP_SYS_NICE (or an RLIMIT_RTPRIO) the thread keeps forwarding under SCHED_OTHER */
+	if(config->priority > 0)
+	{
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = config->priority;
+
+		if((result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) != 0)
+		{
+			fprintf(stderr, "WARNING %s not running SCHED_FIFO %d: %s\r\n", name, config->priority, strerror(result));
+		}
+	}
+
+	stackPrefault();
+
+	if(config->measureJitter)
+	{
+		pthread_getschedparam(pthread_self(), &result, &param);
+		jitterMeasure(name, cpu, (result == SCHED_FIFO) ? param.sched_priority : 0);
+	}
+}
+
+uint64_t realTimePageFaults(void)
+{
+	struct rusage usage;
+
+	/* Calling thread only, minor and major */
+	if(getrusage(RUSAGE_THREAD, &usage) == -1)
+	{
+		return 0;
+	}
+
+	return (uint64_t) usage.ru_minflt + (uint64_t) usage.ru_majflt;
+}
+
+/********************** End of File ******************************************/
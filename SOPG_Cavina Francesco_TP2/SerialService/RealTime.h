@@ -0,0 +1,51 @@
+/*
+ * @file   : RealTime.h
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+#ifndef REAL_TIME_H
+#define REAL_TIME_H
+
+/********************** Inclusions *******************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************** Macros ***********************************************/
+#define REAL_TIME_THREADS_MAX			(64)
+#define REAL_TIME_CPU_ANY			(-1)
+#define REAL_TIME_STACK_PREFAULT		(256 * 1024)
+#define REAL_TIME_JITTER_SAMPLES		(1000)
+#define REAL_TIME_JITTER_PERIOD_US		(100)
+
+/********************** Typedef **********************************************/
+/*
+ * How the forwarding threads are scheduled. cpus[] is in thread order (the
+ * event loop only uses the first entry); a shorter list repeats its last
+ * CPU. Every thread applies its own entry when it starts, see
+ * realTimeThreadInit(). measureJitter also has every thread time 1000 sleeps
+ * of 100 us first (0.1 s before it forwards anything), so it is off unless
+ * asked for.
+ */
+typedef struct
+{
+	int cpus[REAL_TIME_THREADS_MAX];	// CPU per thread, REAL_TIME_CPU_ANY leaves it unpinned
+	uint32_t cpusCount;			// Entries given
+	int priority;				// SCHED_FIFO priority, 0 keeps SCHED_OTHER
+	bool lockMemory;			// mlockall() at startup
+	bool measureJitter;			// Report each thread's wakeup jitter when it starts
+} realTimeConfig_t;
+
+/********************** External Data Declaration ****************************/
+
+/********************** External Functions Declaration ***********************/
+void realTimeInit(realTimeConfig_t* config);
+int realTimeParseCpus(realTimeConfig_t* config, const char* list);
+bool realTimeEnabled(const realTimeConfig_t* config);
+int realTimeLockMemory(void);
+void realTimeThreadInit(const realTimeConfig_t* config, uint32_t index, const char* name);
+uint64_t realTimePageFaults(void);
+
+#endif /* REAL_TIME_H */
+
+/********************** End of File ******************************************/
@@ -0,0 +1,343 @@
+/*
+ * @file   : Router.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "Router.h"
+
+/********************** Macros and Definitions *******************************/
+
+/********************** Internal Data Declaration ****************************/
+/* One line of a routes file: count channels from global on, from local on at link */
+typedef struct
+{
+	uint32_t global;
+	uint32_t link;
+	uint32_t local;
+	uint32_t count;
+} routerRange_t;
+
+/********************** Internal Functions Declaration ***********************/
+static int routerAllocate(uint32_t links, uint32_t channels, const uint32_t* linkChannels);
+static int routerMap(uint32_t global, uint32_t link, uint32_t local);
+static int routerParse(FILE* file, const char* path, uint32_t links, routerRange_t** ranges, uint32_t* rangesCount, uint32_t* linkChannels, uint32_t* channels);
+
+/********************** Internal Data Definition *****************************/
+static routerEntry_t* globals = NULL;		// Link and local channel of every global channel
+static uint32_t** locals = NULL;		// Per link: global channel of every local one
+static uint32_t* localsCount = NULL;		// Per link: local channels
+static uint32_t linksCount = 0;
+static uint32_t channelsCount = 0;
+static bool identity = true;			// One link without a routes file: frames go through untouched
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+static int routerAllocate(uint32_t links, uint32_t channels, const uint32_t* linkChannels)
+{
+	uint32_t i;
+
+	routerDeinit();
+
+	globals = malloc(channels * sizeof(routerEntry_t));
+	locals = calloc(links, sizeof(uint32_t*));
+	localsCount = calloc(links, sizeof(uint32_t));
+
+	if((globals == NULL) || (locals == NULL) || (localsCount == NULL))
+	{
+		perror("ERROR malloc() API");
+		return -1;
+	}
+
+	linksCount = links;
+	channelsCount = channels;
+
+	/* Nothing routed until mapped: 0xFF... is ROUTER_NONE */
+	memset(globals, 0xFF, channels * sizeof(routerEntry_t));
+
+	for(i = 0; i < links; i++)
+	{
+		localsCount[i] = linkChannels[i];
+
+		if((locals[i] = malloc((linkChannels[i] + 1) * sizeof(uint32_t))) == NULL)
+		{
+			perror("ERROR malloc() API");
+			return -1;
+		}
+
+		memset(locals[i], 0xFF, (linkChannels[i] + 1) * sizeof(uint32_t));
+	}
+
+	return 0;
+}
+
+static int routerMap(uint32_t global, uint32_t link, uint32_t local)
+{
+	/* A channel has one place on each side */
+	if((globals[global].link != ROUTER_NONE) || (locals[link][local] != ROUTER_NONE))
+	{
+		return -1;
+	}
+
+	globals[global].link = link;
+	globals[global].local = local;
+	locals[link][local] = global;
+
+	return 0;
+}
+
+static int routerParse(FILE* file, const char* path, uint32_t links, routerRange_t** ranges, uint32_t* rangesCount, uint32_t* linkChannels, uint32_t* channels)
+{
+	routerRange_t* grown;
+	routerRange_t range;
+	uint32_t capacity = 0, line = 0;
+	char text[ROUTER_LINE_SIZE];
+	int fields;
+
+	/* "GLOBAL LINK LOCAL [COUNT]" per line, '#' starts a comment */
+	while(fgets(text, sizeof(text), file) != NULL)
+	{
+		line++;
+		text[strcspn(text, "#\r\n")] = '\0';
+		range.count = 1;
+
+		if((fields = sscanf(text, "%u %u %u %u", &range.global, &range.link, &range.local, &range.count)) <= 0)
+		{
+			continue;
+		}
+
+		if((fields < 3) || (range.link >= links) || (range.count == 0) || (((uint64_t) range.global + range.count) > ROUTER_CHANNELS_MAX) || (((uint64_t) range.local + range.count) > ROUTER_CHANNELS_MAX))
+		{
+			fprintf(stderr, "ERROR routes %s line %u: expected GLOBAL LINK LOCAL [COUNT], LINK below %u.\r\n", path, line, links);
+			return -1;
+		}
+
+		if(*rangesCount == capacity)
+		{
+			capacity = (capacity == 0) ? 16 : capacity * 2;
+
+			if((grown = realloc(*ranges, capacity * sizeof(routerRange_t))) == NULL)
+			{
+				perror("ERROR realloc() API");
+				return -1;
+			}
+
+			*ranges = grown;
+		}
+
+		(*ranges)[(*rangesCount)++] = range;
+
+		/* Both sides are sized by the highest channel routed */
+		*channels = ((range.global + range.count) > *channels) ? (range.global + range.count) : *channels;
+		linkChannels[range.link] = ((range.local + range.count) > linkChannels[range.link]) ? (range.local + range.count) : linkChannels[range.link];
+	}
+
+	return 0;
+}
+
+/********************** External Functions Definition ************************/
+int routerInit(uint32_t links, uint32_t linkChannels)
+{
+	uint32_t* channels;
+	uint32_t i, j;
+	int result;
+
+	if((links == 0) || (linkChannels == 0) || (((uint64_t) links * linkChannels) > ROUTER_CHANNELS_MAX))
+	{
+		fprintf(stderr, "ERROR %u links of %u channels don't fit in %u channels.\r\n", links, linkChannels, ROUTER_CHANNELS_MAX);
+		return -1;
+	}
+
+	if((channels = malloc(links * sizeof(uint32_t))) == NULL)
+	{
+		perror("ERROR malloc() API");
+		return -1;
+	}
+
+	for(i = 0; i < links; i++)
+	{
+		channels[i] = linkChannels;
+	}
+
+	result = routerAllocate(links, links * linkChannels, channels);
+	free(channels);
+
+	if(result != 0)
+	{
+		return -1;
+	}
+
+	/* Contiguous ranges: link 0 has the first linkChannels global channels, link 1 the next ones... */
+	for(i = 0; i < links; i++)
+	{
+		for(j = 0; j < linkChannels; j++)
+		{
+			routerMap((i * linkChannels) + j, i, j);
+		}
+	}
+
+	identity = (links == 1);
+
+	return 0;
+}
+
+int routerLoad(const char* path, uint32_t links)
+{
+	routerRange_t* ranges = NULL;
+	uint32_t* linkChannels;
+	uint32_t rangesCount = 0, channels = 0, i, j;
+	int result;
+	FILE* file;
+
+	if((file = fopen(path, "r")) == NULL)
+	{
+		fprintf(stderr, "ERROR routes %s: %s\r\n", path, strerror(errno));
+		return -1;
+	}
+
+	if((linkChannels = calloc(links, sizeof(uint32_t))) == NULL)
+	{
+		perror("ERROR calloc() API");
+		fclose(file);
+		return -1;
+	}
+
+	result = routerParse(file, path, links, &ranges, &rangesCount, linkChannels, &channels);
+	fclose(file);
+
+	if((result == 0) && ((rangesCount == 0) || (routerAllocate(links, channels, linkChannels) != 0)))
+	{
+		fprintf(stderr, "ERROR routes %s: no channel routed.\r\n", path);
+		result = -1;
+	}
+
+	for(i = 0; (result == 0) && (i < rangesCount); i++)
+	{
+		for(j = 0; (result == 0) && (j < ranges[i].count); j++)
+		{
+			if((result = routerMap(ranges[i].global + j, ranges[i].link, ranges[i].local + j)) != 0)
+			{
+				fprintf(stderr, "ERROR routes %s: channel %u or link %u channel %u routed twice.\r\n", path, ranges[i].global + j, ranges[i].link, ranges[i].local + j);
+			}
+		}
+	}
+
+	free(ranges);
+	free(linkChannels);
+
+	/* Even with one link: the file may renumber its channels */
+	identity = false;
+
+	return result;
+}
+
+void routerDeinit(void)
+{
+	uint32_t i;
+
+	for(i = 0; (locals != NULL) && (i < linksCount); i++)
+	{
+		free(locals[i]);
+	}
+
+	free(globals);
+	free(locals);
+	free(localsCount);
+	globals = NULL;
+	locals = NULL;
+	localsCount = NULL;
+	linksCount = 0;
+	channelsCount = 0;
+}
+
+bool routerIdentity(void)
+{
+	return identity;
+}
+
+uint32_t routerChannels(void)
+{
+	return channelsCount;
+}
+
+uint32_t routerLinkChannels(uint32_t link)
+{
+	return (link < linksCount) ? localsCount[link] : 0;
+}
+
+bool routerToLink(uint32_t global, uint32_t* link, uint32_t* local)
+{
+	if((global >= channelsCount) || (globals[global].link == ROUTER_NONE))
+	{
+		return false;
+	}
+
+	*link = globals[global].link;
+	*local = globals[global].local;
+
+	return true;
+}
+
+uint32_t routerToGlobal(uint32_t link, uint32_t local)
+{
+	if((link >= linksCount) || (local >= localsCount[link]))
+	{
+		return ROUTER_NONE;
+	}
+
+	return locals[link][local];
+}
+
+const char* routerFrameToLink(const char* frame, uint32_t* length, uint32_t* link, char* buffer)
+{
+	frameFields_t fields;
+	uint32_t local;
+
+	/* Single controller: no lookup, no copy */
+	if(identity)
+	{
+		*link = 0;
+		return frame;
+	}
+
+	if(!frameDecode(frame, *length, &fields) || !routerToLink(fields.channel, link, &local))
+	{
+		return NULL;
+	}
+
+	/* A sequence number rides along untouched */
+	fields.channel = local;
+	*length = frameEncodeFields(buffer, &fields);
+
+	return (*length > 0) ? buffer : NULL;
+}
+
+const char* routerFrameToGlobal(uint32_t link, const char* frame, uint32_t* length, char* buffer)
+{
+	frameFields_t fields;
+	uint32_t global;
+
+	if(identity)
+	{
+		return frame;
+	}
+
+	if(!frameDecode(frame, *length, &fields) || ((global = routerToGlobal(link, fields.channel)) == ROUTER_NONE))
+	{
+		return NULL;
+	}
+
+	fields.channel = global;
+	*length = frameEncodeFields(buffer, &fields);
+
+	return (*length > 0) ? buffer : NULL;
+}
+
+/********************** End of File ******************************************/
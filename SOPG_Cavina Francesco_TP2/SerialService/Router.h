@@ -0,0 +1,55 @@
+/*
+ * @file   : Router.h
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+#ifndef ROUTER_H
+#define ROUTER_H
+
+/********************** Inclusions *******************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FrameQueue.h"
+#include "FrameParser.h"
+
+/********************** Macros ***********************************************/
+#define ROUTER_DEFAULT_LINK_CHANNELS		(64)
+#define ROUTER_CHANNELS_MAX			(65536)
+#define ROUTER_NONE				(UINT32_MAX)
+#define ROUTER_LINE_SIZE			(128)
+
+/********************** Typedef **********************************************/
+/*
+ * Where a global channel lives: Interface Service clients only see global
+ * channel numbers, every controller only sees its own local ones. The table
+ * is built once at startup and only read afterwards, so any thread looks a
+ * channel up without locking.
+ */
+typedef struct
+{
+	uint32_t link;				// Controller link, ROUTER_NONE if the channel isn't routed
+	uint32_t local;				// Channel number on that controller
+} routerEntry_t;
+
+/********************** External Data Declaration ****************************/
+
+/********************** External Functions Declaration ***********************/
+int routerInit(uint32_t links, uint32_t linkChannels);
+int routerLoad(const char* path, uint32_t links);
+void routerDeinit(void);
+
+bool routerIdentity(void);
+uint32_t routerChannels(void);
+uint32_t routerLinkChannels(uint32_t link);
+bool routerToLink(uint32_t global, uint32_t* link, uint32_t* local);
+uint32_t routerToGlobal(uint32_t link, uint32_t local);
+
+/* Frame rewriting, buffer is FRAME_MAX_SIZE bytes */
+const char* routerFrameToLink(const char* frame, uint32_t* length, uint32_t* link, char* buffer);
+const char* routerFrameToGlobal(uint32_t link, const char* frame, uint32_t* length, char* buffer);
+
+#endif /* ROUTER_H */
+
+/********************** End of File ******************************************/
@@ -1,64 +1,265 @@
 #include "SerialManager.h"
+#include "SerialTransport.h"
 #include <stdio.h>
-#include <sys/types.h>
-#include <sys/socket.h>
 #include <stdlib.h>
-#include <unistd.h>
-#include <errno.h>
+#include <stdint.h>
 #include <string.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <netdb.h>
-#include <fcntl.h>
-
-static int s;
-
-int serial_open(int pn,int baudrate)
-{
-   	struct sockaddr_in serveraddr,addr2;
-   	int clnt_addr_size;
-	char buf[128];
-	s = socket(PF_INET,SOCK_STREAM, 0);
-	int flags = fcntl(s, F_GETFL);
-	fcntl(s, F_SETFL, flags | O_NONBLOCK);
-    	bzero((char *) &serveraddr, sizeof(serveraddr));
-    	serveraddr.sin_family = AF_INET;
-    	serveraddr.sin_port = htons(4040);
-    	if(inet_pton(AF_INET, "127.0.0.1", &(serveraddr.sin_addr))<=0)
-    	{
-        	fprintf(stderr,"ERROR invalid server IP\r\n");
-        	return -1;
-    	}	
-
-	while(1)
-	{	
-		printf("conectando a emulador...\n");
-		int connectRes= connect(s, (const struct sockaddr *)&serveraddr, sizeof(serveraddr));
-		printf("connectRes:%d\n",connectRes);
-		if(connectRes>=0)
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+
+#define BACKOFF_FIRST_MS	10
+#define BACKOFF_MAX_MS		500
+#define CONNECT_TIMEOUT_MS	1000
+
+static const serialTransport_t* transports[] = { &serialTransportTcp, &serialTransportTermios };
+
+static uint64_t now_ms(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+static void schedule_retry(serial_t* serial)
+{
+	uint32_t jitter;
+	/* Exponential backoff with jitter: half fixed, half random, so many services don't retry in lockstep */
+	serial->backoff = (serial->backoff == 0) ? BACKOFF_FIRST_MS : serial->backoff * 2;
+	if(serial->backoff > BACKOFF_MAX_MS)
+	{
+		serial->backoff = BACKOFF_MAX_MS;
+	}
+	if(serial->seed == 0)
+	{
+		/* Links of the same service don't retry in lockstep either */
+		serial->seed = (uint32_t)now_ms() ^ (uint32_t)getpid() ^ (uint32_t)(uintptr_t)serial;
+	}
+	jitter = rand_r(&serial->seed) % (serial->backoff / 2 + 1);
+	serial->deadline = now_ms() + serial->backoff / 2 + jitter;
+	serial->state = SERIAL_DISCONNECTED;
+}
+
+static void attempt_failed(serial_t* serial)
+{
+	if(serial->s >= 0)
+	{
+		serial->transport->close(serial->s);
+		serial->s = -1;
+	}
+	schedule_retry(serial);
+}
+
+void serial_init(serial_t* serial)
+{
+	memset(serial, 0, sizeof(*serial));
+	serial->s = -1;
+	serial->transport = &serialTransportTcp;
+	serial->state = SERIAL_DISCONNECTED;
+}
+
+int serial_config(serial_t* serial,const char* name,const char* device,int flags)
+{
+	int i;
+	/* Pick the transport before serial_open(), tcp (Emulador.py) by default */
+	if(name != NULL)
+	{
+		for(i = 0; i < (int)(sizeof(transports)/sizeof(transports[0])); i++)
+		{
+			if(strcmp(name, transports[i]->name) == 0)
+			{
+				break;
+			}
+		}
+		if(i == (int)(sizeof(transports)/sizeof(transports[0])))
+		{
+			fprintf(stderr,"ERROR unknown serial transport: %s\r\n", name);
+			return -1;
+		}
+		serial->transport = transports[i];
+	}
+	serial->device = device;
+	serial->flags = flags;
+	return 0;
+}
+
+int serial_reconnect_poll(serial_t* serial)
+{
+	int res;
+
+	if(serial->state == SERIAL_DISCONNECTED)
+	{
+		if(now_ms() < serial->deadline)
 		{
-			usleep(100000);
-			break;
+			return serial->state;
 		}
-		sleep(1);
+		serial->attempts++;
+		serial->s = serial->transport->open(serial->port, serial->baudrate, serial->device, serial->flags);
+		if(serial->s < 0)
+		{
+			serial->openError = errno;
+			/* Never up since startup and the configuration itself is wrong (no such device, bad address or baudrate): retrying won't help */
+			if(serial->lostAt == 0 && (serial->openError == ENOENT || serial->openError == ENODEV || serial->openError == EINVAL))
+			{
+				serial->state = SERIAL_FAILED;
+				return serial->state;
+			}
+			/* A device that went away once it was up may come back (USB adapter replugged) */
+			schedule_retry(serial);
+			return serial->state;
+		}
+		serial->state = SERIAL_CONNECTING;
+		serial->deadline = now_ms() + CONNECT_TIMEOUT_MS;
+	}
+
+	if(serial->state == SERIAL_CONNECTING)
+	{
+		/* Transports without a handshake (tty) are connected as soon as they are open */
+		res = (serial->transport->finish != NULL) ? serial->transport->finish(serial->s) : 0;
+		if(res == 1 && now_ms() < serial->deadline)
+		{
+			return serial->state;
+		}
+		if(res != 0)
+		{
+			attempt_failed(serial);
+			return serial->state;
+		}
+		serial->state = SERIAL_CONNECTED;
+		if(serial->lostAt != 0)
+		{
+			printf("SERIAL %s: link restored after %llu ms (%u attempts).\r\n", serial_get_name(serial), (unsigned long long)(now_ms() - serial->lostAt), serial->attempts);
+		}
+		else
+		{
+			printf("Emulador conectado (%s)\n", serial_get_name(serial));
+		}
+		serial->backoff = 0;
+		serial->attempts = 0;
+	}
+
+	return serial->state;
+}
+
+int serial_open(serial_t* serial,int pn,int baudrate)
+{
+	struct pollfd pfd;
+
+	serial->port = pn;
+	serial->baudrate = baudrate;
+	serial->state = SERIAL_DISCONNECTED;
+	serial->deadline = 0;
+
+	printf("conectando a emulador (%s)...\n", serial_get_name(serial));
+
+	/* Block until connected, waiting for readiness or the next attempt instead of a fixed sleep */
+	while(serial_reconnect_poll(serial) != SERIAL_CONNECTED)
+	{
+		if(serial->state == SERIAL_FAILED)
+		{
+			return -1;
+		}
+		pfd.fd = serial->s;
+		pfd.events = POLLOUT;
+		poll(&pfd, (serial->s >= 0) ? 1 : 0, serial_get_timeout(serial));
 	}
-	printf("Emulador conectado\n");
     	return 0;
 }
 
+int serial_start(serial_t* serial,int pn,int baudrate)
+{
+	/* Like serial_open() without waiting: the first attempt is made by the next serial_reconnect_poll() */
+	serial->port = pn;
+	serial->baudrate = baudrate;
+	serial->state = SERIAL_DISCONNECTED;
+	serial->deadline = 0;
+	printf("conectando a emulador (%s)...\n", serial_get_name(serial));
+	return serial->state;
+}
 
-void serial_send(char* pData,int size)
+int serial_adopt(serial_t* serial,int pn,int baudrate,int fd)
 {
-	write(s, pData, size);
+	/* Hot restart: the previous process hands over its link, -1 if it was down */
+	serial->port = pn;
+	serial->baudrate = baudrate;
+	serial->s = fd;
+	serial->backoff = 0;
+	serial->attempts = 0;
+	if(serial->s >= 0)
+	{
+		serial->state = SERIAL_CONNECTED;
+		printf("SERIAL %s: link taken over.\r\n", serial_get_name(serial));
+	}
+	else
+	{
+		serial->state = SERIAL_DISCONNECTED;
+		serial->lostAt = now_ms();
+		serial->deadline = serial->lostAt;
+		printf("SERIAL %s: link taken over while down, reconnecting...\r\n", serial_get_name(serial));
+	}
+	return serial->state;
+}
+
+void serial_disconnect(serial_t* serial)
+{
+	/* Link lost: close it and retry right away, then back off */
+	if(serial->s >= 0)
+	{
+		serial->transport->close(serial->s);
+		serial->s = -1;
+	}
+	printf("SERIAL %s: link lost, reconnecting...\r\n", serial_get_name(serial));
+	serial->state = SERIAL_DISCONNECTED;
+	serial->lostAt = now_ms();
+	serial->deadline = serial->lostAt;
+	serial->backoff = 0;
+	serial->attempts = 0;
+}
+
+int serial_get_state(serial_t* serial)
+{
+	return serial->state;
+}
+
+int serial_get_timeout(serial_t* serial)
+{
+	uint64_t now = now_ms();
+	/* Milliseconds until serial_reconnect_poll() has something to do on its own, -1 if never */
+	if(serial->state == SERIAL_CONNECTED || serial->state == SERIAL_FAILED)
+	{
+		return -1;
+	}
+	return (serial->deadline > now) ? (int)(serial->deadline - now) : 0;
+}
+
+const char* serial_get_name(serial_t* serial)
+{
+	/* Device given on the command line, or the transport's default one */
+	return (serial->device != NULL) ? serial->device : serial->transport->name;
+}
+
+int serial_send(serial_t* serial,char* pData,int size)
+{
+	return serial->transport->send(serial->s, pData, size);
+}
+
+void serial_close(serial_t* serial)
+{
+	if(serial->s >= 0)
+	{
+		serial->transport->close(serial->s);
+		serial->s = -1;
+	}
+	serial->state = SERIAL_DISCONNECTED;
 }
 
-void serial_close(void)
+int serial_receive(serial_t* serial,char* buf,int size)
 {
-	close(s);
+	return serial->transport->receive(serial->s, buf, size);
 }
 
-int serial_receive(char* buf,int size)
+int serial_get_fd(serial_t* serial)
 {
-	int n = read(s, buf, size);
-	return n;
+	return serial->s;
 }
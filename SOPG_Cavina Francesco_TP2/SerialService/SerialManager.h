@@ -1,8 +1,45 @@
+#ifndef SERIAL_MANAGER_H
+#define SERIAL_MANAGER_H
 
+#include <stdint.h>
+#include "SerialTransport.h"
 
-int serial_open(int pn,int baudrate);
-void serial_send(char* pData,int size);
-void serial_close(void);
-int serial_receive(char* buf,int size);
+#define SERIAL_DISCONNECTED	0
+#define SERIAL_CONNECTING	1
+#define SERIAL_CONNECTED	2
+#define SERIAL_FAILED		3	// Never connected and misconfigured (no such device, bad address): not retried
 
+/* One controller link: its descriptor, transport and reconnection state */
+typedef struct
+{
+	int s;
+	const serialTransport_t* transport;
+	const char* device;
+	int flags;
+	int port;
+	int baudrate;
+	int state;		// Reconnection state machine: DISCONNECTED -> (backoff) -> CONNECTING -> CONNECTED, or FAILED
+	uint64_t deadline;	// ms: next attempt (DISCONNECTED) or connect timeout (CONNECTING)
+	uint32_t backoff;	// ms: delay before the next attempt
+	uint32_t attempts;
+	uint64_t lostAt;	// ms: when the link went down, 0 at startup
+	uint32_t seed;
+	int openError;		// errno of the last failed open
+} serial_t;
 
+void serial_init(serial_t* serial);
+int serial_config(serial_t* serial,const char* transport,const char* device,int flags);
+int serial_open(serial_t* serial,int pn,int baudrate);
+int serial_start(serial_t* serial,int pn,int baudrate);
+int serial_send(serial_t* serial,char* pData,int size);
+void serial_close(serial_t* serial);
+int serial_receive(serial_t* serial,char* buf,int size);
+int serial_get_fd(serial_t* serial);
+int serial_get_state(serial_t* serial);
+int serial_get_timeout(serial_t* serial);
+const char* serial_get_name(serial_t* serial);
+int serial_reconnect_poll(serial_t* serial);
+void serial_disconnect(serial_t* serial);
+int serial_adopt(serial_t* serial,int pn,int baudrate,int fd);
+
+#endif
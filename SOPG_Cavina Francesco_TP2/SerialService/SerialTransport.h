@@ -0,0 +1,40 @@
+/*
+ * @file   : SerialTransport.h
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+#ifndef SERIAL_TRANSPORT_H
+#define SERIAL_TRANSPORT_H
+
+/********************** Inclusions *******************************************/
+
+/********************** Macros ***********************************************/
+#define SERIAL_FLAG_LOW_LATENCY			(1 << 0)	// Ask the UART driver for ASYNC_LOW_LATENCY
+
+/********************** Typedef **********************************************/
+/*
+ * Link to the Controller Emulator behind the SerialManager.h functions. Every
+ * transport hands back a non-blocking file descriptor, so the bridge polls
+ * and reads it the same way whatever is underneath. open() never blocks: a
+ * link that needs a handshake is reported by finish() once it is writable.
+ */
+typedef struct
+{
+	const char* name;
+	int (*open)(int pn, int baudrate, const char* device, int flags);	// File descriptor or -1 (errno EINVAL: bad configuration)
+	int (*finish)(int fd);							// 0 connected, 1 in progress, -1 failed (NULL: no handshake)
+	int (*send)(int fd, const char* data, int size);
+	int (*receive)(int fd, char* buffer, int size);
+	void (*close)(int fd);
+} serialTransport_t;
+
+/********************** External Data Declaration ****************************/
+extern const serialTransport_t serialTransportTcp;		// Emulador.py over TCP (default)
+extern const serialTransport_t serialTransportTermios;		// Real UART or pseudo-terminal
+
+/********************** External Functions Declaration ***********************/
+
+#endif /* SERIAL_TRANSPORT_H */
+
+/********************** End of File ******************************************/
@@ -0,0 +1,136 @@
+/*
+ * @file   : SerialTransportTcp.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "SerialTransport.h"
+
+/********************** Macros and Definitions *******************************/
+#define EMULATOR_DEFAULT_IP			("127.0.0.1")
+#define EMULATOR_DEFAULT_PORT			(4040)
+#define EMULATOR_ADDRESS_SIZE			(64)
+
+/********************** Internal Data Declaration ****************************/
+
+/********************** Internal Functions Declaration ***********************/
+static int tcpOpen(int pn, int baudrate, const char* device, int flags);
+static int tcpFinish(int fd);
+static int tcpSend(int fd, const char* data, int size);
+static int tcpReceive(int fd, char* buffer, int size);
+static void tcpClose(int fd);
+
+/********************** Internal Data Definition *****************************/
+
+/********************** External Data Definition *****************************/
+const serialTransport_t serialTransportTcp =
+{
+	.name = "tcp",
+	.open = tcpOpen,
+	.finish = tcpFinish,
+	.send = tcpSend,
+	.receive = tcpReceive,
+	.close = tcpClose
+};
+
+/********************** Internal Functions Definition ************************/
+static int tcpOpen(int pn, int baudrate, const char* device, int flags)
+{
+	struct sockaddr_in serveraddr;
+	char ip[EMULATOR_ADDRESS_SIZE] = EMULATOR_DEFAULT_IP;
+	int port = EMULATOR_DEFAULT_PORT;
+	char* separator;
+	int fd;
+
+	/* Port number and baudrate mean nothing to the emulator, device may be "ip:port" */
+	if(device != NULL)
+	{
+		snprintf(ip, sizeof(ip), "%s", device);
+
+		if((separator = strrchr(ip, ':')) != NULL)
+		{
+			*separator = '\0';
+			port = atoi(separator + 1);
+		}
+	}
+
+	memset(&serveraddr, 0, sizeof(serveraddr));
+	serveraddr.sin_family = AF_INET;
+	serveraddr.sin_port = htons(port);
+
+	if(inet_pton(AF_INET, ip, &(serveraddr.sin_addr)) <= 0)
+	{
+		fprintf(stderr, "ERROR invalid server IP\r\n");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if((fd = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+	{
+		perror("ERROR socket() API");
+		return -1;
+	}
+
+	/* Connection completes in the background, the socket turns writable when it is done */
+	if((connect(fd, (const struct sockaddr *) &serveraddr, sizeof(serveraddr)) == -1) && (errno != EINPROGRESS))
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int tcpFinish(int fd)
+{
+	struct sockaddr_in peer;
+	socklen_t length = sizeof(peer);
+	int error = 0;
+
+	/* Connected once the socket has a peer */
+	if(getpeername(fd, (struct sockaddr *) &peer, &length) == 0)
+	{
+		return 0;
+	}
+
+	/* Otherwise either still in progress or refused */
+	length = sizeof(error);
+	if((getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == -1) || (error != 0))
+	{
+		errno = error;
+		return -1;
+	}
+
+	return 1;
+}
+
+static int tcpSend(int fd, const char* data, int size)
+{
+	return write(fd, data, size);
+}
+
+static int tcpReceive(int fd, char* buffer, int size)
+{
+	return read(fd, buffer, size);
+}
+
+static void tcpClose(int fd)
+{
+	close(fd);
+}
+
+/********************** External Functions Definition ************************/
+
+/********************** End of File ******************************************/
@@ -0,0 +1,192 @@
+/*
+ * @file   : SerialTransportTermios.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+#include "SerialTransport.h"
+
+/********************** Macros and Definitions *******************************/
+#define TERMIOS_DEVICE_FORMAT			("/dev/ttyUSB%d")
+#define TERMIOS_DEVICE_SIZE			(64)
+
+/********************** Internal Data Declaration ****************************/
+typedef struct
+{
+	int baudrate;
+	speed_t speed;
+} baudrate_t;
+
+/********************** Internal Functions Declaration ***********************/
+static int termiosOpen(int pn, int baudrate, const char* device, int flags);
+static int termiosSend(int fd, const char* data, int size);
+static int termiosReceive(int fd, char* buffer, int size);
+static void termiosClose(int fd);
+static speed_t termiosSpeed(int baudrate);
+static void termiosLowLatency(int fd, const char* device);
+
+/********************** Internal Data Definition *****************************/
+static const baudrate_t baudrates[] =
+{
+	{9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600},
+	{115200, B115200}, {230400, B230400}, {460800, B460800}, {921600, B921600},
+	{1000000, B1000000}, {2000000, B2000000}, {3000000, B3000000}, {4000000, B4000000}
+};
+
+/********************** External Data Definition *****************************/
+const serialTransport_t serialTransportTermios =
+{
+	.name = "tty",
+	.open = termiosOpen,
+	.finish = NULL,
+	.send = termiosSend,
+	.receive = termiosReceive,
+	.close = termiosClose
+};
+
+/********************** Internal Functions Definition ************************/
+static speed_t termiosSpeed(int baudrate)
+{
+	uint32_t i;
+
+	for(i = 0; i < (sizeof(baudrates) / sizeof(baudrates[0])); i++)
+	{
+		if(baudrates[i].baudrate == baudrate)
+		{
+			return baudrates[i].speed;
+		}
+	}
+
+	return B0;
+}
+
+static void termiosLowLatency(int fd, const char* device)
+{
+	struct serial_struct serial;
+
+	/* Driver flushes received bytes to the tty layer at once instead of on its timer */
+	if(ioctl(fd, TIOCGSERIAL, &serial) == 0)
+	{
+		serial.flags |= ASYNC_LOW_LATENCY;
+
+		if(ioctl(fd, TIOCSSERIAL, &serial) == 0)
+		{
+			printf("SERIAL: %s in low latency mode.\r\n", device);
+			return;
+		}
+	}
+
+	/* Pseudo-terminals and some USB adapters don't support it */
+	printf("SERIAL: %s doesn't support ASYNC_LOW_LATENCY (%s).\r\n", device, strerror(errno));
+}
+
+static int termiosOpen(int pn, int baudrate, const char* device, int flags)
+{
+	char path[TERMIOS_DEVICE_SIZE];
+	struct termios tty;
+	speed_t speed;
+	int fd;
+
+	/* Port number selects /dev/ttyUSB<pn> unless a device is given (e.g. a pseudo-terminal) */
+	if(device == NULL)
+	{
+		snprintf(path, sizeof(path), TERMIOS_DEVICE_FORMAT, pn);
+	}
+	else
+	{
+		snprintf(path, sizeof(path), "%s", device);
+	}
+
+	if((speed = termiosSpeed(baudrate)) == B0)
+	{
+		fprintf(stderr, "ERROR unsupported baudrate: %d.\r\n", baudrate);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if((fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC)) == -1)
+	{
+		fprintf(stderr, "ERROR open(%s) API: %s\r\n", path, strerror(errno));
+		return -1;
+	}
+
+	if(tcgetattr(fd, &tty) == -1)
+	{
+		fprintf(stderr, "ERROR tcgetattr(%s) API: %s\r\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	/* Raw 8N1: no echo, no line editing, no CR/LF translation, no flow control */
+	cfmakeraw(&tty);
+	tty.c_cflag |= CLOCAL | CREAD;
+	tty.c_cflag &= ~(CSTOPB | CRTSCTS);
+	tty.c_iflag &= ~(IXON | IXOFF | IXANY);
+
+	/* read() returns as soon as one byte is there, no inter-byte timer (the fd is non-blocking anyway) */
+	tty.c_cc[VMIN] = 1;
+	tty.c_cc[VTIME] = 0;
+
+	cfsetispeed(&tty, speed);
+	cfsetospeed(&tty, speed);
+
+	if(tcsetattr(fd, TCSANOW, &tty) == -1)
+	{
+		fprintf(stderr, "ERROR tcsetattr(%s) API: %s\r\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	/* Start from an empty line */
+	tcflush(fd, TCIOFLUSH);
+
+	if(flags & SERIAL_FLAG_LOW_LATENCY)
+	{
+		termiosLowLatency(fd, path);
+	}
+
+	printf("SERIAL: %s open at %d baud.\r\n", path, baudrate);
+
+	return fd;
+}
+
+static int termiosSend(int fd, const char* data, int size)
+{
+	return write(fd, data, size);
+}
+
+static int termiosReceive(int fd, char* buffer, int size)
+{
+	int bytes = read(fd, buffer, size);
+
+	/* Pseudo-terminal whose other side was closed: report it like a closed socket */
+	if((bytes == -1) && (errno == EIO))
+	{
+		return 0;
+	}
+
+	return bytes;
+}
+
+static void termiosClose(int fd)
+{
+	/* Don't wait for a stalled line to drain */
+	tcflush(fd, TCIOFLUSH);
+	close(fd);
+}
+
+/********************** External Functions Definition ************************/
+
+/********************** End of File ******************************************/
@@ -0,0 +1,205 @@
+/*
+ * @file   : StateTable.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/********************** Inclusions *******************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "StateTable.h"
+#include "FrameParser.h"
+#include "LatencyHistogram.h"
+
+/********************** Macros and Definitions *******************************/
+
+/********************** Internal Data Declaration ****************************/
+
+/********************** Internal Functions Declaration ***********************/
+
+/********************** Internal Data Definition *****************************/
+static pthread_mutex_t mutexData_writers = PTHREAD_MUTEX_INITIALIZER;	// Serial rx and tx may both publish
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+
+/********************** External Functions Definition ************************/
+stateTable_t* stateTableCreate(const char* name, bool keep)
+{
+	stateTable_t* table;
+	int fd;
+
+	/* Readers only get read permission on the segment */
+	if((fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) == -1)
+	{
+		perror("ERROR shm_open() API");
+		return NULL;
+	}
+
+	if(ftruncate(fd, sizeof(stateTable_t)) == -1)
+	{
+		perror("ERROR ftruncate() API");
+		close(fd);
+		return NULL;
+	}
+
+	table = mmap(NULL, sizeof(stateTable_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if(table == MAP_FAILED)
+	{
+		perror("ERROR mmap() API");
+		return NULL;
+	}
+
+	/* Hot restart: keep what the previous process published if it is the same layout */
+	if(keep && (table->magic == STATE_TABLE_MAGIC) && (table->version == STATE_TABLE_VERSION) && (table->channels == STATE_TABLE_CHANNELS))
+	{
+		return table;
+	}
+
+	/* Start from an empty table, readers check magic and version before trusting it */
+	memset(&table->data, 0, sizeof(stateData_t));
+	table->version = STATE_TABLE_VERSION;
+	table->channels = STATE_TABLE_CHANNELS;
+	atomic_store_explicit(&table->sequence, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	table->magic = STATE_TABLE_MAGIC;
+
+	return table;
+}
+
+void stateTableDestroy(stateTable_t* table, const char* name)
+{
+	munmap(table, sizeof(stateTable_t));
+	shm_unlink(name);
+}
+
+bool stateTableUpdate(stateTable_t* table, const char* frame, uint32_t length)
+{
+	frameFields_t fields;
+	int32_t* values;
+	uint64_t* known;
+	uint64_t bit;
+	uint32_t sequence;
+
+	if(!frameDecode(frame, length, &fields) || (fields.channel >= STATE_TABLE_CHANNELS))
+	{
+		return false;
+	}
+
+	if(strcmp(fields.type, "SW") == 0)
+	{
+		values = table->data.switches;
+		known = &table->data.switchesKnown;
+	}
+	else if(strcmp(fields.type, "OUT") == 0)
+	{
+		values = table->data.outputs;
+		known = &table->data.outputsKnown;
+	}
+	else
+	{
+		return false;
+	}
+
+	bit = 1ULL << fields.channel;
+
+	/* Lock mutex for shared resource */
+	pthread_mutex_lock(&mutexData_writers);
+	{
+		/* Repeated values don't wake readers up */
+		if((*known & bit) && (values[fields.channel] == fields.value))
+		{
+			pthread_mutex_unlock(&mutexData_writers);
+			return false;
+		}
+
+		/* Odd sequence: readers retry until the update is complete */
+		sequence = atomic_load_explicit(&table->sequence, memory_order_relaxed);
+		atomic_store_explicit(&table->sequence, sequence + 1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);
+
+		values[fields.channel] = fields.value;
+		*known |= bit;
+		table->data.changes++;
+		table->data.updated = latencyNow();
+
+		atomic_store_explicit(&table->sequence, sequence + 2, memory_order_release);
+	}
+	/* Unlock mutex for shared resource */
+	pthread_mutex_unlock(&mutexData_writers);
+
+	return true;
+}
+
+stateTable_t* stateTableAttach(const char* name)
+{
+	stateTable_t* table;
+	int fd;
+
+	if((fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0)) == -1)
+	{
+		return NULL;
+	}
+
+	table = mmap(NULL, sizeof(stateTable_t), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if(table == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	/* Written by another version of the service */
+	if((table->magic != STATE_TABLE_MAGIC) || (table->version != STATE_TABLE_VERSION))
+	{
+		munmap(table, sizeof(stateTable_t));
+		errno = EPROTO;
+		return NULL;
+	}
+
+	return table;
+}
+
+void stateTableDetach(stateTable_t* table)
+{
+	munmap(table, sizeof(stateTable_t));
+}
+
+uint32_t stateTableSequence(const stateTable_t* table)
+{
+	/* Cheap change check: compare with the sequence of the last snapshot */
+	return atomic_load_explicit((_Atomic uint32_t*) &table->sequence, memory_order_acquire);
+}
+
+uint32_t stateTableSnapshot(const stateTable_t* table, stateData_t* snapshot)
+{
+	_Atomic uint32_t* sequence = (_Atomic uint32_t*) &table->sequence;
+	uint32_t before, after;
+
+	/* Copy until no writer was active before or during the copy */
+	do
+	{
+		while((before = atomic_load_explicit(sequence, memory_order_acquire)) & 1);
+
+		memcpy(snapshot, &table->data, sizeof(stateData_t));
+
+		atomic_thread_fence(memory_order_acquire);
+		after = atomic_load_explicit(sequence, memory_order_relaxed);
+	}
+	while(before != after);
+
+	return before;
+}
+
+/********************** End of File ******************************************/
@@ -0,0 +1,67 @@
+/*
+ * @file   : StateTable.h
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+#ifndef STATE_TABLE_H
+#define STATE_TABLE_H
+
+/********************** Inclusions *******************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "FrameQueue.h"
+
+/********************** Macros ***********************************************/
+#define STATE_TABLE_DEFAULT_NAME		("/serialService.state")
+#define STATE_TABLE_MAGIC			(0x53544154u)		// "STAT"
+#define STATE_TABLE_VERSION			(1)
+#define STATE_TABLE_CHANNELS			(64)
+
+/********************** Typedef **********************************************/
+/* Everything a reader copies in one snapshot */
+typedef struct
+{
+	uint64_t updated;			// Monotonic time of the last change (ns)
+	uint64_t changes;			// Changes published since the service started
+	uint64_t switchesKnown;			// Bitmap of switches reported at least once
+	uint64_t outputsKnown;			// Bitmap of outputs written at least once
+	int32_t switches[STATE_TABLE_CHANNELS];	// Last ">SW:n,v" from the Controller Emulator
+	int32_t outputs[STATE_TABLE_CHANNELS];	// Last ">OUT:n,v" written to the Controller Emulator
+} stateData_t;
+
+/*
+ * Switch and output states published by the Serial Service in a POSIX
+ * shared memory segment. Writers bump sequence to an odd value, update data
+ * and bump it back to even; readers copy data and retry if sequence was odd
+ * or moved meanwhile (seqlock). Readers never write the segment and never
+ * make a syscall to read it.
+ */
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t channels;
+	_Alignas(CACHE_LINE_SIZE) _Atomic uint32_t sequence;	// Odd while an update is in progress
+	stateData_t data;
+} stateTable_t;
+
+/********************** External Data Declaration ****************************/
+
+/********************** External Functions Declaration ***********************/
+/* Writer side (Serial Service) */
+stateTable_t* stateTableCreate(const char* name, bool keep);
+void stateTableDestroy(stateTable_t* table, const char* name);
+bool stateTableUpdate(stateTable_t* table, const char* frame, uint32_t length);
+
+/* Reader side */
+stateTable_t* stateTableAttach(const char* name);
+void stateTableDetach(stateTable_t* table);
+uint32_t stateTableSequence(const stateTable_t* table);
+uint32_t stateTableSnapshot(const stateTable_t* table, stateData_t* snapshot);
+
+#endif /* STATE_TABLE_H */
+
+/********************** End of File ******************************************/
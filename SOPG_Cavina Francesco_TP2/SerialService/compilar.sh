@@ -1 +1 @@
-gcc -pthread main.c SerialManager.c -o serialService
+gcc -pthread main.c SerialManager.c SerialTransportTcp.c SerialTransportTermios.c FrameQueue.c FrameParser.c InterfaceClients.c Coalescer.c LatencyHistogram.c StateTable.c HotRestart.c RealTime.c Journal.c Metrics.c Router.c ControllerLinks.c Inflight.c -o serialService -lrt
@@ -5,6 +5,7 @@
  */
 
 /********************** Inclusions *******************************************/
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -15,86 +16,285 @@
 #include <errno.h>
 #include <string.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/un.h>
+#include <sys/stat.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <sys/ipc.h>
 #include <sys/sem.h>
 #include <pthread.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <limits.h>
 
 #include "main.h"
 #include "SerialManager.h"
+#include "SerialTransport.h"
+#include "FrameQueue.h"
+#include "FrameParser.h"
+#include "InterfaceClients.h"
+#include "Coalescer.h"
+#include "LatencyHistogram.h"
+#include "StateTable.h"
+#include "HotRestart.h"
+#include "RealTime.h"
+#include "Journal.h"
+#include "Metrics.h"
+#include "Router.h"
+#include "ControllerLinks.h"
+#include "Inflight.h"
 
 /********************** Macros and Definitions *******************************/
 #define INTERFACE_SERVICE_SOCKET_IP		("127.0.0.1")
 #define INTERFACE_SERVICE_SOCKET_PORT		(10000)
-#define	COMM_BUFFER_SIZE			(16)
+#define EVENT_LOOP_MAX_EVENTS			(64)
+#define EVENT_ID_LISTENER			(1)
+#define EVENT_ID_SIGNAL				(2)
+#define EVENT_ID_RESTART			(3)
+#define EVENT_ID_LISTENER_UNIX			(4)
+#define EVENT_ID_WAKE				(5)
+#define EVENT_ID_CLIENT_BASE			(16)
+#define EVENT_ID_LINK_BASE			(1024)
+#define SOCKET_WRITE_BATCH			(64)
+#define COALESCE_DEFAULT_THRESHOLD		(4)
+#define SERIAL_DEFAULT_PORT			(1)
+#define SERIAL_DEFAULT_BAUDRATE			(115200)
+#define SHUTDOWN_DRAIN_MS			(500)
+#define SOCKET_BUFFER_DEFAULT			(0)
+#define REAL_TIME_CONTROLLER_TX			(0)
+#define REAL_TIME_CONTROLLER_RX			(1)
+#define REAL_TIME_INTERFACE_TX			(2)
+#define REAL_TIME_INTERFACE_RX			(3)
+#define REAL_TIME_EVENT_LOOP			(0)
+#define REAL_TIME_SHARD_BASE			(1)
 
 /********************** Internal Data Declaration ****************************/
 typedef enum
+{	
+	EXIT = 0,
+	RUNNING = 1,
+	HANDOFF = 2
+} systemStatus_t;
+
+/* Hot restart: fixed part of the state handed to the replacement */
+typedef struct
 {
-	RESET = 0,
-	SET = 1
-} buffersFlag_t;
+	uint32_t magic;
+	uint32_t channels;			// Global channels, both processes must route alike
+	uint32_t links;				// Controller link records, in command line order
+	uint32_t linksConnected;		// Their descriptors follow the listeners
+	uint32_t unixListener;			// Unix listener descriptor follows the TCP listener
+	uint32_t metricsListener;		// Metrics listener descriptor follows them
+	uint32_t clients;			// Client records (one descriptor each)
+} handoffHeader_t;
 
-typedef enum
+/* Hot restart: one controller link, its queued frames follow */
+typedef struct
 {
-	CLIENT_DISCONNECTED = 0,
-	CLIENT_CONNECTED = 1
-} clientStatus_t;
+	uint32_t connected;
+	uint32_t txOffset;
+	frame_t txFrame;
+	frame_t txBatch[FRAME_COMPACT_BITMAP_CHANNELS - 1];
+	uint32_t txBatchCount;
+	char txWire[FRAME_MAX_SIZE];
+	uint32_t txWireLength;
+	uint32_t framing;
+	int32_t framingOffer;
+	uint64_t dropped;
+	frameParser_t parser;
+} handoffLink_t;
+
+/* Hot restart: one connected client, its queued frames follow */
+typedef struct
+{
+	char name[CLIENT_NAME_SIZE];
+	frameParser_t parser;
+	uint32_t txOffset;
+	uint32_t dropped;
+} handoffClient_t;	
 
 typedef enum
-{	
-	EXIT = 0,
-	RUNNING = 1
-} systemStatus_t;	
+{
+	BRIDGE_MODE_THREADS = 0,
+	BRIDGE_MODE_EPOLL = 1
+} bridgeMode_t;
+
+/* Thread serving a share of the controller links (epoll mode with --shards) */
+typedef struct
+{
+	uint32_t index;
+	pthread_t thread;
+	int epoll_fd;
+	int wake_fd;				// Kicked by the event loop: commands queued, room made or shutdown
+	latencyHistogram_t latency;		// Interface Service -> Controller Emulator hop, links of this shard
+} shard_t;
 
 /********************** Internal Functions Declaration ***********************/
 static void* thread_controllerEmulator_tx(void* arg);
 static void* thread_controllerEmulator_rx(void* arg);
 static void* thread_interfaceService_tx(void* arg);
 static void* thread_interfaceService_rx(void* arg);
+static void* thread_shard(void* arg);
 
 static void threadsInit(void);
-static void serialRead(void);
-static void serialWrite(void);
+static void threadsDeinit(void);
+static void threadsRun(int socket_base_fd);
+static void eventLoopRun(int socket_base_fd);
+static void eventLoopWatchClients(int epoll_fd);
+static void eventLoopResumeClients(void);
+static void eventLoopResumeLinks(int epoll_fd);
+static void eventLoopAdd(int epoll_fd, int fd, uint32_t events, uint64_t id);
+static void eventLoopDelete(int epoll_fd, int fd);
+static void shardsInit(void);
+static void shardsStart(void);
+static void shardsStop(void);
+static void shardResume(shard_t* shard);
+static void argsParse(int argc, char* argv[]);
+static void usagePrint(const char* program);
+static void programArgsInit(int argc, char* argv[]);
+static int serialRead(controllerLink_t* link);
+static int serialWrite(controllerLink_t* link);
+static void serialWritten(controllerLink_t* link, const frame_t* frame);
+static void serialLinkDown(controllerLink_t* link);
+static bool serialLinkPoll(controllerLink_t* link);
+static void linkWatch(int epoll_fd, controllerLink_t* link);
+static bool linkEvent(int epoll_fd, controllerLink_t* link, uint32_t events);
+static void linkRead(int epoll_fd, controllerLink_t* link, bool hangup);
+static int linkWrite(controllerLink_t* link);
+static void linkReconnect(int epoll_fd, controllerLink_t* link, bool ready);
+static int linksTimeout(uint32_t shard);
+static int linksFlush(void);
+static void linksKick(void);
+static uint32_t linkTxLength(const controllerLink_t* link);
+static void linkEncode(controllerLink_t* link, bool coalesced);
+static bool linkFramingOffer(controllerLink_t* link, const char* frame, uint32_t length);
 static int socketInit(char* ip, int port);
-static void socketRead(void);
+static int socketInitUnix(const char* path);
+static bool socketTune(int fd);
+static client_t* socketAccept(int listen_fd);
+static void socketClose(client_t* client);
+static int socketRead(client_t* client);
 static void socketWrite(void);
+static const char* ackTrack(client_t* client, controllerLink_t* link, const char* frame, uint32_t* length, char* buffer);
+static void ackRefuse(client_t* client, const char* frame, uint32_t length);
+static void ackCancel(controllerLink_t* link, const char* frame, uint32_t length);
+static bool ackComplete(controllerLink_t* link, const frame_t* frame);
+static void ackSend(const inflightEntry_t* entry, const char* type, int32_t value, uint64_t timestamp);
+static void ackForget(client_t* client);
+static bool linkDropping(void);
+static bool linkDropOldest(controllerLink_t* link);
 static void mutexInit(void);
-static void signalHandlersInit(void);
-static void signalHandlerSIGINT(void);
-static void signalHandlerSIGTERM(void);
+static void queuesInit(uint32_t depth);
+static int signalInit(void);
+static void signalRead(int signal_fd);
+static void latencyPrint(void);
+static latencyHistogram_t* latencyLeft(latencyHistogram_t* merged);
+static void metricsCountReceived(metricsDirection_t* metrics, uint64_t frames, uint64_t bytes, uint64_t errors, uint64_t unroutable);
+static uint64_t metricsTotal(uint32_t direction, size_t counter);
+static void metricsRender(metricsBuffer_t* buffer);
 static void signalBlock(void);
-static void signalUnblock(void);
+static void threadWait(int event_fd);
+static void threadPoll(struct pollfd* fds, uint32_t count, int timeout);
+static void threadWake(int event_fd);
+static void shutdownDrain(void);
+static uint32_t shutdownPending(void);
+static void handoffAccept(void);
+static uint64_t threadRealTimeInit(uint32_t index, const char* name);
+static void threadRealTimeDeinit(uint64_t faults);
+static int handoffSend(int socket_base_fd);
+static int handoffReceive(void);
+static int handoffAppendQueue(hotRestartMessage_t* message, frameQueue_t* queue);
+static int handoffAppendFrames(hotRestartMessage_t* message, const frame_t* frames, uint32_t count);
+static uint32_t handoffTakeFrames(hotRestartMessage_t* message, frameQueue_t* queue, coalescer_t* coalescer, bool written);
 
 /********************** Internal Data Definition *****************************/
-static systemStatus_t systemStatus = RUNNING;					// System
+static _Atomic systemStatus_t systemStatus = RUNNING;				// System, read by every thread without the lock
+static bridgeMode_t bridgeMode = BRIDGE_MODE_EPOLL;				// System
 
-static int socket_fd;								// Socket connection	
-socklen_t addr_len;								// Socket connection
-struct sockaddr_in clientaddr;							// Socket connection	
 struct sockaddr_in serveraddr;							// Socket connection
-static clientStatus_t clientStatus = CLIENT_DISCONNECTED;			// Socket connection
 	
 static pthread_t ThreadHandle_controllerEmulator_tx;				// Thread handler
 static pthread_t ThreadHandle_controllerEmulator_rx;				// Thread handler
 static pthread_t ThreadHandle_interfaceService_tx;				// Thread handler
 static pthread_t ThreadHandle_interfaceService_rx;				// Thread handler 
 
-static pthread_mutex_t mutexData_comm = PTHREAD_MUTEX_INITIALIZER;		// Mutex
 static pthread_mutex_t mutexData_systemStatus = PTHREAD_MUTEX_INITIALIZER;	// Mutex
+static pthread_mutex_t mutexData_clients = PTHREAD_MUTEX_INITIALIZER;		// Mutex
 
-static char buffer_right[COMM_BUFFER_SIZE];					// Cross-communication
-static char buffer_left[COMM_BUFFER_SIZE];					// Cross-communication
-static buffersFlag_t bufferRightFlag = RESET;					// Cross-communication
-static buffersFlag_t bufferLeftFlag = RESET;					// Cross-communication
+static uint32_t queueDepth = FRAME_QUEUE_DEFAULT_DEPTH;				// Cross-communication, per link and direction
+static uint32_t coalesceThreshold = COALESCE_DEFAULT_THRESHOLD;			// Queued commands that mean "link backed up"
+static frameQueuePolicy_t linkPolicy = FRAME_QUEUE_POLICY_COALESCE;		// Commands for a full controller queue
+static frameQueuePolicy_t clientsPolicy = FRAME_QUEUE_POLICY_DROP_NEWEST;	// Frames for a full client send queue
+static bool quiet = false;							// No per-frame log (benchmarks)
+static const char* serialTransportName = NULL;					// Controller Emulator link: tcp (default) or tty
+static const char* serialDevices[LINKS_MAX];					// tty device or tcp "ip:port", one controller link each
+static uint32_t serialDevicesCount = 0;						// Controller links given, none: one link on the default device
+static uint32_t linkChannels = ROUTER_DEFAULT_LINK_CHANNELS;			// Channels per controller when routed in contiguous ranges
+static const char* routesPath = NULL;						// Global channel -> (link, local channel) table instead
+static uint32_t shardsCount = 0;						// Threads serving the controller links (epoll mode), 0: the event loop itself
+static shard_t* shards = NULL;							// Threads serving the controller links
+static int eventFd_eventLoop = -1;						// Shards kick the event loop: frames for the clients or room for their commands
+static uint64_t linksPending = 0;						// Links with new commands, one bit each (clients reader only)
+static int serialPort = SERIAL_DEFAULT_PORT;					// /dev/ttyUSB<n> when no device is given
+static int serialBaudrate = SERIAL_DEFAULT_BAUDRATE;				// Serial line speed
+static int serialFlags = 0;							// SERIAL_FLAG_*
+static stateTable_t* stateTable = NULL;						// Switch and output states for local readers
+static const char* stateTableName = STATE_TABLE_DEFAULT_NAME;			// POSIX shared memory name, "none" disables it
+static latencyHistogram_t latency_right;					// Hop latency: Controller Emulator -> Interface Service
+static latencyHistogram_t latency_left;						// Hop latency: Interface Service -> Controller Emulator (event loop or threads, shards have their own)
+static int signal_fd = -1;							// SIGINT, SIGTERM, SIGUSR1 and SIGHUP, blocked in every thread
+static int eventFd_controllerEmulator_tx = -1;					// Thread wakeup
+static int eventFd_controllerEmulator_rx = -1;					// Thread wakeup
+static int eventFd_interfaceService_tx = -1;					// Thread wakeup
+static int eventFd_interfaceService_rx = -1;					// Thread wakeup
+static uint64_t shutdownStart = 0;						// When SIGINT or SIGTERM was received (ns)
+static const char* hotRestartPath = HOT_RESTART_DEFAULT_PATH;			// Unix socket a replacement connects to, "none" disables it
+static bool takeover = false;							// Started as a replacement
+static int restart_fd = -1;							// Listening hot restart socket
+static int handoff_fd = -1;							// Replacement being handed over to
+static char programPath[PATH_MAX];						// Binary exec'd on SIGHUP
+static char** programArgv = NULL;						// Our arguments plus --takeover
+static const char* unixSocketPath = NULL;					// Local Interface Service clients, same protocol as TCP
+static int unix_fd = -1;							// Listening unix socket
+static int socketBuffer = SOCKET_BUFFER_DEFAULT;				// Client SO_SNDBUF/SO_RCVBUF, 0 keeps the kernel's autotuning
+static realTimeConfig_t realTime;						// CPU pinning, SCHED_FIFO and mlockall
+static _Atomic uint64_t forwardingFaults = 0;					// Page faults taken by the forwarding threads once running
+static const char* journalPath = NULL;						// Every frame received, for replay
+static uint64_t journalSize = JOURNAL_DEFAULT_SIZE_MB;				// Ring file size (MB)
+static journal_t* journal = NULL;						// Frame capture ring
+static metricsDirection_t metrics_right;					// Counters: Controller Emulator -> Interface Service, clients side (each link counts its own side)
+static metricsDirection_t metrics_left;						// Counters: Interface Service -> Controller Emulator, clients side
+static const char* metricsAddress = NULL;					// Prometheus endpoint: [IP:]PORT or unix socket path
+static int metrics_fd = -1;							// Listening metrics socket
+static linkFraming_t linkFraming = LINK_FRAMING_TEXT;				// Most compact framing agreed to when a controller offers it
+static uint32_t ackWindow = 0;							// Sequenced commands tracked per link, 0: sequence numbers pass through untouched
+static latencyHistogram_t latency_acks;						// Command round trip: received from a client -> its ACK received from the controller
+static _Atomic uint64_t acksSent = 0;						// ACKs delivered to the clients, read by the metrics thread
+static _Atomic uint64_t naksSent = 0;						// Sequenced commands given up on: dropped, or never acknowledged within the window
 	
 /********************** External Data Definition *****************************/
 
 /********************** Internal Functions Definition ************************/
 static void threadsInit(void)
 {
+	/* Wakeups: producers kick the writer threads, shutdown kicks all of them */
+	eventFd_controllerEmulator_tx = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	eventFd_controllerEmulator_rx = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	eventFd_interfaceService_tx = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	eventFd_interfaceService_rx = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	
+	if((eventFd_controllerEmulator_tx == -1) || (eventFd_controllerEmulator_rx == -1) || (eventFd_interfaceService_tx == -1) || (eventFd_interfaceService_rx == -1))
+	{
+		perror("ERROR eventfd() API");
+		exit(1);
+	}
+	
 	/* Create threads: 2 for communication with Controller Emulator and 2 for communication with Interface Service */
 	pthread_create(&ThreadHandle_controllerEmulator_tx, NULL, thread_controllerEmulator_tx, NULL);
 	pthread_create(&ThreadHandle_controllerEmulator_rx, NULL, thread_controllerEmulator_rx, NULL);
@@ -102,388 +302,3361 @@ static void threadsInit(void)
 	pthread_create(&ThreadHandle_interfaceService_rx, NULL, thread_interfaceService_rx, NULL);
 }
 
-static void* thread_controllerEmulator_tx(void* arg)
+static void threadsDeinit(void)
 {
-	while(1)
-	{
-		/* Write to Controller Emulator */
-		serialWrite();
-		
-		/* Blocking delay */
-		usleep(100000);
-	}
+	void* ret;		// For pthread_join() for freeing resources after the threads return
 	
-	return NULL;
+	/* Wake threads up: they see systemStatus == EXIT and return between two frames, never holding a lock */
+	threadWake(eventFd_controllerEmulator_tx);
+	threadWake(eventFd_controllerEmulator_rx);
+	threadWake(eventFd_interfaceService_tx);
+	threadWake(eventFd_interfaceService_rx);
+	
+	/* Free resources */
+	pthread_join(ThreadHandle_controllerEmulator_tx, &ret);
+	pthread_join(ThreadHandle_controllerEmulator_rx, &ret);
+	pthread_join(ThreadHandle_interfaceService_tx, &ret);
+	pthread_join(ThreadHandle_interfaceService_rx, &ret);
+	
+	close(eventFd_controllerEmulator_tx);
+	close(eventFd_controllerEmulator_rx);
+	close(eventFd_interfaceService_tx);
+	close(eventFd_interfaceService_rx);
 }
 
-static void* thread_controllerEmulator_rx(void* arg)
+static void threadWait(int event_fd)
 {
-	while(1)
+	uint64_t count;
+	
+	/* Kicked: consume the kicks received so far (the eventfd doesn't block) */
+	read(event_fd, &count, sizeof(count));
+}
+
+static void threadPoll(struct pollfd* fds, uint32_t count, int timeout)
+{
+	/* Sleep until one of the thread's descriptors is ready, fds[0] is its eventfd */
+	if((poll(fds, count, timeout) == -1) && (errno != EINTR))
 	{
-		/* Read from Controller Emulator */
-		serialRead();
-		
-		/* Blocking delay */
-		usleep(100000);
+		perror("ERROR poll() API");
+		exit(1);
 	}
 	
-	return NULL;
+	if(fds[0].revents & POLLIN)
+	{
+		threadWait(fds[0].fd);
+	}
 }
 
-static void* thread_interfaceService_tx(void* arg)
+static void threadWake(int event_fd)
 {
-	while(1)
-  	{
-		/* Write to Interface Service */
-		socketWrite();
-		
-		/* Blocking delay */
-		usleep(100000);
-	}	
+	uint64_t one = 1;
 	
-	return NULL;
+	write(event_fd, &one, sizeof(one));
 }
 
-static void* thread_interfaceService_rx(void* arg)
+static void threadsRun(int socket_base_fd)
 {
-	while(1)
-  	{
-		/* Read from Interface Service */
-		socketRead();
+	struct pollfd fds[4] = {{ .fd = socket_base_fd, .events = POLLIN }, { .fd = signal_fd, .events = POLLIN }, { .fd = restart_fd, .events = POLLIN }, { .fd = unix_fd, .events = POLLIN }};
+	
+	/* Init threads, they inherit the blocked signal mask */
+	threadsInit();	
+	
+	printf("-=-=-=- Serial Service Running -=-=-=-\r\n\n");
+	
+	while(atomic_load(&systemStatus) == RUNNING)
+	{
+		/* Program won't finish until SIGINT or SIGTERM signal is received */
+		if(poll(fds, 4, -1) == -1)
+		{
+			perror("ERROR poll() API");
+			exit(1);
+		}
 		
-		/* Blocking delay */
-		usleep(100000);		
-	}	
+		if(fds[1].revents & POLLIN)
+		{
+			signalRead(signal_fd);
+		}
+		
+		/* A replacement connected: stop here and hand everything over */
+		if(fds[2].revents & POLLIN)
+		{
+			handoffAccept();
+		}
+		
+		/* Accept socket incoming connections from clients, the clients reader watches them from now on */
+		if((atomic_load(&systemStatus) == RUNNING) && (fds[0].revents & POLLIN) && (socketAccept(socket_base_fd) != NULL))
+		{
+			threadWake(eventFd_interfaceService_rx);
+		}
+		
+		if((atomic_load(&systemStatus) == RUNNING) && (fds[3].revents & POLLIN) && (socketAccept(unix_fd) != NULL))
+		{
+			threadWake(eventFd_interfaceService_rx);
+		}
+	}
 	
-	return NULL;
+	printf("-=-=-=- Serial Service Stopped -=-=-=-\r\n\n");
+	
+	/* Stop threads and free resources */
+	threadsDeinit();
 }
 
-static void serialRead(void)
+static void eventLoopRun(int socket_base_fd)
 {
-	int bytes;
+	struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+	int epoll_fd;
+	int eventsCount, i, bytes;
+	uint32_t j;
+	uint64_t id, linksReady;
+	bool clientsDrained;
+	controllerLink_t* link;
+	client_t* client;
+	
+	/* Create epoll instance */
+	if((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1)
+	{
+		perror("ERROR epoll_create1() API");
+		exit(1);
+	}
+	
+	/* Watch the Interface Service listener, signals and hot restart requests */
+	eventLoopAdd(epoll_fd, socket_base_fd, EPOLLIN, EVENT_ID_LISTENER);
+	eventLoopAdd(epoll_fd, signal_fd, EPOLLIN, EVENT_ID_SIGNAL);
+	
+	if(restart_fd >= 0)
+	{
+		eventLoopAdd(epoll_fd, restart_fd, EPOLLIN, EVENT_ID_RESTART);
+	}
 	
-	/* Write serial port */
-	if(bufferRightFlag != SET)
+	if(unix_fd >= 0)
 	{
-		bytes = serial_receive(buffer_right, sizeof(buffer_right));
+		eventLoopAdd(epoll_fd, unix_fd, EPOLLIN, EVENT_ID_LISTENER_UNIX);
+	}
 	
-		if(bytes > 0)
+	/* Clients already connected: taken over from the previous process or kept after a failed hot restart */
+	for(i = 0; i < CLIENTS_MAX; i++)
+	{
+		client = clientsGet(i);
+		
+		if(client->status == CLIENT_CONNECTED)
 		{
-			/* Lock mutex for shared resource */
-			pthread_mutex_lock(&mutexData_comm);
+			client->events = EPOLLIN;
+			eventLoopAdd(epoll_fd, client->fd, client->events, EVENT_ID_CLIENT_BASE + client->index);
+		}
+	}
+	
+	if(shardsCount > 0)
+	{
+		/* Controller links are served by the shards, they kick us when there is something for the clients */
+		eventLoopAdd(epoll_fd, eventFd_eventLoop, EPOLLIN, EVENT_ID_WAKE);
+		shardsStart();
+		
+		/* Carry on with frames left in the link queues */
+		socketWrite();
+		eventLoopResumeClients();
+	}
+	else
+	{
+		for(j = 0; j < linksCount(); j++)
+		{
+			/* Controller Emulator links, whatever their state */
+			link = linksGet(j);
+			link->events = 0;
+			linkWatch(epoll_fd, link);
+			
+			/* Carry on with frames left in queues and parsers, nothing signals them */
+			if(serial_get_state(&link->serial) == SERIAL_CONNECTED)
 			{
-				bufferRightFlag = SET;
+				linkRead(epoll_fd, link, false);
+				linkWrite(link);
 			}
-			/* Unlock mutex for shared resource */
-			pthread_mutex_unlock(&mutexData_comm);	
-				
-			printf("RECEIVED from CONTROLLER EMULATOR: %ld bytes: %s", sizeof(buffer_right), buffer_right);
+			
+			linkWatch(epoll_fd, link);
 		}
-	}	
-}
-
-static void serialWrite(void)
-{
-	/* Read serial port */
-	if(SET == bufferLeftFlag)
+	}
+	
+	eventLoopWatchClients(epoll_fd);
+	
+	printf("-=-=-=- Serial Service Running -=-=-=-\r\n\n");
+	
+	while(atomic_load(&systemStatus) == RUNNING)
 	{
-		serial_send(buffer_left, sizeof(buffer_left));
-
-		/* Lock mutex for shared resource */
-		pthread_mutex_lock(&mutexData_comm);
-		{		
-			bufferLeftFlag = RESET;
-		}	
-		/* Unlock mutex for shared resource */
-		pthread_mutex_unlock(&mutexData_comm);
+		/* Wake up for the next reconnection attempt while a controller link is down */
+		eventsCount = epoll_wait(epoll_fd, events, EVENT_LOOP_MAX_EVENTS, (shardsCount > 0) ? -1 : linksTimeout(LINK_SHARD_NONE));
+		linksReady = 0;
+		clientsDrained = false;
+		
+		if(eventsCount == -1)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			
+			perror("ERROR epoll_wait() API");
+			exit(1);
+		}
+		
+		for(i = 0; i < eventsCount; i++)
+		{
+			id = events[i].data.u64;
+			
+			if(id >= EVENT_ID_LINK_BASE)
+			{
+				/* Connection attempts are finished below, once every link had its events */
+				if(linkEvent(epoll_fd, linksGet(id - EVENT_ID_LINK_BASE), events[i].events))
+				{
+					linksReady |= 1ULL << (id - EVENT_ID_LINK_BASE);
+				}
+			}
+			else if(id == EVENT_ID_WAKE)
+			{
+				/* A shard queued frames for the clients or made room for their commands */
+				threadWait(eventFd_eventLoop);
+				socketWrite();
+				linksKick();
+				eventLoopResumeClients();
+			}
+			else if(id == EVENT_ID_SIGNAL)
+			{
+				/* Shutdown requested or histograms to print, the rest of the batch is still handled */
+				signalRead(signal_fd);
+			}
+			else if(id == EVENT_ID_RESTART)
+			{
+				/* A replacement connected: stop here and hand everything over */
+				handoffAccept();
+			}
+			else if((id == EVENT_ID_LISTENER) || (id == EVENT_ID_LISTENER_UNIX))
+			{
+				/* Accept socket incoming connections from clients */
+				if((client = socketAccept((id == EVENT_ID_LISTENER) ? socket_base_fd : unix_fd)) != NULL)
+				{
+					client->events = EPOLLIN;
+					eventLoopAdd(epoll_fd, client->fd, client->events, EVENT_ID_CLIENT_BASE + client->index);
+				}
+			}
+			else
+			{
+				client = clientsGet(id - EVENT_ID_CLIENT_BASE);
+				
+				if(client->status != CLIENT_CONNECTED)
+				{
+					/* Stale event for a client released earlier in this batch */
+					continue;
+				}
+				
+				/* Lock mutex for shared resource */
+				pthread_mutex_lock(&mutexData_clients);
+				{
+					/* Socket buffer has room again: resume the pending frames */
+					if((events[i].events & EPOLLOUT) && (clientsFlush(client) == -1))
+					{
+						socketClose(client);
+					}
 					
-		printf("WROTE to CONTROLLER EMULATOR: %ld bytes: %s\n", sizeof(buffer_left), buffer_left);
+					/* Interface Service -> Controller Emulator: forward as soon as the frame is read */
+					if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+					{
+						do
+						{
+							bytes = socketRead(client);
+						}
+						while((linksFlush() == 0) && (bytes > 0));
+					}
+				}
+				/* Unlock mutex for shared resource */
+				pthread_mutex_unlock(&mutexData_clients);
+				
+				/* Sent or gone, either way it may have made room */
+				clientsDrained = true;
+			}
+		}
+		
+		/* Block policy: a client may have made room, and any link's frames may have drained another link's queue */
+		if(clientsDrained || (shardsCount == 0))
+		{
+			eventLoopResumeLinks(epoll_fd);
+		}
+		
+		/* Clients stopped on a link drained meanwhile, by its writer or its shard */
+		eventLoopResumeClients();
+		
+		for(j = 0; (shardsCount == 0) && (j < linksCount()); j++)
+		{
+			/* Controller link down: attempt finished or next one due */
+			link = linksGet(j);
+			linkReconnect(epoll_fd, link, (linksReady & (1ULL << j)) != 0);
+			
+			/* Only wait for writability where frames are still queued */
+			linkWatch(epoll_fd, link);
+		}
+		
+		eventLoopWatchClients(epoll_fd);
 	}
-}
-
-static int socketInit(char* ip, int port)
-{
-	/* Create socket */
-	int fd = socket(AF_INET,SOCK_STREAM, 0);
 	
-	/* Load server IP:PORT data */
-	bzero((char*) &serveraddr, sizeof(serveraddr));
-    	serveraddr.sin_family = AF_INET;
-    	serveraddr.sin_port = htons(port);
-    	if(inet_pton(AF_INET, ip, &(serveraddr.sin_addr)) <= 0)
-    	{
-        	fprintf(stderr,"ERROR invalid server IP.\r\n");
-        	exit(1);
-    	}
-    	
-    	/* Open TCP port */
-	if (bind(fd, (struct sockaddr*)&serveraddr, sizeof(serveraddr)) == -1) 
+	/* The shards hand their links back (shutdown drain or hot restart) */
+	if(shardsCount > 0)
 	{
-		close(fd);
-		perror("ERROR bind() API");
-		exit(1);
+		shardsStop();
 	}
 	
-	/* Set socket in listening mode */
-	if (listen (fd, 10) == -1)
-  	{
-    	    	perror("ERROR listen() API");
-    		exit(1);
-  	}
-
-	return fd;
+	close(epoll_fd);
 }
 
-static void socketRead(void)
+static void eventLoopWatchClients(int epoll_fd)
 {
-	int bytes;
+	struct epoll_event event;
+	client_t* client;
+	uint32_t i, events;
 	
-	if((clientStatus != CLIENT_DISCONNECTED) && (bufferLeftFlag != SET))
+	for(i = 0; i < CLIENTS_MAX; i++)
 	{
-		/* Read socket */
-		bytes = read(socket_fd, buffer_left, sizeof(buffer_left));
-
-		if(bytes == -1)
+		client = clientsGet(i);
+		
+		if(client->status != CLIENT_CONNECTED)
 		{
-			perror("ERROR while listening socket");
-			exit(1);
+			continue;
 		}
-	
-		if(bytes > 0)
+		
+		/* Stop reading a client while the controller queue it waits for is full, the kernel holds its data meanwhile */
+		events = ((client->blockedLink >= 0) && frameQueueFull(&linksGet(client->blockedLink)->txQueue)) ? 0 : EPOLLIN;
+		
+		if(frameQueueCount(&client->txQueue) > 0)
 		{
-			/* Lock mutex for shared resource */
-			pthread_mutex_lock(&mutexData_comm);
-			{
-				bufferLeftFlag = SET;
-			}
-			/* Unlock mutex for shared resource */
-			pthread_mutex_unlock(&mutexData_comm);			
-
-			printf("RECEIVED from INTERFACE SERVICE: %ld bytes: %s", sizeof(buffer_left), buffer_left);
+			events |= EPOLLOUT;
 		}
 		
-		if(bytes == 0)
+		if(events != client->events)
 		{
-			clientStatus = CLIENT_DISCONNECTED;
+			client->events = events;
+			event.events = events;
+			event.data.u64 = EVENT_ID_CLIENT_BASE + client->index;
+			
+			if(epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &event) == -1)
+			{
+				perror("ERROR epoll_ctl(EPOLL_CTL_MOD) API");
+			}
 		}
-	}	
+	}
 }
 
-static void socketWrite(void) 
+static void eventLoopResumeClients(void)
 {
-	/* Write socket */
-	if(SET == bufferRightFlag)
+	client_t* client;
+	uint32_t i;
+	bool resumed;
+	
+	/* Until no client is left stopped on a link with room: their parsers may hold frames the kernel won't signal again */
+	do
 	{
-		write(socket_fd, buffer_right, sizeof(buffer_right));
-
+		resumed = false;
+		
 		/* Lock mutex for shared resource */
-		pthread_mutex_lock(&mutexData_comm);
+		pthread_mutex_lock(&mutexData_clients);
 		{
-			bufferRightFlag = RESET;
+			/* Only clients stopped on a link that has room now, the others have nothing left in their parsers */
+			for(i = 0; i < CLIENTS_MAX; i++)
+			{
+				client = clientsGet(i);
+				
+				if((client->status == CLIENT_CONNECTED) && (client->blockedLink >= 0) && !frameQueueFull(&linksGet(client->blockedLink)->txQueue))
+				{
+					socketRead(client);
+					resumed = true;
+				}
+			}
 		}
 		/* Unlock mutex for shared resource */
-		pthread_mutex_unlock(&mutexData_comm);				
-	
-		printf("WROTE to INTERFACE SERVICE: %ld bytes: %s\n", sizeof(buffer_right), buffer_right);
+		pthread_mutex_unlock(&mutexData_clients);
 	}
+	while(resumed && (linksFlush() == 0));
 }
 
-static void mutexInit(void)
+static void eventLoopResumeLinks(int epoll_fd)
 {
-	if (pthread_mutex_init(&mutexData_comm, NULL) != 0)
+	controllerLink_t* link;
+	uint32_t i;
+	
+	/* Shards: move what they queued, then let those stopped on a full queue read again */
+	if(shardsCount > 0)
 	{
-		perror("ERROR pthread_mutex_init() API");
-		exit(1);
+		socketWrite();
+		linksKick();
+		return;
 	}
 	
-	if (pthread_mutex_init(&mutexData_systemStatus, NULL) != 0)
+	/* Links stopped on a full queue: their parser may hold frames the kernel won't signal again */
+	for(i = 0; i < linksCount(); i++)
 	{
-		perror("ERROR pthread_mutex_init() API");
-		exit(1);
+		link = linksGet(i);
+		
+		if(atomic_exchange(&link->rxWaiting, false) && (serial_get_state(&link->serial) == SERIAL_CONNECTED) && (link->events != 0))
+		{
+			linkRead(epoll_fd, link, false);
+		}
 	}
 }
 
-static void signalHandlersInit(void)
+static void linkWatch(int epoll_fd, controllerLink_t* link)
 {
-	/* Set config for replacing the default handler of signal SIGINT */
-	struct sigaction signalSIGINT;
-	signalSIGINT.sa_handler = (void *) &signalHandlerSIGINT;
-	signalSIGINT.sa_flags = SA_RESTART;
-	sigemptyset(&signalSIGINT.sa_mask);
+	struct epoll_event event;
+	uint32_t events;
 	
-	if(sigaction(SIGINT, &signalSIGINT, NULL) == -1)
+	/* Connecting: wait for the handshake. Connected: read, and write while blocked. Down: nothing */
+	switch(serial_get_state(&link->serial))
 	{
-		perror("ERROR sigaction(SIGINT) API");
-		exit(1);
+		case SERIAL_CONNECTING:
+			events = EPOLLOUT;
+			break;
+			
+		case SERIAL_CONNECTED:
+			/* Clients blocking: stop reading the controller while its queue is full (the event loop kicks a shard once drained) */
+			if(frameQueueFull(&link->rxQueue))
+			{
+				atomic_store(&link->rxWaiting, true);
+			}
+			
+			events = frameQueueFull(&link->rxQueue) ? 0 : EPOLLIN;
+			events |= link->blocked ? EPOLLOUT : 0;
+			
+			/* Neither: stay registered for hangups and errors only */
+			events = (events == 0) ? EPOLLET : events;
+			break;
+			
+		default:
+			events = 0;
+			break;
 	}
 	
-	/* Set config for replacing the default handler of signal SIGTERM */
-	struct sigaction signalSIGTERM;
-	signalSIGTERM.sa_handler = (void *) &signalHandlerSIGTERM;
-	signalSIGTERM.sa_flags = SA_RESTART;
-	sigemptyset(&signalSIGTERM.sa_mask);
-	
-	if(sigaction(SIGTERM, &signalSIGTERM, NULL) == -1)
+	if(events == link->events)
 	{
-		perror("ERROR sigaction(SIGTERM) API");
-		exit(1);
+		return;
 	}
-}
-
-static void signalHandlerSIGINT(void)
-{
-	/* Signal handler for SIGINT */
-	write(STDOUT_FILENO, "\nSIGINT signal received.\r\n\n", 26);
 	
-	/* Lock mutex for shared resource */
-	pthread_mutex_lock(&mutexData_systemStatus);
+	/* A new link has a new descriptor, the old one left epoll when it was closed */
+	if(link->events == 0)
 	{
-		systemStatus = EXIT;
+		link->fd = serial_get_fd(&link->serial);
+		eventLoopAdd(epoll_fd, link->fd, events, EVENT_ID_LINK_BASE + link->index);
 	}
-	/* Unlock mutex for shared resource */
-	pthread_mutex_unlock(&mutexData_systemStatus);	
-}
-
-static void signalHandlerSIGTERM(void)
-{
-	/* Signal handler for SIGTERM */
-	write(STDOUT_FILENO, "\nSIGTERM signal received.\r\n\n", 27);
-	
-	/* Lock mutex for shared resource */
-	pthread_mutex_lock(&mutexData_systemStatus);
+	else if(events == 0)
 	{
-		systemStatus = EXIT;
+		eventLoopDelete(epoll_fd, link->fd);
 	}
-	/* Unlock mutex for shared resource */
-	pthread_mutex_unlock(&mutexData_systemStatus);
+	else
+	{
+		event.events = events;
+		event.data.u64 = EVENT_ID_LINK_BASE + link->index;
+		
+		if(epoll_ctl(epoll_fd, EPOLL_CTL_MOD, link->fd, &event) == -1)
+		{
+			perror("ERROR epoll_ctl(EPOLL_CTL_MOD) API");
+		}
+	}
+	
+	link->events = events;
 }
 
-static void signalBlock(void)
+static bool linkEvent(int epoll_fd, controllerLink_t* link, uint32_t events)
 {
-	sigset_t set;
-	int s;
+	if(serial_get_state(&link->serial) != SERIAL_CONNECTED)
+	{
+		/* Connection attempt finished, one way or the other */
+		return true;
+	}
 	
-	sigemptyset(&set);
-	sigaddset(&set, SIGINT);
-	sigaddset(&set, SIGTERM);
+	/* Link has room again: resume pending commands, then frames clients left in their parsers */
+	if(events & EPOLLOUT)
+	{
+		linkWrite(link);
+	}
 	
-	if((pthread_sigmask(SIG_BLOCK, &set, NULL)) != 0)
+	if(events & (EPOLLIN | EPOLLHUP | EPOLLERR))
 	{
-		perror("ERROR pthread_sigmask(SIG_BLOCK) API");
-		exit(1);
+		linkRead(epoll_fd, link, (events & (EPOLLHUP | EPOLLERR)) != 0);
 	}
+	
+	return false;
 }
 
-static void signalUnblock(void)
+static void linkRead(int epoll_fd, controllerLink_t* link, bool hangup)
 {
-	sigset_t set;
-	int s;
+	int bytes;
+	
+	/* Controller Emulator -> Interface Service: forward as soon as the frame is read */
+	do
+	{
+		bytes = serialRead(link);
+		
+		if(link->shard == LINK_SHARD_NONE)
+		{
+			socketWrite();
+		}
+	}
+	while((bytes > 0) && !frameQueueFull(&link->rxQueue));
+	
+	/* Shard: the event loop writes to the clients, one kick per read */
+	if((link->shard != LINK_SHARD_NONE) && (frameQueueCount(&link->rxQueue) > 0))
+	{
+		threadWake(eventFd_eventLoop);
+	}
+	
+	/* A framing offer is answered before any other command */
+	if(atomic_load(&link->framingOffer) != LINK_FRAMING_NONE)
+	{
+		linkWrite(link);
+	}
+	
+	if((bytes == 0) || hangup)
+	{
+		printf("Controller Emulator %s link closed.\r\n", serial_get_name(&link->serial));
+		eventLoopDelete(epoll_fd, link->fd);
+		link->events = 0;
+		serialLinkDown(link);
+	}
+}
+
+static int linkWrite(controllerLink_t* link)
+{
+	int result;
+	
+	/* Event loop: the clients waiting for room are served right here */
+	if(link->shard == LINK_SHARD_NONE)
+	{
+		if((result = serialWrite(link)) == 0)
+		{
+			eventLoopResumeClients();
+		}
+		
+		return result;
+	}
+	
+	/* Lock mutex for shared resource */
+	pthread_mutex_lock(&link->mutex);
+	{
+		result = serialWrite(link);
+	}
+	/* Unlock mutex for shared resource */
+	pthread_mutex_unlock(&link->mutex);
+	
+	/* Shard: a client stopped on this link's queue, the event loop resumes it */
+	if(!frameQueueFull(&link->txQueue) && atomic_exchange(&link->txWaiting, false))
+	{
+		threadWake(eventFd_eventLoop);
+	}
+	
+	return result;
+}
+
+static void linkReconnect(int epoll_fd, controllerLink_t* link, bool ready)
+{
+	if((serial_get_state(&link->serial) == SERIAL_CONNECTED) || (!ready && (serial_get_timeout(&link->serial) != 0)))
+	{
+		return;
+	}
+	
+	if(link->events != 0)
+	{
+		eventLoopDelete(epoll_fd, link->fd);
+		link->events = 0;
+	}
+	
+	/* Link back: replayed states and held commands first, then what clients left waiting */
+	if(serialLinkPoll(link))
+	{
+		linkWrite(link);
+	}
+}
+
+static int linksTimeout(uint32_t shard)
+{
+	controllerLink_t* link;
+	uint32_t i;
+	int timeout = -1, next;
+	
+	/* Earliest reconnection attempt among the links this thread serves, -1 if they are all up */
+	for(i = 0; i < linksCount(); i++)
+	{
+		link = linksGet(i);
+		
+		if((link->shard == shard) && ((next = serial_get_timeout(&link->serial)) >= 0) && ((timeout < 0) || (next < timeout)))
+		{
+			timeout = next;
+		}
+	}
+	
+	return timeout;
+}
+
+static int linksFlush(void)
+{
+	uint64_t kicked = 0;
+	uint32_t i;
+	int result = 0;
+	
+	/* Links with new commands: written right away by the event loop, or their shard is kicked once */
+	for(i = 0; linksPending != 0; i++)
+	{
+		if((linksPending & (1ULL << i)) == 0)
+		{
+			continue;
+		}
+		
+		linksPending &= ~(1ULL << i);
+		
+		if(shardsCount == 0)
+		{
+			result |= (serialWrite(linksGet(i)) != 0);
+		}
+		else if((kicked & (1ULL << linksGet(i)->shard)) == 0)
+		{
+			kicked |= 1ULL << linksGet(i)->shard;
+			threadWake(shards[linksGet(i)->shard].wake_fd);
+		}
+	}
+	
+	/* 0: everything written, clients can be read further */
+	return (kicked != 0) ? 1 : result;
+}
+
+static void linksKick(void)
+{
+	controllerLink_t* link;
+	uint32_t i;
+	
+	/* Shards stopped reading a link whose queue was full, the clients writer drained it */
+	for(i = 0; i < linksCount(); i++)
+	{
+		link = linksGet(i);
+		
+		if(!frameQueueFull(&link->rxQueue) && atomic_exchange(&link->rxWaiting, false))
+		{
+			threadWake(shards[link->shard].wake_fd);
+		}
+	}
+}
+
+static void shardsInit(void)
+{
+	uint32_t i;
+	
+	if(shardsCount == 0)
+	{
+		return;
+	}
+	
+	if((shards = calloc(shardsCount, sizeof(shard_t))) == NULL)
+	{
+		perror("ERROR calloc() API");
+		exit(1);
+	}
+	
+	/* Links dealt round robin, each shard records the latency of its own */
+	for(i = 0; i < shardsCount; i++)
+	{
+		shards[i].index = i;
+		latencyHistogramInit(&shards[i].latency, "Interface Service -> Controller Emulator");
+	}
+	
+	for(i = 0; i < linksCount(); i++)
+	{
+		linksGet(i)->shard = i % shardsCount;
+		linksGet(i)->latency = &shards[i % shardsCount].latency;
+	}
+	
+	if((eventFd_eventLoop = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+	{
+		perror("ERROR eventfd() API");
+		exit(1);
+	}
+}
+
+static void shardsStart(void)
+{
+	uint32_t i;
+	
+	for(i = 0; i < linksCount(); i++)
+	{
+		linksGet(i)->events = 0;
+	}
+	
+	for(i = 0; i < shardsCount; i++)
+	{
+		shards[i].epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		shards[i].wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		
+		if((shards[i].epoll_fd == -1) || (shards[i].wake_fd == -1))
+		{
+			perror("ERROR shard epoll_create1()/eventfd() API");
+			exit(1);
+		}
+		
+		eventLoopAdd(shards[i].epoll_fd, shards[i].wake_fd, EPOLLIN, EVENT_ID_WAKE);
+		pthread_create(&shards[i].thread, NULL, thread_shard, &shards[i]);
+	}
+}
+
+static void shardsStop(void)
+{
+	void* ret;
+	uint32_t i;
+	
+	/* Wake them up: they see systemStatus != RUNNING and return between two events */
+	for(i = 0; i < shardsCount; i++)
+	{
+		threadWake(shards[i].wake_fd);
+	}
+	
+	for(i = 0; i < shardsCount; i++)
+	{
+		pthread_join(shards[i].thread, &ret);
+		close(shards[i].epoll_fd);
+		close(shards[i].wake_fd);
+	}
+}
+
+static void shardResume(shard_t* shard)
+{
+	controllerLink_t* link;
+	uint32_t i;
+	
+	for(i = shard->index; i < linksCount(); i += shardsCount)
+	{
+		link = linksGet(i);
+		
+		if(serial_get_state(&link->serial) != SERIAL_CONNECTED)
+		{
+			continue;
+		}
+		
+		/* Commands queued by the event loop */
+		linkWrite(link);
+		
+		/* Not reading (queue was full, or just started): frames may be waiting in the parser */
+		if(((link->events & EPOLLIN) == 0) && !frameQueueFull(&link->rxQueue))
+		{
+			linkRead(shard->epoll_fd, link, false);
+		}
+	}
+}
+
+static void eventLoopAdd(int epoll_fd, int fd, uint32_t events, uint64_t id)
+{
+	struct epoll_event event;
+	
+	event.events = events;
+	event.data.u64 = id;
+	
+	if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1)
+	{
+		perror("ERROR epoll_ctl(EPOLL_CTL_ADD) API");
+		exit(1);
+	}
+}
+
+static void eventLoopDelete(int epoll_fd, int fd)
+{
+	if(epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL) == -1)
+	{
+		perror("ERROR epoll_ctl(EPOLL_CTL_DEL) API");
+	}
+}
+
+static void* thread_controllerEmulator_tx(void* arg)
+{
+	struct pollfd fds[1 + LINKS_MAX];
+	controllerLink_t* link;
+	uint64_t faults;
+	uint32_t i, count;
+	
+	/* Pinned, prioritized and prefaulted before the first frame */
+	faults = threadRealTimeInit(REAL_TIME_CONTROLLER_TX, "Controller Emulator tx");
+	
+	while(atomic_load(&systemStatus) == RUNNING)
+	{
+		fds[0].fd = eventFd_controllerEmulator_tx;
+		fds[0].events = POLLIN;
+		count = 1;
+		
+		for(i = 0; i < linksCount(); i++)
+		{
+			link = linksGet(i);
+			
+			/* Lock mutex for shared resource */
+			pthread_mutex_lock(&link->mutex);
+			{
+				/* Write to Controller Emulator */
+				serialWrite(link);
+				
+				/* Link backed up: wait until it has room */
+				if(link->blocked && (serial_get_state(&link->serial) == SERIAL_CONNECTED))
+				{
+					fds[count].fd = serial_get_fd(&link->serial);
+					fds[count].events = POLLOUT;
+					count++;
+				}
+			}
+			/* Unlock mutex for shared resource */
+			pthread_mutex_unlock(&link->mutex);
+			
+			/* A client stopped on this link's queue is read again */
+			if(!frameQueueFull(&link->txQueue) && atomic_exchange(&link->txWaiting, false))
+			{
+				threadWake(eventFd_interfaceService_rx);
+			}
+		}
+		
+		/* Sleep until clients queue commands, a link is restored or a backed up link has room */
+		threadPoll(fds, count, -1);
+	}
+	
+	threadRealTimeDeinit(faults);
+	
+	return NULL;
+}
+
+static void* thread_controllerEmulator_rx(void* arg)
+{
+	struct pollfd fds[1 + LINKS_MAX];
+	controllerLink_t* link;
+	uint64_t faults;
+	uint32_t i, count;
+	bool received;
+	
+	/* Pinned, prioritized and prefaulted before the first frame */
+	faults = threadRealTimeInit(REAL_TIME_CONTROLLER_RX, "Controller Emulator rx");
+	
+	while(atomic_load(&systemStatus) == RUNNING)
+	{
+		received = false;
+		fds[0].fd = eventFd_controllerEmulator_rx;
+		fds[0].events = POLLIN;
+		count = 1;
+		
+		for(i = 0; i < linksCount(); i++)
+		{
+			link = linksGet(i);
+			
+			if(serial_get_state(&link->serial) == SERIAL_CONNECTED)
+			{
+				/* Read from Controller Emulator */
+				if(serialRead(link) == 0)
+				{
+					printf("Controller Emulator %s link closed.\r\n", serial_get_name(&link->serial));
+					serialLinkDown(link);
+				}
+				
+				received |= (frameQueueCount(&link->rxQueue) > 0);
+				
+				/* A framing offer is answered by the writer */
+				if(atomic_load(&link->framingOffer) != LINK_FRAMING_NONE)
+				{
+					threadWake(eventFd_controllerEmulator_tx);
+				}
+			}
+			/* Reconnect to Controller Emulator: replayed states and held commands go out right away */
+			else if(serialLinkPoll(link))
+			{
+				threadWake(eventFd_controllerEmulator_tx);
+			}
+			
+			switch(serial_get_state(&link->serial))
+			{
+				case SERIAL_CONNECTING:
+					/* Wait for the handshake */
+					fds[count].fd = serial_get_fd(&link->serial);
+					fds[count].events = POLLOUT;
+					count++;
+					break;
+					
+				case SERIAL_CONNECTED:
+					/* Clients blocking: stop reading while the queue is full, the clients writer kicks us once drained */
+					if(frameQueueFull(&link->rxQueue))
+					{
+						atomic_store(&link->rxWaiting, true);
+					}
+					
+					if(!frameQueueFull(&link->rxQueue))
+					{
+						fds[count].fd = serial_get_fd(&link->serial);
+						fds[count].events = POLLIN;
+						count++;
+					}
+					break;
+					
+				default:
+					break;
+			}
+		}
+		
+		/* Clients writer forwards them right away */
+		if(received)
+		{
+			threadWake(eventFd_interfaceService_tx);
+		}
+		
+		/* Sleep until a controller sends frames, or the next reconnection attempt while a link is down */
+		threadPoll(fds, count, linksTimeout(LINK_SHARD_NONE));
+	}
+	
+	threadRealTimeDeinit(faults);
+	
+	return NULL;
+}
+
+static void* thread_interfaceService_tx(void* arg)
+{
+	struct pollfd fds[1 + CLIENTS_MAX];
+	controllerLink_t* link;
+	client_t* client;
+	uint64_t faults;
+	uint32_t i, count;
+	
+	/* Pinned, prioritized and prefaulted before the first frame */
+	faults = threadRealTimeInit(REAL_TIME_INTERFACE_TX, "Interface Service tx");
+	
+	while(atomic_load(&systemStatus) == RUNNING)
+  	{
+		/* Write to Interface Service clients */
+		socketWrite();
+		
+		/* Controllers stopped on a full queue are read again */
+		for(i = 0; i < linksCount(); i++)
+		{
+			link = linksGet(i);
+			
+			if(!frameQueueFull(&link->rxQueue) && atomic_exchange(&link->rxWaiting, false))
+			{
+				threadWake(eventFd_controllerEmulator_rx);
+			}
+		}
+		
+		fds[0].fd = eventFd_interfaceService_tx;
+		fds[0].events = POLLIN;
+		count = 1;
+		
+		/* Lock mutex for shared resource */
+		pthread_mutex_lock(&mutexData_clients);
+		{
+			/* Clients with frames left: wait until their socket has room */
+			for(i = 0; i < CLIENTS_MAX; i++)
+			{
+				client = clientsGet(i);
+				
+				if((client->status == CLIENT_CONNECTED) && (frameQueueCount(&client->txQueue) > 0))
+				{
+					fds[count].fd = client->fd;
+					fds[count].events = POLLOUT;
+					count++;
+				}
+			}
+		}
+		/* Unlock mutex for shared resource */
+		pthread_mutex_unlock(&mutexData_clients);
+		
+		/* Sleep until the controllers send frames or a client has room */
+		threadPoll(fds, count, -1);
+	}	
+	
+	threadRealTimeDeinit(faults);
+	
+	return NULL;
+}
+
+static void* thread_interfaceService_rx(void* arg)
+{
+	struct pollfd fds[1 + CLIENTS_MAX];
+	uint32_t clientIndex[1 + CLIENTS_MAX];
+	bool readable[CLIENTS_MAX];
+	client_t* client;
+	uint32_t i, count;
+	uint64_t faults;
+	
+	/* Pinned, prioritized and prefaulted before the first frame */
+	faults = threadRealTimeInit(REAL_TIME_INTERFACE_RX, "Interface Service rx");
+	
+	/* Clients taken over may have data waiting already */
+	for(i = 0; i < CLIENTS_MAX; i++)
+	{
+		readable[i] = true;
+	}
+	
+	while(atomic_load(&systemStatus) == RUNNING)
+  	{
+		fds[0].fd = eventFd_interfaceService_rx;
+		fds[0].events = POLLIN;
+		count = 1;
+		
+		/* Lock mutex for shared resource */
+		pthread_mutex_lock(&mutexData_clients);
+		{
+			for(i = 0; i < CLIENTS_MAX; i++)
+			{
+				client = clientsGet(i);
+				
+				/* Read from the Interface Service clients that are readable, or stopped on a controller queue that has room now */
+				if(readable[i] || ((client->blockedLink >= 0) && !frameQueueFull(&linksGet(client->blockedLink)->txQueue)))
+				{
+					socketRead(client);
+				}
+				
+				readable[i] = false;
+				
+				/* Stopped on a full controller queue: the kernel holds its data until the link's writer kicks us */
+				if((client->status == CLIENT_CONNECTED) && ((client->blockedLink < 0) || !frameQueueFull(&linksGet(client->blockedLink)->txQueue)))
+				{
+					fds[count].fd = client->fd;
+					fds[count].events = POLLIN;
+					clientIndex[count] = i;
+					count++;
+				}
+			}
+		}
+		/* Unlock mutex for shared resource */
+		pthread_mutex_unlock(&mutexData_clients);
+		
+		/* Controller writer forwards them right away */
+		if(linksPending != 0)
+		{
+			linksPending = 0;
+			threadWake(eventFd_controllerEmulator_tx);
+		}
+		
+		/* Sleep until a client sends commands, connects, or a link's writer made room */
+		threadPoll(fds, count, -1);
+		
+		for(i = 1; i < count; i++)
+		{
+			readable[clientIndex[i]] |= (fds[i].revents != 0);
+		}
+	}	
+	
+	threadRealTimeDeinit(faults);
+	
+	return NULL;
+}
+
+static void* thread_shard(void* arg)
+{
+	shard_t* shard = (shard_t*) arg;
+	struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+	controllerLink_t* link;
+	char name[32];
+	uint64_t faults, id, linksReady;
+	uint32_t i;
+	int eventsCount, j;
+	
+	/* Pinned, prioritized and prefaulted before the first frame */
+	snprintf(name, sizeof(name), "Shard %u", shard->index);
+	faults = threadRealTimeInit(REAL_TIME_SHARD_BASE + shard->index, name);
+	
+	/* Carry on with frames left in queues and parsers, then watch every link of ours */
+	shardResume(shard);
+	
+	for(i = shard->index; i < linksCount(); i += shardsCount)
+	{
+		linkWatch(shard->epoll_fd, linksGet(i));
+	}
+	
+	while(atomic_load(&systemStatus) == RUNNING)
+	{
+		/* Same as the event loop, for our links only: wake up for the next reconnection attempt */
+		eventsCount = epoll_wait(shard->epoll_fd, events, EVENT_LOOP_MAX_EVENTS, linksTimeout(shard->index));
+		linksReady = 0;
+		
+		for(j = 0; j < eventsCount; j++)
+		{
+			id = events[j].data.u64;
+			
+			if(id == EVENT_ID_WAKE)
+			{
+				/* Commands queued or room made by the event loop, or shutdown */
+				threadWait(shard->wake_fd);
+				shardResume(shard);
+			}
+			else if(linkEvent(shard->epoll_fd, linksGet(id - EVENT_ID_LINK_BASE), events[j].events))
+			{
+				linksReady |= 1ULL << (id - EVENT_ID_LINK_BASE);
+			}
+		}
+		
+		for(i = shard->index; i < linksCount(); i += shardsCount)
+		{
+			link = linksGet(i);
+			linkReconnect(shard->epoll_fd, link, (linksReady & (1ULL << i)) != 0);
+			linkWatch(shard->epoll_fd, link);
+		}
+	}
+	
+	threadRealTimeDeinit(faults);
+	
+	return NULL;
+}
+
+static int serialRead(controllerLink_t* link)
+{
+	const char* frame;
+	const char* routed;
+	char renumbered[FRAME_MAX_SIZE];
+	uint32_t length, routedLength, room, errors;
+	uint64_t frames, received, unroutable;
+	frameFields_t fields;
+	char* space;
+	int bytes;
+	
+	while(1)
+	{
+		frames = 0;
+		received = 0;
+		unroutable = 0;
+		errors = link->parser.errors;
+		
+		/* Queue every complete frame already received */
+		while(!frameQueueFull(&link->rxQueue) && frameParserNext(&link->parser, &frame, &length))
+		{
+			frames++;
+			received += length;
+			
+			if(journal != NULL)
+			{
+				journalAppend(journal, JOURNAL_CONTROLLER, link->index, frame, length, link->parser.timestamp);
+			}
+			
+			/* Framing offer: answered by the link's writer, not forwarded */
+			if((linkFraming != LINK_FRAMING_TEXT) && linkFramingOffer(link, frame, length))
+			{
+				continue;
+			}
+			
+			/* Controllers number their own channels, clients see global ones */
+			routedLength = length;
+			
+			if((routed = routerFrameToGlobal(link->index, frame, &routedLength, renumbered)) == NULL)
+			{
+				/* One that doesn't even decode (a number out of range) is malformed, not unroutable */
+				if(frameDecode(frame, length, &fields))
+				{
+					unroutable++;
+				}
+				else
+				{
+					frameParserReject(&link->parser);
+				}
+				continue;
+			}
+			
+			length = routedLength;
+			frameQueuePush(&link->rxQueue, routed, length, link->parser.timestamp);
+			
+			if(stateTable != NULL)
+			{
+				stateTableUpdate(stateTable, routed, length);
+			}
+			
+			if(!quiet)
+			{
+				printf("RECEIVED from CONTROLLER EMULATOR (%s): %u bytes: %.*s", serial_get_name(&link->serial), length, (int) length, routed);
+			}
+		}
+		
+		metricsCountReceived(&link->right, frames, received, link->parser.errors - errors, unroutable);
+		
+		/* Queue full: the remaining data waits in the parser and in the kernel */
+		if(frameQueueFull(&link->rxQueue))
+		{
+			return 1;
+		}
+		
+		/* Read serial port straight into the parser */
+		space = frameParserSpace(&link->parser, &room);
+		bytes = serial_receive(&link->serial, space, room);
+	
+		if(bytes == -1)
+		{
+			if((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			{
+				return bytes;
+			}
+			
+			/* Any other error means the link is gone, same as end of stream */
+			perror("ERROR while reading serial port");
+			return 0;
+		}
+		
+		if(bytes == 0)
+		{
+			return bytes;
+		}
+		
+		frameParserCommit(&link->parser, bytes, latencyNow());
+	}
+}
+
+static int serialWrite(controllerLink_t* link)
+{
+	frame_t* frame;
+	uint32_t i;
+	uint64_t saved;
+	int32_t framing;
+	bool coalesced;
+	int bytes;
+	
+	while(1)
+	{
+		/* Nothing in flight: pick the next command for the controller */
+		if(link->txOffset == linkTxLength(link))
+		{
+			/* Link backed up or down: fold queued commands into the coalescer, the newest value of each output wins */
+			if((linkPolicy == FRAME_QUEUE_POLICY_COALESCE) && ((serial_get_state(&link->serial) != SERIAL_CONNECTED) || ((coalesceThreshold > 0) && ((link->coalescer.pending > 0) || (frameQueueCount(&link->txQueue) >= coalesceThreshold)))))
+			{
+				saved = link->coalescer.saved;
+				
+				while(((frame = frameQueuePeek(&link->txQueue)) != NULL) && coalescerPut(&link->coalescer, frame))
+				{
+					frameQueueRelease(&link->txQueue);
+				}
+				
+				atomic_fetch_add_explicit(&link->left.coalesced, link->coalescer.saved - saved, memory_order_relaxed);
+			}
+			
+			/* Link down: hold everything until it is back */
+			if(serial_get_state(&link->serial) != SERIAL_CONNECTED)
+			{
+				link->blocked = false;
+				return 1;
+			}
+			
+			/* Framing offered by the controller: answered in text, the commands after the answer are written in the framing agreed */
+			if((framing = atomic_exchange(&link->framingOffer, LINK_FRAMING_NONE)) != LINK_FRAMING_NONE)
+			{
+				link->txFrame.length = frameEncode(link->txFrame.data, FRAME_COMPACT_TYPE, FRAME_COMPACT_VERSION, (framing == LINK_FRAMING_BITMAP) ? FRAME_COMPACT_FLAG_BITMAP : 0);
+				link->txFrame.timestamp = latencyNow();
+				link->framing = (linkFraming_t) framing;
+				coalesced = false;
+			}
+			/* Coalesced commands are older than whatever is still queued */
+			else if(!(coalesced = coalescerTake(&link->coalescer, &link->txFrame)) && !frameQueuePop(&link->txQueue, &link->txFrame))
+			{
+				link->blocked = false;
+				return 0;
+			}
+			
+			linkEncode(link, coalesced);
+			link->txOffset = 0;
+		}
+		
+		/* Write serial port */
+		if(link->txWireLength > 0)
+		{
+			bytes = serial_send(&link->serial, &link->txWire[link->txOffset], link->txWireLength - link->txOffset);
+		}
+		else
+		{
+			bytes = serial_send(&link->serial, &link->txFrame.data[link->txOffset], link->txFrame.length - link->txOffset);
+		}
+		
+		if(bytes == -1)
+		{
+			if((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			{
+				/* Link backed up: keep the frame and retry when it is writable */
+				link->blocked = true;
+				return 1;
+			}
+			
+			/* Link broken: keep the frame, the reader notices the link is gone and reconnects */
+			perror("ERROR while writing serial port");
+			link->blocked = true;
+			return -1;
+		}
+		
+		link->txOffset += bytes;
+		
+		if(link->txOffset < linkTxLength(link))
+		{
+			link->blocked = true;
+			return 1;
+		}
+		
+		/* Bytes as they went on the wire, every command they carried counts as written */
+		atomic_fetch_add_explicit(&link->left.bytesSent, linkTxLength(link), memory_order_relaxed);
+		serialWritten(link, &link->txFrame);
+		
+		for(i = 0; i < link->txBatchCount; i++)
+		{
+			serialWritten(link, &link->txBatch[i]);
+		}
+	}
+}
+
+static void serialWritten(controllerLink_t* link, const frame_t* frame)
+{
+	const char* routed;
+	char renumbered[FRAME_MAX_SIZE];
+	uint32_t length;
+	
+	latencyHistogramRecord(link->latency, latencyNow() - frame->timestamp);
+	atomic_fetch_add_explicit(&link->left.framesSent, 1, memory_order_relaxed);
+	
+	/* Replayed if the link is lost */
+	coalescerRemember(&link->coalescer, frame);
+	
+	/* Outputs are published once the controller has been told, in global channels like the switches */
+	length = frame->length;
+	
+	if((stateTable != NULL) && ((routed = routerFrameToGlobal(link->index, frame->data, &length, renumbered)) != NULL))
+	{
+		stateTableUpdate(stateTable, routed, length);
+	}
+	
+	if(!quiet)
+	{
+		printf("WROTE to CONTROLLER EMULATOR (%s): %u bytes: %.*s\n", serial_get_name(&link->serial), frame->length, (int) frame->length, frame->data);
+	}
+}
+
+static void serialLinkDown(controllerLink_t* link)
+{
+	uint32_t i;
+	bool inFlight;
+	
+	/* Lock mutex for shared resource */
+	pthread_mutex_lock(&link->mutex);
+	{
+		/* Commands sharing a bitmap frame cut halfway were picked because they can be coalesced */
+		for(i = 0; (link->txOffset < linkTxLength(link)) && (i < link->txBatchCount); i++)
+		{
+			coalescerPut(&link->coalescer, &link->txBatch[i]);
+		}
+		
+		/* A new link speaks text until its controller offers compact framing again */
+		inFlight = (link->txOffset < linkTxLength(link));
+		link->txBatchCount = 0;
+		link->txWireLength = 0;
+		link->framing = LINK_FRAMING_TEXT;
+		atomic_store(&link->framingOffer, LINK_FRAMING_NONE);
+		
+		/* A command cut halfway is resent whole: folded into the coalescer if it can be, from its start otherwise */
+		if(inFlight && (coalescerPut(&link->coalescer, &link->txFrame) || (strncmp(link->txFrame.data, FRAME_COMPACT_OFFER, sizeof(FRAME_COMPACT_OFFER) - 1) == 0)))
+		{
+			/* (An answer to the old link's framing offer is dropped) */
+			link->txOffset = link->txFrame.length;
+		}
+		else if(inFlight)
+		{
+			link->txOffset = 0;
+		}
+		else
+		{
+			link->txOffset = link->txFrame.length;
+		}
+		
+		link->blocked = false;
+		
+		/* Bytes of a frame cut by the drop are garbage on the new link */
+		frameParserReset(&link->parser);
+		
+		serial_disconnect(&link->serial);
+		atomic_store_explicit(&link->up, 0, memory_order_relaxed);
+		atomic_fetch_add_explicit(&link->losses, 1, memory_order_relaxed);
+	}
+	/* Unlock mutex for shared resource */
+	pthread_mutex_unlock(&link->mutex);
+}
+
+static bool serialLinkPoll(controllerLink_t* link)
+{
+	bool restored = false;
+	uint32_t replayed;
+	
+	/* Lock mutex for shared resource */
+	pthread_mutex_lock(&link->mutex);
+	{
+		if(serial_reconnect_poll(&link->serial) == SERIAL_FAILED)
+		{
+			/* A link started without waiting for it: a misconfigured device fails the service now, not after endless retries */
+			fprintf(stderr, "ERROR Controller Emulator %s: %s.\r\n", serial_get_name(&link->serial), strerror(link->serial.openError));
+			exit(1);
+		}
+		else if(serial_get_state(&link->serial) == SERIAL_CONNECTED)
+		{
+			restored = true;
+			atomic_store_explicit(&link->up, 1, memory_order_relaxed);
+			
+			/* First connection of a link started without waiting for it: nothing to replay */
+			if(link->serial.lostAt != 0)
+			{
+				/* The controller may have restarted: send it the last known state of every output */
+				replayed = coalescerReplay(&link->coalescer, latencyNow());
+				printf("Controller Emulator %s link restored, %u output states replayed.\r\n", serial_get_name(&link->serial), replayed);
+				atomic_fetch_add_explicit(&link->reconnects, 1, memory_order_relaxed);
+			}
+		}
+	}
+	/* Unlock mutex for shared resource */
+	pthread_mutex_unlock(&link->mutex);
+	
+	return restored;
+}
+
+static uint32_t linkTxLength(const controllerLink_t* link)
+{
+	return (link->txWireLength > 0) ? link->txWireLength : link->txFrame.length;
+}
+
+static void linkEncode(controllerLink_t* link, bool coalesced)
+{
+	frameFields_t fields, next;
+	frame_t* queued;
+	uint32_t base, bit;
+	uint16_t present, values;
+	
+	link->txWireLength = 0;
+	link->txBatchCount = 0;
+	
+	/* Compact framing: commands it can't carry (sequenced, other types, big values) still go as text */
+	if((link->framing == LINK_FRAMING_TEXT) || !frameDecode(link->txFrame.data, link->txFrame.length, &fields) || ((link->txWireLength = frameEncodeCompact(link->txWire, &fields)) == 0))
+	{
+		return;
+	}
+	
+	/* Bitmap: on/off outputs of the same 16 channels already waiting ride in the same frame */
+	if((link->framing != LINK_FRAMING_BITMAP) || (strcmp(fields.type, "OUT") != 0) || (fields.value > 1) || (fields.channel >= link->coalescer.channels))
+	{
+		return;
+	}
+	
+	base = fields.channel & ~(FRAME_COMPACT_BITMAP_CHANNELS - 1);
+	present = (uint16_t) (1u << (fields.channel - base));
+	values = (uint16_t) (fields.value << (fields.channel - base));
+	
+	for(bit = 0; coalesced && (bit < FRAME_COMPACT_BITMAP_CHANNELS); bit++)
+	{
+		/* From the coalescer: the newest value of every neighbour, order doesn't matter between channels */
+		if(((present & (1u << bit)) == 0) && coalescerTakeChannel(&link->coalescer, base + bit, &link->txBatch[link->txBatchCount]))
+		{
+			frameDecode(link->txBatch[link->txBatchCount].data, link->txBatch[link->txBatchCount].length, &next);
+			
+			if(next.value > 1)
+			{
+				/* Not an on/off state: back where it was */
+				coalescerPut(&link->coalescer, &link->txBatch[link->txBatchCount]);
+				continue;
+			}
+			
+			present |= (uint16_t) (1u << bit);
+			values |= (uint16_t) (next.value << bit);
+			link->txBatchCount++;
+		}
+	}
+	
+	/* From the queue: only the commands right behind it, a channel written twice ends the batch */
+	while(!coalesced && ((queued = frameQueuePeek(&link->txQueue)) != NULL))
+	{
+		if(!frameDecode(queued->data, queued->length, &next) || next.sequenced || (strcmp(next.type, "OUT") != 0) || (next.value < 0) || (next.value > 1) || (next.channel < base) || (next.channel >= (base + FRAME_COMPACT_BITMAP_CHANNELS)) || (next.channel >= link->coalescer.channels) || (present & (1u << (next.channel - base))))
+		{
+			break;
+		}
+		
+		present |= (uint16_t) (1u << (next.channel - base));
+		values |= (uint16_t) (next.value << (next.channel - base));
+		frameQueuePop(&link->txQueue, &link->txBatch[link->txBatchCount++]);
+	}
+	
+	if(link->txBatchCount > 0)
+	{
+		link->txWireLength = frameEncodeBitmap(link->txWire, "OUT", base, present, values);
+	}
+}
+
+static bool linkFramingOffer(controllerLink_t* link, const char* frame, uint32_t length)
+{
+	frameFields_t fields;
+	linkFraming_t framing;
+	
+	/* ">BIN:version,flags\r\n": the controller reads compact frames */
+	if((length < (sizeof(FRAME_COMPACT_OFFER) - 1)) || (strncmp(frame, FRAME_COMPACT_OFFER, sizeof(FRAME_COMPACT_OFFER) - 1) != 0) || !frameDecode(frame, length, &fields))
+	{
+		return false;
+	}
+	
+	/* Another version: no answer, the controller keeps text */
+	if(fields.channel != FRAME_COMPACT_VERSION)
+	{
+		printf("Controller Emulator %s offered framing version %u, keeping text.\r\n", serial_get_name(&link->serial), fields.channel);
+		return true;
+	}
+	
+	framing = ((linkFraming == LINK_FRAMING_BITMAP) && (fields.value & FRAME_COMPACT_FLAG_BITMAP)) ? LINK_FRAMING_BITMAP : LINK_FRAMING_COMPACT;
+	atomic_store(&link->framingOffer, (int32_t) framing);
+	
+	printf("Controller Emulator %s: %s framing.\r\n", serial_get_name(&link->serial), (framing == LINK_FRAMING_BITMAP) ? "bitmap" : "compact");
+	
+	return true;
+}
+
+static int socketInit(char* ip, int port)
+{
+	/* Create socket */
+	int fd = socket(AF_INET,SOCK_STREAM | SOCK_CLOEXEC, 0);
+	int reuse = 1;
+	
+	/* Allow restarting the service (A/B runs) while old connections are in TIME_WAIT */
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	
+	/* Load server IP:PORT data */
+	bzero((char*) &serveraddr, sizeof(serveraddr));
+    	serveraddr.sin_family = AF_INET;
+    	serveraddr.sin_port = htons(port);
+    	if(inet_pton(AF_INET, ip, &(serveraddr.sin_addr)) <= 0)
+    	{
+        	fprintf(stderr,"ERROR invalid server IP.\r\n");
+        	exit(1);
+    	}
+    	
+    	/* Open TCP port */
+	if (bind(fd, (struct sockaddr*)&serveraddr, sizeof(serveraddr)) == -1) 
+	{
+		close(fd);
+		perror("ERROR bind() API");
+		exit(1);
+	}
+	
+	/* Set socket in listening mode */
+	if (listen (fd, 10) == -1)
+  	{
+    	    	perror("ERROR listen() API");
+    		exit(1);
+  	}
+
+	return fd;
+}
+
+static int socketInitUnix(const char* path)
+{
+	struct sockaddr_un address;
+	struct stat status;
+	int fd, probe_fd;
+	
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	
+	if(strlen(path) >= sizeof(address.sun_path))
+	{
+		fprintf(stderr, "ERROR unix socket path too long: %s\r\n", path);
+		exit(1);
+	}
+	
+	strcpy(address.sun_path, path);
+	
+	/* Create socket */
+	if((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+	{
+		perror("ERROR socket(AF_UNIX) API");
+		exit(1);
+	}
+	
+	/* Left behind by a previous run that didn't shut down: only a socket nobody listens on is removed */
+	if(lstat(path, &status) == 0)
+	{
+		if(!S_ISSOCK(status.st_mode))
+		{
+			fprintf(stderr, "ERROR %s exists and is not a unix socket.\r\n", path);
+			exit(1);
+		}
+		
+		if((probe_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+		{
+			perror("ERROR socket(AF_UNIX) API");
+			exit(1);
+		}
+		
+		if(connect(probe_fd, (struct sockaddr *) &address, sizeof(address)) == 0)
+		{
+			fprintf(stderr, "ERROR unix socket %s is in use by another process.\r\n", path);
+			exit(1);
+		}
+		
+		close(probe_fd);
+		unlink(path);
+	}
+	
+	/* Open unix socket and set it in listening mode */
+	if((bind(fd, (struct sockaddr *) &address, sizeof(address)) == -1) || (listen(fd, 10) == -1))
+	{
+		fprintf(stderr, "ERROR unix socket %s: %s\r\n", path, strerror(errno));
+		exit(1);
+	}
+	
+	return fd;
+}
+
+static bool socketTune(int fd)
+{
+	int domain = AF_INET, enable = 1;
+	socklen_t length = sizeof(domain);
+	
+	getsockopt(fd, SOL_SOCKET, SO_DOMAIN, &domain, &length);
+	
+	/* Fixed buffers turn the kernel's autotuning off, so only when asked to */
+	if(socketBuffer > 0)
+	{
+		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &socketBuffer, sizeof(socketBuffer));
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &socketBuffer, sizeof(socketBuffer));
+	}
+	
+	if(domain == AF_UNIX)
+	{
+		return false;
+	}
+	
+	/* Frames are a few bytes: send each one now instead of holding it for the previous one's ACK (Nagle) */
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+	
+	/* And ACK the client's frames right away instead of delaying the ACK */
+	setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &enable, sizeof(enable));
+	
+	return true;
+}
+
+static client_t* socketAccept(int listen_fd)
+{
+	struct sockaddr_storage clientaddr;
+	socklen_t addr_len = sizeof(clientaddr);
+	struct ucred credentials;
+	socklen_t credentials_len = sizeof(credentials);
+	char ipClient[CLIENT_NAME_SIZE];
+	client_t* client;
+	bool tcp;
+	int fd;
+	
+	/* Client sockets are non-blocking so a slow client never stalls a writer */
+	if((fd = accept4(listen_fd, (struct sockaddr *) &clientaddr, &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC)) == -1)
+	{
+		if(errno != EINTR)
+		{
+			perror("ERROR accept() API");
+		}
+		return NULL;
+	}
+	
+	/* Connection established */
+	if(clientaddr.ss_family == AF_INET)
+	{
+		inet_ntop(AF_INET, &(((struct sockaddr_in *) &clientaddr)->sin_addr), ipClient, sizeof(ipClient));
+	}
+	else if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &credentials_len) == 0)
+	{
+		/* Local client: unix sockets are unnamed, the peer's PID tells them apart */
+		snprintf(ipClient, sizeof(ipClient), "unix:%d", (int) credentials.pid);
+	}
+	else
+	{
+		snprintf(ipClient, sizeof(ipClient), "unix");
+	}
+	
+	tcp = socketTune(fd);
+	
+	/* Lock mutex for shared resource */
+	pthread_mutex_lock(&mutexData_clients);
+	{
+		if((client = clientsAdd(fd, ipClient)) != NULL)
+		{
+			client->quickAck = tcp;
+		}
+	}
+	/* Unlock mutex for shared resource */
+	pthread_mutex_unlock(&mutexData_clients);
+	
+	if(client == NULL)
+	{
+		printf("SERVER: connection from %s rejected, %d clients already connected.\n\n", ipClient, CLIENTS_MAX);
+		close(fd);
+		return NULL;
+	}
+	
+	printf("SERVER: connection from: %s (%u clients)\n\n", ipClient, clientsCount());
+	
+	return client;
+}
+
+static void socketClose(client_t* client)
+{
+	/* Called with mutexData_clients locked */
+	printf("SERVER: %s disconnected.\n\n", client->name);
+	
+	ackForget(client);
+	clientsRelease(client);
+}
+
+static int socketRead(client_t* client)
+{
+	const char* frame;
+	const char* routed;
+	char renumbered[FRAME_MAX_SIZE];
+	uint32_t length, routedLength, room, errors, index;
+	uint64_t frames, received, unroutable;
+	frameFields_t fields;
+	controllerLink_t* link;
+	controllerLink_t* blocked;
+	char* space;
+	int bytes, enable = 1;
+	
+	while(client->status == CLIENT_CONNECTED)
+	{
+		frames = 0;
+		received = 0;
+		unroutable = 0;
+		errors = client->parser.errors;
+		blocked = NULL;
+		client->blockedLink = -1;
+		
+		/* Queue every complete frame already received */
+		while(frameParserNext(&client->parser, &frame, &length))
+		{
+			/* Clients number channels globally: find the controller and its own number for the channel */
+			routedLength = length;
+			
+			if((routed = routerFrameToLink(frame, &routedLength, &index, renumbered)) == NULL)
+			{
+				frames++;
+				received += length;
+				
+				/* One that doesn't even decode (a number out of range) is malformed, not unroutable */
+				if(frameDecode(frame, length, &fields))
+				{
+					unroutable++;
+				}
+				else
+				{
+					frameParserReject(&client->parser);
+				}
+				
+				if(journal != NULL)
+				{
+					journalAppend(journal, JOURNAL_INTERFACE, JOURNAL_LINK_NONE, frame, length, client->parser.timestamp);
+				}
+				continue;
+			}
+			
+			link = linksGet(index);
+			
+			/* That controller's queue is full and not dropping: the frame stays in the parser until it has room */
+			if(frameQueueFull(&link->txQueue) && !linkDropping())
+			{
+				frameParserUnget(&client->parser, length);
+				blocked = link;
+				break;
+			}
+			
+			frames++;
+			received += length;
+			
+			/* Recorded as received, whatever the link policy does with it */
+			if(journal != NULL)
+			{
+				journalAppend(journal, JOURNAL_INTERFACE, index, frame, length, client->parser.timestamp);
+			}
+			
+			/* Queue full and dropping: make room by discarding the oldest command, or discard this one (the writer may have drained it meanwhile) */
+			if(frameQueueFull(&link->txQueue) && !linkDropOldest(link) && frameQueueFull(&link->txQueue))
+			{
+				atomic_fetch_add_explicit(&link->left.dropped, 1, memory_order_relaxed);
+				
+				if(ackWindow > 0)
+				{
+					ackRefuse(client, frame, length);
+				}
+				continue;
+			}
+			
+			/* Sequenced command: renumbered for the link, its ACK goes back to this client only */
+			if((ackWindow > 0) && ((routed = ackTrack(client, link, routed, &routedLength, renumbered)) == NULL))
+			{
+				atomic_fetch_add_explicit(&link->left.dropped, 1, memory_order_relaxed);
+				continue;
+			}
+			
+			/* Only this thread pushes and the check above left room, yet a lost command must never go uncounted */
+			if(!frameQueuePush(&link->txQueue, routed, routedLength, client->parser.timestamp))
+			{
+				atomic_fetch_add_explicit(&link->left.dropped, 1, memory_order_relaxed);
+				
+				if(ackWindow > 0)
+				{
+					ackCancel(link, routed, routedLength);
+				}
+				continue;
+			}
+			
+			linksPending |= 1ULL << index;
+			
+			if(!quiet)
+			{
+				printf("RECEIVED from INTERFACE SERVICE (%s): %u bytes: %.*s", client->name, length, (int) length, frame);
+			}
+		}
+		
+		metricsCountReceived(&metrics_left, frames, received, client->parser.errors - errors, unroutable);
+		
+		/* Queue full: the remaining data waits in the parser and in the kernel, the link's writer says when it has room */
+		if(blocked != NULL)
+		{
+			client->blockedLink = (int32_t) blocked->index;
+			atomic_store(&blocked->txWaiting, true);
+			return 1;
+		}
+		
+		/* Read socket straight into the parser */
+		space = frameParserSpace(&client->parser, &room);
+		bytes = read(client->fd, space, room);
+
+		if(bytes == -1)
+		{
+			/* Non-blocking socket without pending data */
+			if((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			{
+				return bytes;
+			}
+			
+			perror("ERROR while listening socket");
+		}
+		
+		if(bytes <= 0)
+		{
+			socketClose(client);
+			return 0;
+		}
+		
+		frameParserCommit(&client->parser, bytes, latencyNow());
+		
+		/* TCP_QUICKACK isn't sticky */
+		if(client->quickAck)
+		{
+			setsockopt(client->fd, IPPROTO_TCP, TCP_QUICKACK, &enable, sizeof(enable));
+		}
+	}
+	
+	return 0;
+}
+
+static void socketWrite(void) 
+{
+	frame_t* frame;
+	client_t* client;
+	controllerLink_t* link;
+	uint32_t i, moved, clientsQueued;
+	bool more;
+	
+	/* Lock mutex for shared resource */
+	pthread_mutex_lock(&mutexData_clients);
+	{
+		do
+		{
+			more = false;
+			
+			/* Copy a batch of frames from every Controller Emulator into each client's send queue (block policy: while they all have room) */
+			for(i = 0; i < linksCount(); i++)
+			{
+				link = linksGet(i);
+				
+				for(moved = 0; (moved < SOCKET_WRITE_BATCH) && clientsWritable() && ((frame = frameQueuePeek(&link->rxQueue)) != NULL); moved++)
+				{
+					/* The ACK of a command we numbered goes to the client that sent it, anything else to all of them */
+					if((ackWindow == 0) || !ackComplete(link, frame))
+					{
+						clientsQueued = clientsBroadcast(frame);
+						
+						if(!quiet)
+						{
+							printf("WROTE to INTERFACE SERVICE (%u clients): %u bytes: %.*s\n", clientsQueued, frame->length, (int) frame->length, frame->data);
+						}
+					}
+					
+					frameQueueRelease(&link->rxQueue);
+				}
+				
+				/* One batch per link and round, so a busy controller doesn't hold back the others */
+				more |= (moved == SOCKET_WRITE_BATCH);
+			}
+			
+			/* Write queued frames to every client without blocking */
+			for(i = 0; i < CLIENTS_MAX; i++)
+			{
+				client = clientsGet(i);
+				
+				if((client->status == CLIENT_CONNECTED) && (clientsFlush(client) == -1))
+				{
+					socketClose(client);
+				}
+			}
+		}
+		while(more);
+	}
+	/* Unlock mutex for shared resource */
+	pthread_mutex_unlock(&mutexData_clients);
+}
+
+static const char* ackTrack(client_t* client, controllerLink_t* link, const char* frame, uint32_t* length, char* buffer)
+{
+	frameFields_t fields;
+	inflightEntry_t entry, expired;
+	
+	/* Plain commands go through untouched */
+	if(!frameDecode(frame, *length, &fields) || !fields.sequenced)
+	{
+		return frame;
+	}
+	
+	entry.client = (int32_t) client->index;
+	entry.clientSeq = fields.seq;
+	entry.channel = routerIdentity() ? fields.channel : routerToGlobal(link->index, fields.channel);
+	entry.timestamp = client->parser.timestamp;
+	
+	/* The window wrapped onto a command that was never acknowledged: its client is told it was given up on */
+	if(inflightTrack(&link->inflight, &entry, &expired))
+	{
+		ackSend(&expired, "NAK", 0, entry.timestamp);
+	}
+	
+	/* Every client numbers its own commands, the controller sees the link's numbers */
+	fields.seq = entry.seq;
+	
+	if((*length = frameEncodeFields(buffer, &fields)) == 0)
+	{
+		inflightComplete(&link->inflight, entry.seq, &entry);
+		ackSend(&entry, "NAK", 0, entry.timestamp);
+		return NULL;
+	}
+	
+	return buffer;
+}
+
+static void ackRefuse(client_t* client, const char* frame, uint32_t length)
+{
+	frameFields_t fields;
+	inflightEntry_t entry;
+	
+	/* A sequenced command dropped on a full controller queue is refused right away */
+	if(!frameDecode(frame, length, &fields) || !fields.sequenced)
+	{
+		return;
+	}
+	
+	entry.client = (int32_t) client->index;
+	entry.clientSeq = fields.seq;
+	entry.channel = fields.channel;
+	
+	ackSend(&entry, "NAK", 0, client->parser.timestamp);
+}
+
+static void ackCancel(controllerLink_t* link, const char* frame, uint32_t length)
+{
+	frameFields_t fields;
+	inflightEntry_t entry;
+	
+	/* A sequenced command tracked but never queued: its client is told it was given up on */
+	if(frameDecode(frame, length, &fields) && fields.sequenced && inflightComplete(&link->inflight, fields.seq, &entry))
+	{
+		ackSend(&entry, "NAK", 0, entry.timestamp);
+	}
+}
+
+static bool ackComplete(controllerLink_t* link, const frame_t* frame)
+{
+	frameFields_t fields;
+	inflightEntry_t entry;
+	uint64_t elapsed;
+	
+	/* Only ACKs of commands we numbered are ours, any other sequence number passes through */
+	if((frame->length < 5) || (memcmp(frame->data, ">ACK:", 5) != 0) || !frameDecode(frame->data, frame->length, &fields) || !fields.sequenced || !inflightComplete(&link->inflight, fields.seq, &entry))
+	{
+		return false;
+	}
+	
+	/* Round trip as the Serial Service sees it: command received from the client -> ACK received from the controller */
+	elapsed = frame->timestamp - entry.timestamp;
+	latencyHistogramRecord(&latency_acks, elapsed);
+	ackSend(&entry, "ACK", (int32_t) (elapsed / 1000), frame->timestamp);
+	
+	return true;
+}
+
+static void ackSend(const inflightEntry_t* entry, const char* type, int32_t value, uint64_t timestamp)
+{
+	frameFields_t fields;
+	frame_t frame;
+	
+	/* ">ACK:channel,rtt_us,seq\r\n" or ">NAK:channel,0,seq\r\n", in the client's own sequence numbers */
+	snprintf(fields.type, sizeof(fields.type), "%s", type);
+	fields.channel = entry->channel;
+	fields.value = value;
+	fields.sequenced = true;
+	fields.seq = entry->clientSeq;
+	frame.length = frameEncodeFields(frame.data, &fields);
+	frame.timestamp = timestamp;
+	
+	atomic_fetch_add_explicit((type[0] == 'A') ? &acksSent : &naksSent, 1, memory_order_relaxed);
+	
+	if((frame.length == 0) || !clientsSend(clientsGet((uint32_t) entry->client), &frame))
+	{
+		return;
+	}
+	
+	if(!quiet)
+	{
+		printf("WROTE to INTERFACE SERVICE (%s): %u bytes: %.*s\n", clientsGet((uint32_t) entry->client)->name, frame.length, (int) frame.length, frame.data);
+	}
+}
+
+static void ackForget(client_t* client)
+{
+	uint32_t i;
+	
+	/* Its slot may be reused by the next connection, which must not get these ACKs */
+	for(i = 0; (ackWindow > 0) && (i < linksCount()); i++)
+	{
+		inflightForget(&linksGet(i)->inflight, (int32_t) client->index);
+	}
+}
+
+static bool linkDropping(void)
+{
+	/* The other policies stop reading clients while the controller queue is full */
+	return (linkPolicy == FRAME_QUEUE_POLICY_DROP_OLDEST) || (linkPolicy == FRAME_QUEUE_POLICY_DROP_NEWEST);
+}
+
+static bool linkDropOldest(controllerLink_t* link)
+{
+	frame_t oldest;
+	bool dropped;
+	
+	if(linkPolicy != FRAME_QUEUE_POLICY_DROP_OLDEST)
+	{
+		return false;
+	}
+	
+	/* Lock mutex for shared resource: the controller writer consumes under it, the drop takes its place as the consumer */
+	pthread_mutex_lock(&link->mutex);
+	{
+		dropped = frameQueuePop(&link->txQueue, &oldest);
+	}
+	/* Unlock mutex for shared resource */
+	pthread_mutex_unlock(&link->mutex);
+	
+	if(dropped)
+	{
+		atomic_fetch_add_explicit(&link->left.dropped, 1, memory_order_relaxed);
+		
+		/* The evicted command may be a sequenced one still in the window */
+		if(ackWindow > 0)
+		{
+			ackCancel(link, oldest.data, oldest.length);
+		}
+	}
+	
+	return dropped;
+}
+
+static void mutexInit(void)
+{
+	if (pthread_mutex_init(&mutexData_clients, NULL) != 0)
+	{
+		perror("ERROR pthread_mutex_init() API");
+		exit(1);
+	}
+	
+	if (pthread_mutex_init(&mutexData_systemStatus, NULL) != 0)
+	{
+		perror("ERROR pthread_mutex_init() API");
+		exit(1);
+	}
+}
+
+static void queuesInit(uint32_t depth)
+{
+	uint32_t links = (serialDevicesCount > 0) ? serialDevicesCount : 1;
+	uint32_t i;
+	
+	/* Global channel -> (link, local channel): a routes file, or contiguous ranges of linkChannels */
+	if(((routesPath == NULL) && (routerInit(links, linkChannels) != 0)) || ((routesPath != NULL) && (routerLoad(routesPath, links) != 0)))
+	{
+		exit(1);
+	}
+	
+	/* Hop latency per direction, delivery to clients is recorded as frames leave their send queues */
+	latencyHistogramInit(&latency_right, "Controller Emulator -> Interface Service");
+	latencyHistogramInit(&latency_left, "Interface Service -> Controller Emulator");
+	latencyHistogramInit(&latency_acks, "Command round trip (ACK)");
+	
+	/* One single-producer/single-consumer queue per link and direction, a frame parser and a coalescer per link */
+	if(linksInit(links, depth, ackWindow) != 0)
+	{
+		exit(1);
+	}
+	
+	for(i = 0; i < linksCount(); i++)
+	{
+		linksGet(i)->latency = &latency_left;
+		
+		/* Compact frames are read as soon as allowed, a controller only sends them once answered */
+		frameParserCompact(&linksGet(i)->parser, linkFraming != LINK_FRAMING_TEXT);
+		
+		if(serial_config(&linksGet(i)->serial, serialTransportName, (serialDevicesCount > 0) ? serialDevices[i] : NULL, serialFlags) != 0)
+		{
+			exit(1);
+		}
+	}
+	
+	/* Per-client send queues and frame parsers */
+	clientsInit(depth, routerChannels(), &latency_right, &metrics_right, clientsPolicy);
+	
+	/* Threads serving the links, if any */
+	shardsInit();
+}
+
+static int signalInit(void)
+{
+	sigset_t set;
+	int fd;
+	
+	/* A peer closing its socket must not kill the service: writes fail with EPIPE instead */
+	signal(SIGPIPE, SIG_IGN);
+	
+	/* A hot restart replacement that fails to start is reaped by the kernel */
+	signal(SIGCHLD, SIG_IGN);
+	
+	/* Blocked in every thread (threads inherit the mask), delivered only through the descriptor */
+	signalBlock();
+	
+	sigemptyset(&set);
+	sigaddset(&set, SIGINT);
+	sigaddset(&set, SIGTERM);
+	sigaddset(&set, SIGUSR1);
+	sigaddset(&set, SIGHUP);
+	
+	if((fd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC)) == -1)
+	{
+		perror("ERROR signalfd() API");
+		exit(1);
+	}
+	
+	return fd;
+}
+
+static void signalRead(int signal_fd)
+{
+	struct signalfd_siginfo info;
+	
+	/* Plain code on the main thread: printing and locking are safe here */
+	while(read(signal_fd, &info, sizeof(info)) == sizeof(info))
+	{
+		switch(info.ssi_signo)
+		{
+			case SIGINT:
+			case SIGTERM:
+				printf("\n%s signal received.\r\n\n", (info.ssi_signo == SIGINT) ? "SIGINT" : "SIGTERM");
+				
+				/* Lock mutex for shared resource */
+				pthread_mutex_lock(&mutexData_systemStatus);
+				{
+					/* A second signal doesn't restart the clock */
+					if(atomic_load(&systemStatus) == RUNNING)
+					{
+						shutdownStart = latencyNow();
+					}
+					
+					atomic_store(&systemStatus, EXIT);
+				}
+				/* Unlock mutex for shared resource */
+				pthread_mutex_unlock(&mutexData_systemStatus);
+				break;
+				
+			case SIGUSR1:
+				latencyPrint();
+				break;
+				
+			case SIGHUP:
+				/* Hot restart: start the (possibly upgraded) binary, it connects back and takes over */
+				if((restart_fd >= 0) && (atomic_load(&systemStatus) == RUNNING))
+				{
+					printf("SIGHUP signal received, starting replacement.\r\n");
+					hotRestartSpawn(programPath, programArgv);
+				}
+				break;
+				
+			default:
+				break;
+		}
+	}
+}
+
+static void latencyPrint(void)
+{
+	static latencyHistogram_t merged;
+	
+	latencyHistogramPrint(&latency_right);
+	latencyHistogramPrint(latencyLeft(&merged));
+	
+	if(ackWindow > 0)
+	{
+		latencyHistogramPrint(&latency_acks);
+	}
+	
+	printf("\n");
+}
+
+static latencyHistogram_t* latencyLeft(latencyHistogram_t* merged)
+{
+	uint32_t i;
+	
+	/* Each shard records the links it writes to, merged for reading */
+	if(shardsCount == 0)
+	{
+		return &latency_left;
+	}
+	
+	latencyHistogramInit(merged, latency_left.name);
+	
+	for(i = 0; i < shardsCount; i++)
+	{
+		latencyHistogramMerge(merged, &shards[i].latency);
+	}
+	
+	return merged;
+}
+
+static void metricsCountReceived(metricsDirection_t* metrics, uint64_t frames, uint64_t bytes, uint64_t errors, uint64_t unroutable)
+{
+	/* Once per read, not per frame: most reads parse a batch */
+	if(frames > 0)
+	{
+		atomic_fetch_add_explicit(&metrics->framesReceived, frames, memory_order_relaxed);
+		atomic_fetch_add_explicit(&metrics->bytesReceived, bytes, memory_order_relaxed);
+	}
+	
+	if(errors > 0)
+	{
+		atomic_fetch_add_explicit(&metrics->parseErrors, errors, memory_order_relaxed);
+	}
+	
+	if(unroutable > 0)
+	{
+		atomic_fetch_add_explicit(&metrics->unroutable, unroutable, memory_order_relaxed);
+	}
+}
+
+static uint64_t metricsTotal(uint32_t direction, size_t counter)
+{
+	metricsDirection_t* metrics;
+	uint64_t total;
+	uint32_t i;
+	
+	/* The clients side of a direction, plus the side every link counts on its own */
+	metrics = (direction == 0) ? &metrics_right : &metrics_left;
+	total = atomic_load_explicit((_Atomic uint64_t*) ((char*) metrics + counter), memory_order_relaxed);
+	
+	for(i = 0; i < linksCount(); i++)
+	{
+		metrics = (direction == 0) ? &linksGet(i)->right : &linksGet(i)->left;
+		total += atomic_load_explicit((_Atomic uint64_t*) ((char*) metrics + counter), memory_order_relaxed);
+	}
+	
+	return total;
+}
+
+static void metricsRender(metricsBuffer_t* buffer)
+{
+	/* Metrics thread: only atomics are read here, the forwarding threads never wait for a scrape */
+	static const char* directions[2] = { "direction=\"controller_to_clients\"", "direction=\"clients_to_controller\"" };
+	static const struct
+	{
+		const char* name;
+		const char* help;
+		size_t counter;
+	} counters[] =
+	{
+		{ "serialservice_frames_received_total", "Complete frames parsed from the source.", offsetof(metricsDirection_t, framesReceived) },
+		{ "serialservice_bytes_received_total", "Bytes of the complete frames parsed from the source.", offsetof(metricsDirection_t, bytesReceived) },
+		{ "serialservice_frames_sent_total", "Frames written whole to the destination, once per client.", offsetof(metricsDirection_t, framesSent) },
+		{ "serialservice_bytes_sent_total", "Bytes of the frames written whole to the destination.", offsetof(metricsDirection_t, bytesSent) },
+		{ "serialservice_parse_errors_total", "Malformed or oversized frames discarded.", offsetof(metricsDirection_t, parseErrors) },
+		{ "serialservice_frames_unroutable_total", "Frames discarded because their channel has no route.", offsetof(metricsDirection_t, unroutable) },
+		{ "serialservice_frames_dropped_total", "Frames lost because the destination queue was full.", offsetof(metricsDirection_t, dropped) },
+		{ "serialservice_frames_coalesced_total", "Frames overwritten by a newer value of the same output or switch while the destination was backed up.", offsetof(metricsDirection_t, coalesced) }
+	};
+	static latencyHistogram_t merged;
+	controllerLink_t* link;
+	uint64_t queued[2] = { 0, 0 }, capacity = 0;
+	char labels[64];
+	uint32_t i, j;
+	
+	for(i = 0; i < (sizeof(counters) / sizeof(counters[0])); i++)
+	{
+		metricsHeader(buffer, counters[i].name, "counter", counters[i].help);
+		
+		for(j = 0; j < 2; j++)
+		{
+			metricsValue(buffer, counters[i].name, directions[j], metricsTotal(j, counters[i].counter));
+		}
+	}
+	
+	for(i = 0; i < linksCount(); i++)
+	{
+		queued[0] += frameQueueCount(&linksGet(i)->rxQueue);
+		queued[1] += frameQueueCount(&linksGet(i)->txQueue);
+		capacity += linksGet(i)->rxQueue.mask + 1;
+	}
+	
+	metricsHeader(buffer, "serialservice_queue_frames", "gauge", "Frames waiting in the cross-communication queues.");
+	for(i = 0; i < 2; i++)
+	{
+		metricsValue(buffer, "serialservice_queue_frames", directions[i], queued[i]);
+	}
+	
+	metricsHeader(buffer, "serialservice_queue_capacity", "gauge", "Depth of the cross-communication queues.");
+	for(i = 0; i < 2; i++)
+	{
+		metricsValue(buffer, "serialservice_queue_capacity", directions[i], capacity);
+	}
+	
+	metricsHeader(buffer, "serialservice_link_up", "gauge", "1 while the Controller Emulator link is connected.");
+	for(i = 0; i < linksCount(); i++)
+	{
+		snprintf(labels, sizeof(labels), "link=\"%u\"", i);
+		metricsValue(buffer, "serialservice_link_up", labels, atomic_load_explicit(&linksGet(i)->up, memory_order_relaxed));
+	}
+	
+	metricsHeader(buffer, "serialservice_link_losses_total", "counter", "Controller Emulator link drops.");
+	for(i = 0; i < linksCount(); i++)
+	{
+		snprintf(labels, sizeof(labels), "link=\"%u\"", i);
+		metricsValue(buffer, "serialservice_link_losses_total", labels, atomic_load_explicit(&linksGet(i)->losses, memory_order_relaxed));
+	}
+	
+	metricsHeader(buffer, "serialservice_link_reconnects_total", "counter", "Controller Emulator link restored after a drop.");
+	for(i = 0; i < linksCount(); i++)
+	{
+		snprintf(labels, sizeof(labels), "link=\"%u\"", i);
+		metricsValue(buffer, "serialservice_link_reconnects_total", labels, atomic_load_explicit(&linksGet(i)->reconnects, memory_order_relaxed));
+	}
+	
+	metricsHeader(buffer, "serialservice_link_frames_total", "counter", "Frames received from and commands written to each Controller Emulator.");
+	for(i = 0; i < linksCount(); i++)
+	{
+		link = linksGet(i);
+		snprintf(labels, sizeof(labels), "link=\"%u\",%s", i, directions[0]);
+		metricsValue(buffer, "serialservice_link_frames_total", labels, atomic_load_explicit(&link->right.framesReceived, memory_order_relaxed));
+		snprintf(labels, sizeof(labels), "link=\"%u\",%s", i, directions[1]);
+		metricsValue(buffer, "serialservice_link_frames_total", labels, atomic_load_explicit(&link->left.framesSent, memory_order_relaxed));
+	}
+	
+	metricsHeader(buffer, "serialservice_link_queue_frames", "gauge", "Frames waiting in each Controller Emulator's queues.");
+	for(i = 0; i < linksCount(); i++)
+	{
+		link = linksGet(i);
+		snprintf(labels, sizeof(labels), "link=\"%u\",%s", i, directions[0]);
+		metricsValue(buffer, "serialservice_link_queue_frames", labels, frameQueueCount(&link->rxQueue));
+		snprintf(labels, sizeof(labels), "link=\"%u\",%s", i, directions[1]);
+		metricsValue(buffer, "serialservice_link_queue_frames", labels, frameQueueCount(&link->txQueue));
+	}
+	
+	metricsHeader(buffer, "serialservice_clients", "gauge", "Interface Service clients connected.");
+	metricsValue(buffer, "serialservice_clients", NULL, clientsConnected());
+	
+	metricsHeader(buffer, "serialservice_latency_seconds", "histogram", "Time from a frame being received to being written whole, per hop.");
+	metricsHistogram(buffer, "serialservice_latency_seconds", directions[0], &latency_right);
+	metricsHistogram(buffer, "serialservice_latency_seconds", directions[1], latencyLeft(&merged));
+	
+	if(ackWindow > 0)
+	{
+		metricsHeader(buffer, "serialservice_commands_acknowledged_total", "counter", "Sequenced commands answered to their client: ACK from the controller, or NAK when given up on.");
+		metricsValue(buffer, "serialservice_commands_acknowledged_total", "result=\"ack\"", atomic_load_explicit(&acksSent, memory_order_relaxed));
+		metricsValue(buffer, "serialservice_commands_acknowledged_total", "result=\"nak\"", atomic_load_explicit(&naksSent, memory_order_relaxed));
+		
+		metricsHeader(buffer, "serialservice_command_rtt_seconds", "histogram", "Time from a sequenced command being received to its ACK being received from the controller.");
+		metricsHistogram(buffer, "serialservice_command_rtt_seconds", NULL, &latency_acks);
+	}
+}
+
+static void signalBlock(void)
+{
+	sigset_t set;
 	
 	sigemptyset(&set);
 	sigaddset(&set, SIGINT);
 	sigaddset(&set, SIGTERM);
+	sigaddset(&set, SIGUSR1);
+	sigaddset(&set, SIGHUP);
+	
+	if((pthread_sigmask(SIG_BLOCK, &set, NULL)) != 0)
+	{
+		perror("ERROR pthread_sigmask(SIG_BLOCK) API");
+		exit(1);
+	}
+}
+
+static uint32_t shutdownPending(void)
+{
+	controllerLink_t* link;
+	client_t* client;
+	uint32_t i, pending = 0;
+	
+	/* Frames accepted by the service but not delivered yet */
+	for(i = 0; i < linksCount(); i++)
+	{
+		link = linksGet(i);
+		pending += frameQueueCount(&link->txQueue) + link->coalescer.pending + frameQueueCount(&link->rxQueue);
+		pending += (link->txOffset < linkTxLength(link)) ? (1 + link->txBatchCount) : 0;
+	}
+	
+	for(i = 0; i < CLIENTS_MAX; i++)
+	{
+		client = clientsGet(i);
+		
+		if(client->status == CLIENT_CONNECTED)
+		{
+			pending += frameQueueCount(&client->txQueue) + client->coalescer.pending;
+		}
+	}
+	
+	return pending;
+}
+
+static void shutdownDrain(void)
+{
+	struct pollfd fds[CLIENTS_MAX + LINKS_MAX];
+	uint64_t deadline = shutdownStart + ((uint64_t) SHUTDOWN_DRAIN_MS * 1000000ULL);
+	uint64_t now;
+	controllerLink_t* link;
+	client_t* client;
+	uint32_t i, count;
+	
+	/* Nothing else runs anymore: no new input is read, what was already read goes out within SHUTDOWN_DRAIN_MS */
+	while(1)
+	{
+		count = 0;
+		
+		/* Commands to the Controller Emulators (a link that is down can't be drained) */
+		for(i = 0; i < linksCount(); i++)
+		{
+			link = linksGet(i);
+			
+			if((serial_get_state(&link->serial) == SERIAL_CONNECTED) && (serialWrite(link) == 1))
+			{
+				fds[count].fd = serial_get_fd(&link->serial);
+				fds[count].events = POLLOUT;
+				count++;
+			}
+		}
+		
+		/* Frames to the Interface Service clients */
+		socketWrite();
+		
+		for(i = 0; i < CLIENTS_MAX; i++)
+		{
+			client = clientsGet(i);
+			
+			if((client->status == CLIENT_CONNECTED) && (frameQueueCount(&client->txQueue) > 0))
+			{
+				fds[count].fd = client->fd;
+				fds[count].events = POLLOUT;
+				count++;
+			}
+		}
+		
+		now = latencyNow();
+		
+		if((count == 0) || (now >= deadline))
+		{
+			return;
+		}
+		
+		/* Wait until some destination has room again */
+		poll(fds, count, (int) ((deadline - now + 999999ULL) / 1000000ULL));
+	}
+}
+
+static uint64_t threadRealTimeInit(uint32_t index, const char* name)
+{
+	realTimeThreadInit(&realTime, index, name);
+	
+	/* Faults from here on are taken while forwarding */
+	return realTimePageFaults();
+}
+
+static void threadRealTimeDeinit(uint64_t faults)
+{
+	forwardingFaults += realTimePageFaults() - faults;
+}
+
+static void handoffAccept(void)
+{
+	/* One replacement at a time */
+	if((handoff_fd != -1) || ((handoff_fd = hotRestartAccept(restart_fd)) == -1))
+	{
+		return;
+	}
+	
+	printf("Hot restart: replacement connected, handing over.\r\n");
+	
+	/* Lock mutex for shared resource */
+	pthread_mutex_lock(&mutexData_systemStatus);
+	{
+		atomic_store(&systemStatus, HANDOFF);
+	}
+	/* Unlock mutex for shared resource */
+	pthread_mutex_unlock(&mutexData_systemStatus);
+}
+
+static int handoffAppendFrames(hotRestartMessage_t* message, const frame_t* frames, uint32_t count)
+{
+	if(hotRestartAppend(message, &count, sizeof(count)) != 0)
+	{
+		return -1;
+	}
+	
+	return hotRestartAppend(message, frames, count * sizeof(frame_t));
+}
+
+static int handoffAppendQueue(hotRestartMessage_t* message, frameQueue_t* queue)
+{
+	frame_t** frames;
+	uint32_t count = frameQueueCount(queue), i;
+	int result;
+	
+	/* Copied, not consumed: the queue is still ours if the replacement fails */
+	if((frames = malloc((count + 1) * sizeof(frame_t*))) == NULL)
+	{
+		return -1;
+	}
+	
+	count = frameQueuePeekMany(queue, frames, count);
+	result = hotRestartAppend(message, &count, sizeof(count));
+	
+	for(i = 0; (i < count) && (result == 0); i++)
+	{
+		result = hotRestartAppend(message, frames[i], sizeof(frame_t));
+	}
+	
+	free(frames);
+	
+	return result;
+}
+
+static uint32_t handoffTakeFrames(hotRestartMessage_t* message, frameQueue_t* queue, coalescer_t* coalescer, bool written)
+{
+	frame_t frame;
+	uint32_t count, i, lost = 0;
+	
+	if(!hotRestartTake(message, &count, sizeof(count)))
+	{
+		return 0;
+	}
+	
+	/* Into a queue, or back into a coalescer (pending values or last written ones) */
+	for(i = 0; (i < count) && hotRestartTake(message, &frame, sizeof(frame)); i++)
+	{
+		if(queue != NULL)
+		{
+			lost += frameQueuePush(queue, frame.data, frame.length, frame.timestamp) ? 0 : 1;
+		}
+		else if(written)
+		{
+			coalescerRemember(coalescer, &frame);
+		}
+		else
+		{
+			coalescerPut(coalescer, &frame);
+		}
+	}
+	
+	/* Queue smaller than the previous process's */
+	return lost;
+}
+
+static int handoffSend(int socket_base_fd)
+{
+	hotRestartMessage_t message;
+	handoffHeader_t header;
+	handoffLink_t linkRecord;
+	handoffClient_t record;
+	frame_t* frames;
+	int fds[HOT_RESTART_MAX_FDS];
+	uint32_t count = 0, channels = COALESCER_DEFAULT_CHANNELS, i;
+	uint64_t start = latencyNow();
+	controllerLink_t* link;
+	client_t* client;
+	pid_t pid;
+	int result;
+	
+	/* Room for the largest coalescer dump, clients have one slot per global channel */
+	for(i = 0; i < linksCount(); i++)
+	{
+		channels = (linksGet(i)->coalescer.channels > channels) ? linksGet(i)->coalescer.channels : channels;
+	}
+	
+	channels = (routerChannels() > channels) ? routerChannels() : channels;
+	
+	if((frames = malloc(channels * sizeof(frame_t))) == NULL)
+	{
+		printf("Hot restart failed (%s), resuming.\r\n\n", strerror(errno));
+		close(handoff_fd);
+		handoff_fd = -1;
+		return -1;
+	}
+	
+	hotRestartMessageInit(&message);
+	
+	/* Listeners first, then the controller links that are up */
+	fds[count++] = socket_base_fd;
+	
+	memset(&header, 0, sizeof(header));
+	header.magic = HOT_RESTART_MAGIC;
+	header.channels = routerChannels();
+	header.links = linksCount();
+	header.unixListener = (unix_fd >= 0);
+	header.metricsListener = (metrics_fd >= 0);
+	header.clients = clientsCount();
+	
+	for(i = 0; i < linksCount(); i++)
+	{
+		header.linksConnected += (serial_get_state(&linksGet(i)->serial) == SERIAL_CONNECTED) ? 1 : 0;
+	}
+	
+	if(header.unixListener)
+	{
+		fds[count++] = unix_fd;
+	}
+	
+	if(header.metricsListener)
+	{
+		fds[count++] = metrics_fd;
+	}
+	
+	result = hotRestartAppend(&message, &header, sizeof(header));
+	
+	/* Per link: frames in both directions, commands held by the coalescer and the output states to replay */
+	for(i = 0; i < linksCount(); i++)
+	{
+		link = linksGet(i);
+		
+		memset(&linkRecord, 0, sizeof(linkRecord));
+		linkRecord.connected = (serial_get_state(&link->serial) == SERIAL_CONNECTED);
+		linkRecord.txOffset = link->txOffset;
+		linkRecord.txFrame = link->txFrame;
+		memcpy(linkRecord.txBatch, link->txBatch, sizeof(linkRecord.txBatch));
+		linkRecord.txBatchCount = link->txBatchCount;
+		memcpy(linkRecord.txWire, link->txWire, sizeof(linkRecord.txWire));
+		linkRecord.txWireLength = link->txWireLength;
+		linkRecord.framing = link->framing;
+		linkRecord.framingOffer = atomic_load(&link->framingOffer);
+		linkRecord.dropped = atomic_load_explicit(&link->left.dropped, memory_order_relaxed);
+		linkRecord.parser = link->parser;
+		
+		if(linkRecord.connected)
+		{
+			fds[count++] = serial_get_fd(&link->serial);
+		}
+		
+		result |= hotRestartAppend(&message, &linkRecord, sizeof(linkRecord));
+		result |= handoffAppendQueue(&message, &link->rxQueue);
+		result |= handoffAppendQueue(&message, &link->txQueue);
+		result |= handoffAppendFrames(&message, frames, coalescerDump(&link->coalescer, false, frames, link->coalescer.channels));
+		result |= handoffAppendFrames(&message, frames, coalescerDump(&link->coalescer, true, frames, link->coalescer.channels));
+	}
+	
+	/* Every client with its unparsed bytes and its send queue, the frame being sent first */
+	for(i = 0; i < CLIENTS_MAX; i++)
+	{
+		client = clientsGet(i);
+		
+		if(client->status != CLIENT_CONNECTED)
+		{
+			continue;
+		}
+		
+		fds[count++] = client->fd;
+		
+		memset(&record, 0, sizeof(record));
+		snprintf(record.name, sizeof(record.name), "%s", client->name);
+		record.parser = client->parser;
+		record.txOffset = client->txOffset;
+		record.dropped = client->dropped;
+		
+		result |= hotRestartAppend(&message, &record, sizeof(record));
+		result |= handoffAppendQueue(&message, &client->txQueue);
+		result |= handoffAppendFrames(&message, frames, coalescerDump(&client->coalescer, false, frames, client->coalescer.channels));
+	}
+	
+	free(frames);
+	
+	if(result == 0)
+	{
+		result = hotRestartSend(handoff_fd, &message, fds, count);
+	}
+	
+	/* The replacement owns everything once it says so */
+	if(result == 0)
+	{
+		result = hotRestartWaitAck(handoff_fd, &pid);
+	}
+	
+	hotRestartMessageFree(&message);
+	
+	if(result != 0)
+	{
+		printf("Hot restart failed (%s), resuming.\r\n\n", strerror(errno));
+		close(handoff_fd);
+		handoff_fd = -1;
+		return -1;
+	}
+	
+	printf("Hot restart: handed over to PID %d in %.1f ms (%u links, %u clients, %u frames).\r\n", (int) pid, (double) (latencyNow() - start) / 1e6, header.links, header.clients, shutdownPending());
+	
+	return 0;
+}
+
+static int handoffReceive(void)
+{
+	hotRestartMessage_t message;
+	handoffHeader_t header;
+	handoffLink_t linkRecord;
+	handoffClient_t record;
+	int fds[HOT_RESTART_MAX_FDS];
+	uint32_t count, next = 0, i, lost = 0;
+	uint64_t start = latencyNow();
+	controllerLink_t* link;
+	client_t* client;
+	int sock, socket_base_fd;
+	
+	hotRestartMessageInit(&message);
+	
+	if((sock = hotRestartConnect(hotRestartPath)) == -1)
+	{
+		exit(1);
+	}
+	
+	/* The running process stops, sends everything it has and waits for our ACK */
+	if((hotRestartReceive(sock, &message, fds, &count) != 0) || !hotRestartTake(&message, &header, sizeof(header)))
+	{
+		fprintf(stderr, "ERROR hot restart handoff: %s\r\n", strerror(errno));
+		exit(1);
+	}
+	
+	/* Same links and the same routes, or frames would land on the wrong controller */
+	if((header.magic != HOT_RESTART_MAGIC) || (header.channels != routerChannels()) || (header.links != linksCount()) || (count != (1 + header.unixListener + header.metricsListener + header.linksConnected + header.clients)))
+	{
+		fprintf(stderr, "ERROR hot restart handoff from an incompatible Serial Service.\r\n");
+		exit(1);
+	}
+	
+	/* Listeners and controller links keep working through the handoff, nobody reconnects */
+	socket_base_fd = fds[next++];
+	unix_fd = header.unixListener ? fds[next++] : -1;
+	metrics_fd = header.metricsListener ? fds[next++] : -1;
+	
+	for(i = 0; (i < header.links) && hotRestartTake(&message, &linkRecord, sizeof(linkRecord)); i++)
+	{
+		link = linksGet(i);
+		
+		serial_adopt(&link->serial, serialPort, serialBaudrate, linkRecord.connected ? fds[next++] : -1);
+		atomic_store_explicit(&link->up, linkRecord.connected, memory_order_relaxed);
+		
+		link->txFrame = linkRecord.txFrame;
+		link->txOffset = linkRecord.txOffset;
+		memcpy(link->txBatch, linkRecord.txBatch, sizeof(link->txBatch));
+		link->txBatchCount = linkRecord.txBatchCount;
+		memcpy(link->txWire, linkRecord.txWire, sizeof(link->txWire));
+		link->txWireLength = linkRecord.txWireLength;
+		atomic_store_explicit(&link->left.dropped, linkRecord.dropped, memory_order_relaxed);
+		link->parser = linkRecord.parser;
+		
+		/* The controller keeps the framing agreed with the old process */
+		link->framing = (linkFraming_t) linkRecord.framing;
+		atomic_store(&link->framingOffer, linkRecord.framingOffer);
+		frameParserCompact(&link->parser, (linkFraming != LINK_FRAMING_TEXT) || (link->framing != LINK_FRAMING_TEXT));
+		
+		lost += handoffTakeFrames(&message, &link->rxQueue, NULL, false);
+		lost += handoffTakeFrames(&message, &link->txQueue, NULL, false);
+		handoffTakeFrames(&message, NULL, &link->coalescer, false);
+		handoffTakeFrames(&message, NULL, &link->coalescer, true);
+	}
+	
+	for(i = 0; (i < header.clients) && hotRestartTake(&message, &record, sizeof(record)); i++)
+	{
+		if((client = clientsAdd(fds[next++], record.name)) == NULL)
+		{
+			break;
+		}
+		
+		client->quickAck = socketTune(client->fd);
+		client->parser = record.parser;
+		client->txOffset = record.txOffset;
+		client->dropped = record.dropped;
+		
+		/* Queued frames, then the values the client's coalescer was holding */
+		client->dropped += handoffTakeFrames(&message, &client->txQueue, NULL, false);
+		client->dropped += handoffTakeFrames(&message, &client->txQueue, NULL, false);
+	}
+	
+	hotRestartMessageFree(&message);
+	
+	if(hotRestartAck(sock) != 0)
+	{
+		fprintf(stderr, "ERROR hot restart ACK: %s\r\n", strerror(errno));
+		exit(1);
+	}
+	
+	close(sock);
+	
+	printf("Hot restart: took over %u links and %u clients in %.1f ms, %u frames didn't fit the queues.\r\n\n", header.links, i, (double) (latencyNow() - start) / 1e6, lost);
+	
+	return socket_base_fd;
+}
+
+static void argsParse(int argc, char* argv[])
+{
+	static const struct option longOptions[] =
+	{
+		{"mode",	required_argument,	NULL,	'm'},
+		{"queue-depth",	required_argument,	NULL,	'q'},
+		{"coalesce",	required_argument,	NULL,	'c'},
+		{"link-policy",	required_argument,	NULL,	'k'},
+		{"client-policy",	required_argument,	NULL,	'P'},
+		{"quiet",	no_argument,		NULL,	'Q'},
+		{"serial",	required_argument,	NULL,	's'},
+		{"device",	required_argument,	NULL,	'D'},
+		{"link-channels",	required_argument,	NULL,	'n'},
+		{"routes",	required_argument,	NULL,	'r'},
+		{"shards",	required_argument,	NULL,	'x'},
+		{"serial-port",	required_argument,	NULL,	'p'},
+		{"baudrate",	required_argument,	NULL,	'b'},
+		{"low-latency",	no_argument,		NULL,	'L'},
+		{"state-table",	required_argument,	NULL,	'S'},
+		{"takeover",	no_argument,		NULL,	'T'},
+		{"restart-socket",	required_argument,	NULL,	'R'},
+		{"unix-socket",	required_argument,	NULL,	'u'},
+		{"socket-buffer",	required_argument,	NULL,	'B'},
+		{"cpus",	required_argument,	NULL,	'C'},
+		{"fifo",	required_argument,	NULL,	'F'},
+		{"mlock",	no_argument,		NULL,	'M'},
+		{"measure-jitter",	no_argument,	NULL,	'W'},
+		{"journal",	required_argument,	NULL,	'j'},
+		{"journal-size",	required_argument,	NULL,	'J'},
+		{"metrics",	required_argument,	NULL,	'e'},
+		{"ack-window",	required_argument,	NULL,	'a'},
+		{"link-framing",	required_argument,	NULL,	'w'},
+		{"help",	no_argument,		NULL,	'h'},
+		{NULL,		0,			NULL,	0}
+	};
+	int option;
+	
+	while((option = getopt_long(argc, argv, "m:q:c:k:P:Qs:D:n:r:x:p:b:LS:TR:u:B:C:F:MWj:J:e:a:w:h", longOptions, NULL)) != -1)
+	{
+		switch(option)
+		{
+			case 'm':
+				/* Bridge mode: "epoll" (event-driven, default) or "threads" (4 polling threads) */
+				if(strcmp(optarg, "epoll") == 0)
+				{
+					bridgeMode = BRIDGE_MODE_EPOLL;
+				}
+				else if(strcmp(optarg, "threads") == 0)
+				{
+					bridgeMode = BRIDGE_MODE_THREADS;
+				}
+				else
+				{
+					fprintf(stderr, "ERROR invalid mode: %s.\r\n", optarg);
+					usagePrint(argv[0]);
+					exit(1);
+				}
+				break;
+				
+			case 'q':
+				/* Frames per direction, rounded up to a power of two */
+				queueDepth = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+				
+			case 'c':
+				/* Queued commands from which output updates are coalesced, 0 disables it */
+				coalesceThreshold = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+				
+			case 'k':
+			case 'P':
+				/* What to do with a frame when its destination's queue is full */
+				if(frameQueuePolicyParse(optarg, (option == 'k') ? &linkPolicy : &clientsPolicy) != 0)
+				{
+					fprintf(stderr, "ERROR invalid policy: %s.\r\n", optarg);
+					usagePrint(argv[0]);
+					exit(1);
+				}
+				break;
+				
+			case 'Q':
+				/* Don't print every frame forwarded, the terminal would be the bottleneck */
+				quiet = true;
+				break;
+				
+			case 's':
+				/* Controller Emulator link: "tcp" (Emulador.py, default) or "tty" (termios) */
+				serialTransportName = optarg;
+				break;
+				
+			case 'D':
+				/* One controller link per device, in order: link 0, link 1... */
+				if(serialDevicesCount == LINKS_MAX)
+				{
+					fprintf(stderr, "ERROR more than %d controller links.\r\n", LINKS_MAX);
+					exit(1);
+				}
+				
+				serialDevices[serialDevicesCount++] = optarg;
+				break;
+				
+			case 'n':
+				/* Global channels 0..N-1 go to link 0, N..2N-1 to link 1... */
+				linkChannels = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+				
+			case 'r':
+				/* Explicit global channel -> (link, local channel) table */
+				routesPath = optarg;
+				break;
+				
+			case 'x':
+				/* Threads serving the controller links, the event loop keeps the clients */
+				shardsCount = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+				
+			case 'p':
+				serialPort = atoi(optarg);
+				break;
+				
+			case 'b':
+				serialBaudrate = atoi(optarg);
+				break;
+				
+			case 'L':
+				serialFlags |= SERIAL_FLAG_LOW_LATENCY;
+				break;
+				
+			case 'S':
+				/* Shared memory where switch and output states are published */
+				stateTableName = optarg;
+				break;
+				
+			case 'T':
+				/* Take listener, clients and controller link over from the running Serial Service */
+				takeover = true;
+				break;
+				
+			case 'R':
+				/* Unix socket where a replacement asks for the handoff */
+				hotRestartPath = optarg;
+				break;
+				
+			case 'u':
+				/* Also accept Interface Service clients on this unix socket */
+				unixSocketPath = optarg;
+				break;
+				
+			case 'B':
+				socketBuffer = (int) strtol(optarg, NULL, 0);
+				break;
+				
+			case 'C':
+				/* One CPU per forwarding thread, in the order shown by --help */
+				if(realTimeParseCpus(&realTime, optarg) != 0)
+				{
+					fprintf(stderr, "ERROR invalid CPU list: %s.\r\n", optarg);
+					usagePrint(argv[0]);
+					exit(1);
+				}
+				break;
+				
+			case 'F':
+				realTime.priority = (int) strtol(optarg, NULL, 0);
+				
+				if((realTime.priority < 0) || (realTime.priority > sched_get_priority_max(SCHED_FIFO)))
+				{
+					fprintf(stderr, "ERROR invalid SCHED_FIFO priority: %s.\r\n", optarg);
+					exit(1);
+				}
+				break;
+				
+			case 'M':
+				realTime.lockMemory = true;
+				break;
+				
+			case 'W':
+				realTime.measureJitter = true;
+				break;
+				
+			case 'j':
+				/* Record every frame received, with direction and timestamp */
+				journalPath = optarg;
+				break;
+				
+			case 'J':
+				journalSize = strtoull(optarg, NULL, 0);
+				break;
+				
+			case 'e':
+				/* Prometheus text on http://ADDR/metrics, read from another thread without locking */
+				metricsAddress = optarg;
+				break;
+				
+			case 'a':
+				/* ">OUT:ch,v,seq" commands are tracked and acknowledged, N of them in flight per link */
+				ackWindow = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+				
+			case 'w':
+				/* Framing agreed to when a controller offers ">BIN", text keeps ignoring the offer */
+				if(strcmp(optarg, "text") == 0)
+				{
+					linkFraming = LINK_FRAMING_TEXT;
+				}
+				else if(strcmp(optarg, "compact") == 0)
+				{
+					linkFraming = LINK_FRAMING_COMPACT;
+				}
+				else if(strcmp(optarg, "bitmap") == 0)
+				{
+					linkFraming = LINK_FRAMING_BITMAP;
+				}
+				else
+				{
+					fprintf(stderr, "ERROR invalid link framing: %s.\r\n", optarg);
+					usagePrint(argv[0]);
+					exit(1);
+				}
+				break;
+				
+			case 'h':
+				usagePrint(argv[0]);
+				exit(EXIT_SUCCESS);
+				
+			default:
+				usagePrint(argv[0]);
+				exit(1);
+		}
+	}
+	
+	if((shardsCount > 0) && (bridgeMode != BRIDGE_MODE_EPOLL))
+	{
+		fprintf(stderr, "ERROR --shards needs epoll mode.\r\n");
+		exit(1);
+	}
+	
+	/* More shards than links would idle, the event loop and every shard need a real-time slot */
+	if(shardsCount > ((serialDevicesCount > 0) ? serialDevicesCount : 1))
+	{
+		shardsCount = (serialDevicesCount > 0) ? serialDevicesCount : 1;
+	}
 	
-	if((pthread_sigmask(SIG_UNBLOCK, &set, NULL)) != 0)
+	if(shardsCount > (REAL_TIME_THREADS_MAX - REAL_TIME_SHARD_BASE))
 	{
-		perror("ERROR pthread_sigmask(SIG_UNBLOCK) API");
+		shardsCount = REAL_TIME_THREADS_MAX - REAL_TIME_SHARD_BASE;
+	}
+}
+
+static void programArgsInit(int argc, char* argv[])
+{
+	int i;
+	
+	/* The path we were started from, so SIGHUP runs an upgraded binary installed there */
+	if((strchr(argv[0], '/') == NULL) || (realpath(argv[0], programPath) == NULL))
+	{
+		if(readlink("/proc/self/exe", programPath, sizeof(programPath) - 1) == -1)
+		{
+			perror("ERROR readlink(/proc/self/exe) API");
+		}
+	}
+	
+	/* Same options, plus --takeover if it isn't there yet */
+	if((programArgv = calloc(argc + 2, sizeof(char*))) == NULL)
+	{
+		perror("ERROR calloc() API");
 		exit(1);
 	}
+	
+	for(i = 0; i < argc; i++)
+	{
+		programArgv[i] = argv[i];
+	}
+	
+	if(!takeover)
+	{
+		programArgv[i] = "--takeover";
+	}
+}
+
+static void usagePrint(const char* program)
+{
+	printf("Usage: %s [options]\r\n", program);
+	printf("  -m, --mode=MODE        epoll (default) or threads\r\n");
+	printf("  -q, --queue-depth=N    frames queued per direction (default %d)\r\n", FRAME_QUEUE_DEFAULT_DEPTH);
+	printf("  -c, --coalesce=N       coalesce output commands once N are queued, 0 disables (default %d)\r\n", COALESCE_DEFAULT_THRESHOLD);
+	printf("  -k, --link-policy=P    full controller queue: block, drop-oldest, drop-newest or coalesce (default coalesce)\r\n");
+	printf("  -P, --client-policy=P  full client queue: block, drop-oldest, drop-newest or coalesce (default drop-newest)\r\n");
+	printf("  -Q, --quiet            don't print every frame forwarded\r\n");
+	printf("  -s, --serial=LINK      controller link: tcp (Emulador.py, default) or tty\r\n");
+	printf("  -D, --device=PATH      tty device (e.g. a pseudo-terminal) or tcp ip:port, repeat it for more controllers\r\n");
+	printf("  -n, --link-channels=N  channels per controller, global channel G goes to link G/N (default %d)\r\n", ROUTER_DEFAULT_LINK_CHANNELS);
+	printf("  -r, --routes=FILE      route global channels with \"GLOBAL LINK LOCAL [COUNT]\" lines instead\r\n");
+	printf("  -x, --shards=N         serve the controller links from N threads (epoll mode), 0 keeps them in the event loop\r\n");
+	printf("  -p, --serial-port=N    use /dev/ttyUSB<N> when no device is given (default %d)\r\n", SERIAL_DEFAULT_PORT);
+	printf("  -b, --baudrate=N       tty line speed (default %d)\r\n", SERIAL_DEFAULT_BAUDRATE);
+	printf("  -L, --low-latency      ask the tty driver for ASYNC_LOW_LATENCY\r\n");
+	printf("  -S, --state-table=NAME publish states in shared memory NAME, none disables it (default %s)\r\n", STATE_TABLE_DEFAULT_NAME);
+	printf("  -T, --takeover         take over from the Serial Service running at the restart socket\r\n");
+	printf("  -R, --restart-socket=PATH hot restart socket, none disables it (default %s)\r\n", HOT_RESTART_DEFAULT_PATH);
+	printf("  -u, --unix-socket=PATH also accept Interface Service clients on unix socket PATH\r\n");
+	printf("  -B, --socket-buffer=N  client socket send/receive buffers in bytes, 0 keeps kernel autotuning (default %d)\r\n", SOCKET_BUFFER_DEFAULT);
+	printf("  -C, --cpus=LIST        pin the threads to these CPUs: controller tx,controller rx,clients tx,clients rx\r\n");
+	printf("                         (epoll mode: the event loop uses the first one, shards the next ones), a shorter list repeats its last CPU\r\n");
+	printf("  -F, --fifo=PRIO        run the forwarding threads SCHED_FIFO at PRIO, 0 disables it (default 0)\r\n");
+	printf("  -M, --mlock            lock all memory (mlockall) and prefault thread stacks\r\n");
+	printf("  -W, --measure-jitter   time %d sleeps of %d us in every forwarding thread as it starts and report how late they wake up\r\n", REAL_TIME_JITTER_SAMPLES, REAL_TIME_JITTER_PERIOD_US);
+	printf("  -j, --journal=PATH     record every frame received in ring file PATH (see Replay/)\r\n");
+	printf("  -J, --journal-size=MB  journal ring size, 64 bytes per frame (default %d)\r\n", JOURNAL_DEFAULT_SIZE_MB);
+	printf("  -e, --metrics=ADDR     serve Prometheus metrics on [IP:]PORT (default IP %s) or unix socket PATH\r\n", METRICS_DEFAULT_IP);
+	printf("  -a, --ack-window=N     acknowledge \">OUT:ch,v,seq\" commands with \">ACK:ch,rtt_us,seq\", N in flight per link, 0 disables it (default 0)\r\n");
+	printf("  -w, --link-framing=F   answer a controller's \">BIN\" offer: text (ignore it, default), compact (4-byte binary frames with CRC-8)\r\n");
+	printf("                         or bitmap (also up to 16 on/off outputs per frame)\r\n");
+	printf("  -h, --help             show this help\r\n");
 }
 	
 /********************** External Functions Definition ************************/
-int main(void)
+int main(int argc, char* argv[])
 {
 	int socket_base_fd;	// To open socket for communication with Interface Service
-	void* ret;		// For pthread_join() for freeing resources after canceling the threads
+	uint64_t faults = 0;	// Event loop page faults before the first frame
+	uint64_t errors = 0, saved = 0, dropped;
+	controllerLink_t* link;
+	uint32_t i;
 
-	printf("\n-=-=-=- Starting Serial Service -=-=-=-\r\n\n");
+	/* Parse command line options */
+	realTimeInit(&realTime);
+	argsParse(argc, argv);
+	programArgsInit(argc, argv);
 	
-	/* Set signals' handlers configuration */
-	signalHandlersInit();
-	
-	/* Block signals for main thread */
-	signalBlock();
-	
-	/* Open serial port for communication with Controller Emulator */
-	if(serial_open(1, 115200) != 0)
+	/* A replacement forwards as soon as it is handed over: never measured again on a hot restart */
+	if(takeover)
 	{
-		printf("ERROR while trying to open the serial port.\r\n");
+		realTime.measureJitter = false;
 	}
+
+	printf("\n-=-=-=- Starting Serial Service (%s mode) -=-=-=-\r\n\n", (bridgeMode == BRIDGE_MODE_EPOLL) ? "epoll" : "threads");
 	
-	/* Open TCP socket for communication with Interface Service */
-	socket_base_fd = socketInit(INTERFACE_SERVICE_SOCKET_IP, INTERFACE_SERVICE_SOCKET_PORT);
+	/* Block signals for every thread, they are read from signal_fd */
+	signal_fd = signalInit();
 	
 	/* Init mutex */
 	mutexInit();
 	
-	/* Init threads */
-	threadsInit();	
+	/* Init cross-communication queues */
+	queuesInit(queueDepth);
 	
-	/* Unblock signals for the main thread */
-	signalUnblock();
+	/* Queues are mapped already, thread stacks and client buffers will be locked as they are created */
+	if(realTime.lockMemory)
+	{
+		realTimeLockMemory();
+	}
 	
-	while(systemStatus != EXIT)
+	/* Event loop: pinned, prioritized and prefaulted before taking over or opening anything */
+	if(bridgeMode == BRIDGE_MODE_EPOLL)
 	{
-		/* Program won't finish until SIGINT or SIGTERM signal is received */
+		faults = threadRealTimeInit(REAL_TIME_EVENT_LOOP, "Event loop");
+	}
+	
+	if(takeover)
+	{
+		/* Hot restart: listener, clients, controller link and queued frames come from the running process */
+		socket_base_fd = handoffReceive();
+	}
+	else
+	{
+		/* Open serial port for communication with Controller Emulator, several are connected by the bridge itself */
+		if(linksCount() == 1)
+		{
+			if(serial_open(&linksGet(0)->serial, serialPort, serialBaudrate) != 0)
+			{
+				printf("ERROR while trying to open the serial port.\r\n");
+				exit(1);
+			}
+		}
+		else
+		{
+			for(i = 0; i < linksCount(); i++)
+			{
+				serial_start(&linksGet(i)->serial, serialPort, serialBaudrate);
+			}
+		}
+		
+		/* Open TCP socket for communication with Interface Service */
+		socket_base_fd = socketInit(INTERFACE_SERVICE_SOCKET_IP, INTERFACE_SERVICE_SOCKET_PORT);
 		
-		/* Accept socket incoming connections from client */
-		addr_len = sizeof(struct sockaddr_in);
-		if((socket_fd = accept(socket_base_fd, (struct sockaddr *) &clientaddr, &addr_len)) == -1)
+		/* Local clients can skip the TCP stack */
+		if(unixSocketPath != NULL)
 		{
-		      perror("ERROR accept() API");
-		      exit(1);
-	    	}
-	 	
-	 	/* Connection established */
-		char ipClient[32];
-		inet_ntop(AF_INET, &(clientaddr.sin_addr), ipClient, sizeof(ipClient));
-		printf("SERVER: connection from: %s\n\n", ipClient);
+			unix_fd = socketInitUnix(unixSocketPath);
+		}
 		
-		/* Lock mutex for shared resource */
-		pthread_mutex_lock(&mutexData_systemStatus);
+		/* Scrapes are answered by their own thread, the bridge works without it */
+		if((metricsAddress != NULL) && ((metrics_fd = metricsListen(metricsAddress)) == -1))
 		{
-			clientStatus = CLIENT_CONNECTED;
-		}	
-		/* Unlock mutex for shared resource */
-		pthread_mutex_unlock(&mutexData_systemStatus);		
+			printf("WARNING metrics %s not available.\r\n", metricsAddress);
+		}
+	}
+	
+	for(i = 0; i < linksCount(); i++)
+	{
+		atomic_store_explicit(&linksGet(i)->up, (serial_get_state(&linksGet(i)->serial) == SERIAL_CONNECTED), memory_order_relaxed);
+	}
+	
+	/* Publish switch and output states for local readers (kept across a hot restart), the bridge works without it */
+	if((strcmp(stateTableName, "none") != 0) && ((stateTable = stateTableCreate(stateTableName, takeover)) == NULL))
+	{
+		printf("WARNING state table %s not available.\r\n", stateTableName);
+	}
+	
+	/* Frame capture (appended to across a hot restart), the bridge works without it */
+	if((journalPath != NULL) && ((journal = journalCreate(journalPath, journalSize, takeover)) == NULL))
+	{
+		printf("WARNING journal %s not available.\r\n", journalPath);
+	}
+	
+	/* Wait for a replacement to hand everything over to */
+	if((strcmp(hotRestartPath, "none") != 0) && ((restart_fd = hotRestartListen(hotRestartPath)) == -1))
+	{
+		printf("WARNING hot restart not available.\r\n");
+	}
+	
+	if((metrics_fd >= 0) && (metricsStart(metrics_fd, metricsRender) != 0))
+	{
+		printf("WARNING metrics %s not available.\r\n", metricsAddress);
+	}
+	
+	/* Forward frames until SIGINT or SIGTERM signal is received, or a replacement takes over */
+	do
+	{
+		atomic_store(&systemStatus, RUNNING);
 		
-		printf("-=-=-=- Serial Service Running -=-=-=-\r\n\n");
+		if(bridgeMode == BRIDGE_MODE_EPOLL)
+		{
+			eventLoopRun(socket_base_fd);
+		}
+		else
+		{
+			threadsRun(socket_base_fd);
+		}
+	}
+	while((atomic_load(&systemStatus) == HANDOFF) && (handoffSend(socket_base_fd) != 0));
+	
+	if(atomic_load(&systemStatus) == HANDOFF)
+	{
+		/* The replacement owns every descriptor now: leave without closing, flushing or unlinking anything */
+		metricsStop();
 		
-		while(systemStatus != EXIT)
+		if(stateTable != NULL)
 		{
-			if(clientStatus == CLIENT_DISCONNECTED)
-			{
-				break;		
-			}
-			
-			usleep(10000);
+			stateTableDetach(stateTable);
 		}
 		
-		printf("-=-=-=- Serial Service Stopped -=-=-=-\r\n\n");
+		exit(EXIT_SUCCESS);
+	}
 	
-		/* Close socket */
-		close(socket_fd);
-		
-		usleep(10000);
+	if(bridgeMode == BRIDGE_MODE_EPOLL)
+	{
+		threadRealTimeDeinit(faults);
+	}
+	
+	/* Nobody to hand over to anymore */
+	if(restart_fd >= 0)
+	{
+		close(restart_fd);
+		unlink(hotRestartPath);
 	}
 	
+	/* Refuse new clients while draining */
+	close(socket_base_fd);
+	
+	if(unix_fd >= 0)
+	{
+		close(unix_fd);
+		unlink(unixSocketPath);
+	}
+	
+	/* No more scrapes: the queues, clients and histograms it reads are about to go */
+	metricsStop();
+	
+	if(metrics_fd >= 0)
+	{
+		metricsClose(metrics_fd, metricsAddress);
+	}
+	
+	/* Deliver frames already accepted, bounded by SHUTDOWN_DRAIN_MS */
+	shutdownDrain();
+	
 	printf("-=-=-=- Serial Service Closed -=-=-=-\r\n\n");
+	printf("Shutdown: drained in %.1f ms, %u frames undelivered.\r\n", (double) (latencyNow() - shutdownStart) / 1e6, shutdownPending());
 	
-	/* Cancel threads and free resources */
-	pthread_cancel(ThreadHandle_controllerEmulator_tx);
-	pthread_join(ThreadHandle_controllerEmulator_tx, &ret);
-	pthread_cancel(ThreadHandle_controllerEmulator_rx);
-	pthread_join(ThreadHandle_controllerEmulator_rx, &ret);
-	pthread_cancel(ThreadHandle_interfaceService_tx);
-	pthread_join(ThreadHandle_interfaceService_tx, &ret);
-	pthread_cancel(ThreadHandle_interfaceService_rx);
-	pthread_join(ThreadHandle_interfaceService_rx, &ret);
+	dropped = atomic_load_explicit(&metrics_left.dropped, memory_order_relaxed);
+	
+	for(i = 0; i < linksCount(); i++)
+	{
+		link = linksGet(i);
+		errors += link->parser.errors;
+		saved += link->coalescer.saved;
+		dropped += atomic_load_explicit(&link->left.dropped, memory_order_relaxed);
+	}
+	
+	printf("Malformed frames discarded from Controller Emulator: %llu.\r\n", (unsigned long long) errors);
+	printf("Output commands coalesced: %llu writes saved.\r\n", (unsigned long long) saved);
+	printf("Output commands dropped (%s): %llu.\r\n", frameQueuePolicyName(linkPolicy), (unsigned long long) dropped);
+	
+	if(!routerIdentity())
+	{
+		printf("Frames without a route: %llu from the controllers, %llu from the clients.\r\n", (unsigned long long) metricsTotal(0, offsetof(metricsDirection_t, unroutable)), (unsigned long long) metricsTotal(1, offsetof(metricsDirection_t, unroutable)));
+	}
+	
+	if(ackWindow > 0)
+	{
+		printf("Sequenced commands: %llu acknowledged, %llu given up on.\r\n", (unsigned long long) acksSent, (unsigned long long) naksSent);
+	}
+	
+	printf("Page faults while forwarding: %llu.\r\n\n", (unsigned long long) forwardingFaults);
+	latencyPrint();
+	
+	/* Close connections with Controller Emulators, free their queues */
+	linksDeinit();
+	routerDeinit();
+	
+	/* Close connections with Interface Service clients */
+	clientsDeinit();
+	
+	/* Remove the state table */
+	if(stateTable != NULL)
+	{
+		stateTableDestroy(stateTable, stateTableName);
+	}
+	
+	/* The journal stays on disk for Replay/ */
+	if(journal != NULL)
+	{
+		printf("Journal: %llu frames recorded in %s.\r\n", (unsigned long long) journalEnd(journal), journalPath);
+		journalClose(journal);
+	}
 	
-	/* Close connection with Controller Emulator */
-	serial_close();
+	close(signal_fd);
 	
-	/* Close connection with Interface Service */
-	// -> already closed before
+	printf("Shutdown completed in %.1f ms.\r\n", (double) (latencyNow() - shutdownStart) / 1e6);
 	
 	exit(EXIT_SUCCESS);
 	return 0;
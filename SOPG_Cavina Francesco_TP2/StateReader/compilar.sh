@@ -0,0 +1 @@
+gcc -O2 -I../SerialService main.c ../SerialService/StateTable.c ../SerialService/FrameParser.c ../SerialService/LatencyHistogram.c -o stateReader -pthread -lrt
@@ -0,0 +1,171 @@
+/*
+ * @file   : main.c
+ * @date   : Oct, 2026
+ * @author : Francesco Cavina <francescocavina98@gmail.com>
+ */
+
+/*
+ * Prints the switch and output states the Serial Service publishes in shared
+ * memory, once or every time they change. Shows how a local consumer (the
+ * web CGI, the Interface Service) reads the table: attach once, then take
+ * snapshots without any syscall.
+ */
+
+/********************** Inclusions *******************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "StateTable.h"
+
+/********************** Macros and Definitions *******************************/
+#define WATCH_PERIOD_US				(1000)
+
+/********************** Internal Data Declaration ****************************/
+
+/********************** Internal Functions Declaration ***********************/
+static void argsParse(int argc, char* argv[]);
+static void usagePrint(const char* program);
+static void statesPrint(const stateData_t* states, uint32_t sequence);
+
+/********************** Internal Data Definition *****************************/
+static const char* tableName = STATE_TABLE_DEFAULT_NAME;	// Shared memory published by the Serial Service
+static bool json = false;					// Same fields as web/cgi-bin/getDevices.py
+static bool watch = false;					// Print again on every change
+
+/********************** External Data Definition *****************************/
+
+/********************** Internal Functions Definition ************************/
+static void statesPrint(const stateData_t* states, uint32_t sequence)
+{
+	uint32_t channel;
+	bool first = true;
+
+	if(json)
+	{
+		printf("[");
+		for(channel = 0; channel < STATE_TABLE_CHANNELS; channel++)
+		{
+			if(states->outputsKnown & (1ULL << channel))
+			{
+				printf("%s{\"id\":\"%u\",\"state\":\"%d\"}", first ? "" : ",", channel + 1, states->outputs[channel]);
+				first = false;
+			}
+		}
+		printf("]\n");
+	}
+	else
+	{
+		printf("sequence %u, %llu changes:", sequence, (unsigned long long) states->changes);
+		for(channel = 0; channel < STATE_TABLE_CHANNELS; channel++)
+		{
+			if(states->switchesKnown & (1ULL << channel))
+			{
+				printf(" SW%u=%d", channel, states->switches[channel]);
+			}
+		}
+		for(channel = 0; channel < STATE_TABLE_CHANNELS; channel++)
+		{
+			if(states->outputsKnown & (1ULL << channel))
+			{
+				printf(" OUT%u=%d", channel, states->outputs[channel]);
+			}
+		}
+		printf("\n");
+	}
+
+	fflush(stdout);
+}
+
+static void argsParse(int argc, char* argv[])
+{
+	static const struct option longOptions[] =
+	{
+		{"table",	required_argument,	NULL,	't'},
+		{"json",	no_argument,		NULL,	'j'},
+		{"watch",	no_argument,		NULL,	'w'},
+		{"help",	no_argument,		NULL,	'h'},
+		{NULL,		0,			NULL,	0}
+	};
+	int option;
+
+	while((option = getopt_long(argc, argv, "t:jwh", longOptions, NULL)) != -1)
+	{
+		switch(option)
+		{
+			case 't':
+				tableName = optarg;
+				break;
+
+			case 'j':
+				json = true;
+				break;
+
+			case 'w':
+				watch = true;
+				break;
+
+			case 'h':
+				usagePrint(argv[0]);
+				exit(EXIT_SUCCESS);
+
+			default:
+				usagePrint(argv[0]);
+				exit(1);
+		}
+	}
+}
+
+static void usagePrint(const char* program)
+{
+	printf("Usage: %s [options]\r\n", program);
+	printf("  -t, --table=NAME       shared memory published by serialService (default %s)\r\n", STATE_TABLE_DEFAULT_NAME);
+	printf("  -j, --json             outputs as JSON, like web/cgi-bin/getDevices.py\r\n");
+	printf("  -w, --watch            print again every time a state changes\r\n");
+	printf("  -h, --help             show this help\r\n");
+}
+
+/********************** External Functions Definition ************************/
+int main(int argc, char* argv[])
+{
+	stateTable_t* table;
+	stateData_t states;
+	uint32_t sequence;
+
+	/* Parse command line options */
+	argsParse(argc, argv);
+
+	if((table = stateTableAttach(tableName)) == NULL)
+	{
+		fprintf(stderr, "ERROR state table %s: %s.\r\n", tableName, strerror(errno));
+		exit(1);
+	}
+
+	sequence = stateTableSnapshot(table, &states);
+	statesPrint(&states, sequence);
+
+	/* Only the sequence number is read while nothing changes */
+	while(watch)
+	{
+		if(stateTableSequence(table) != sequence)
+		{
+			sequence = stateTableSnapshot(table, &states);
+			statesPrint(&states, sequence);
+		}
+
+		usleep(WATCH_PERIOD_US);
+	}
+
+	stateTableDetach(table);
+
+	exit(EXIT_SUCCESS);
+	return 0;
+}
+
+/********************** End of File ******************************************/